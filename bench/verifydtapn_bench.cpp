@@ -0,0 +1,399 @@
+/*
+ * File:   verifydtapn_bench.cpp
+ *
+ * Fixed benchmark suite of the engine : explorations of the example nets with every
+ * verification method, safety synthesis, and SMC on built-in stochastic models, all with
+ * fixed seeds. Every case runs in its own process, so that its peak memory is its own,
+ * and is reported as one JSON line. Given a baseline (a previous report), the cases that
+ * got slower or bigger than the threshold allows are flagged and the exit code is 1.
+ */
+
+#include "verifydtapn.h"
+#include "Core/ArgsParser.hpp"
+#include "Core/TAPN/TAPNModelBuilder.hpp"
+#include "Core/Query/SMCQuery.hpp"
+#include "DiscreteVerification/DiscreteVerification.hpp"
+#include "DiscreteVerification/Util/ProgressStream.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace VerifyTAPN;
+using namespace VerifyTAPN::DiscreteVerification;
+
+namespace {
+
+    enum CaseKind {
+        // Net and query files, verified as by the command line
+        Exploration,
+        // Net file, the EF query is turned into the safety game of avoiding it
+        Synthesis,
+        // Built-in stochastic model
+        Stochastic
+    };
+
+    struct BenchCase {
+        std::string name;
+        CaseKind kind;
+        std::string model;
+        std::string query;
+        std::vector<std::string> args;
+    };
+
+    const std::vector<BenchCase> suite = {
+        { "fischer-5/discrete", Exploration, "fischer-5.xml", "fischer-5-not-satisfied.q", { "-k", "6" } },
+        { "fischer-5/discrete-ptrie", Exploration, "fischer-5.xml", "fischer-5-not-satisfied.q", { "-k", "6", "-p", "1" } },
+        { "fischer-5/timedart", Exploration, "fischer-5.xml", "fischer-5-not-satisfied.q", { "-k", "6", "-m", "1" } },
+        { "fischer-5/timedart-ptrie", Exploration, "fischer-5.xml", "fischer-5-not-satisfied.q", { "-k", "6", "-m", "1", "-p", "1" } },
+        { "fischer-15/discrete-ptrie", Exploration, "fischer-15.xml", "fischer-15-not-satisfied.q", { "-k", "16", "-p", "1" } },
+        { "fischer-15/timedart-ptrie", Exploration, "fischer-15.xml", "fischer-15-not-satisfied.q", { "-k", "16", "-m", "1", "-p", "1" } },
+        { "train50/discrete", Exploration, "train50.xml", "train50.q", { "-k", "50" } },
+        { "train50/timedart-ptrie", Exploration, "train50.xml", "train50.q", { "-k", "50", "-m", "1", "-p", "1" } },
+        { "abp/discrete", Exploration, "abp.xml", "abp-not-satisfied.q", { "-k", "3" } },
+        { "abp/timedart", Exploration, "abp.xml", "abp-not-satisfied.q", { "-k", "3", "-m", "1" } },
+        { "producer-consumer/discrete", Exploration, "producer-consumer.xml", "producer-consumer-not-satisfied.q", { "-k", "4" } },
+        { "producer-consumer/discrete-ptrie", Exploration, "producer-consumer.xml", "producer-consumer-not-satisfied.q", { "-k", "4", "-p", "1" } },
+        { "fischer-5/synthesis", Synthesis, "fischer-5.xml", "fischer-5-not-satisfied.q", { "-k", "6" } },
+        { "abp/synthesis", Synthesis, "abp.xml", "abp-not-satisfied.q", { "-k", "3" } },
+        { "queue/estimate", Stochastic, "queue", "", { "--smc-benchmark", "50000", "--smc-seed", "1" } },
+        { "queue/estimate-parallel", Stochastic, "queue", "", { "--smc-benchmark", "200000", "--smc-seed", "1", "--smc-threads", "4" } },
+        { "queue/estimate-batch", Stochastic, "queue", "", { "--smc-benchmark", "50000", "--smc-seed", "1", "--smc-batch", "16" } },
+        { "queue/compare", Stochastic, "queue", "", { "--smc-seed", "1" } },
+        { "queue/compare-batch", Stochastic, "queue", "", { "--smc-seed", "1", "--smc-batch", "16" } },
+        { "repair/estimate", Stochastic, "repair", "", { "--smc-benchmark", "50000", "--smc-seed", "1" } },
+        { "repair/estimate-parallel", Stochastic, "repair", "", { "--smc-benchmark", "200000", "--smc-seed", "1", "--smc-threads", "4" } },
+        { "repair/estimate-batch", Stochastic, "repair", "", { "--smc-benchmark", "50000", "--smc-seed", "1", "--smc-batch", "16" } },
+    };
+
+    struct StochasticModel {
+        std::unique_ptr<TAPN::TimedArcPetriNet> tapn;
+        std::vector<int> placement;
+        std::unique_ptr<AST::SMCQuery> query;
+    };
+
+    const int INF = std::numeric_limits<int>::max();
+
+    // Single server queue : exponential arrivals, uniform service, does the queue reach 8
+    // customers within 100 time units
+    StochasticModel queueModel(bool compare) {
+        TAPNModelBuilder builder;
+        builder.addPlace("Source", 1, true, INF);
+        builder.addPlace("Queue", 0, true, INF);
+        builder.addPlace("Server", 1, true, INF);
+        builder.addPlace("Busy", 0, true, INF);
+        builder.addTransition("Arrive", 0, false, 0, 0, SMC::Exponential, { 1.0 });
+        builder.addTransition("Start", 0, true, 0, 0, SMC::Constant, { 0.0 });
+        builder.addTransition("Serve", 0, false, 0, 0, SMC::Uniform, { 0.2, 1.6 });
+        builder.addInputArc("Source", "Arrive", false, 1, false, true, 0, INF);
+        builder.addOutputArc("Arrive", "Source", 1);
+        builder.addOutputArc("Arrive", "Queue", 1);
+        builder.addInputArc("Queue", "Start", false, 1, false, true, 0, INF);
+        builder.addInputArc("Server", "Start", false, 1, false, true, 0, INF);
+        builder.addOutputArc("Start", "Busy", 1);
+        builder.addInputArc("Busy", "Serve", false, 1, false, true, 0, INF);
+        builder.addOutputArc("Serve", "Server", 1);
+        StochasticModel model;
+        model.placement = builder.initialMarking();
+        model.tapn.reset(builder.make_tapn());
+        AST::SMCSettings settings { 100, INF, 0.05f, 0.05f, 0.01f, 0.01f, 0.95f, 0.01f, compare, 0.6f };
+        auto* full = new AST::AtomicProposition(new AST::NumberExpression(8), AST::AtomicProposition::LE,
+            new AST::IdentifierExpression(model.tapn->getPlaceIndex("Queue")));
+        model.query = std::make_unique<AST::SMCQuery>(AST::PF, settings, full);
+        return model;
+    }
+
+    // Four machines failing at exponential dates, repaired one at a time with normally
+    // distributed durations, are three of them ever down at once within 200 time units
+    StochasticModel repairModel() {
+        TAPNModelBuilder builder;
+        builder.addPlace("Up", 4, true, INF);
+        builder.addPlace("Down", 0, true, INF);
+        builder.addPlace("Repairman", 1, true, INF);
+        builder.addPlace("Repairing", 0, true, INF);
+        builder.addTransition("Fail", 0, false, 0, 0, SMC::Exponential, { 0.05 });
+        builder.addTransition("Begin", 0, true, 0, 0, SMC::Constant, { 0.0 });
+        builder.addTransition("Repair", 0, false, 0, 0, SMC::Normal, { 5.0, 1.5 });
+        builder.addInputArc("Up", "Fail", false, 1, false, true, 0, INF);
+        builder.addOutputArc("Fail", "Down", 1);
+        builder.addInputArc("Down", "Begin", false, 1, false, true, 0, INF);
+        builder.addInputArc("Repairman", "Begin", false, 1, false, true, 0, INF);
+        builder.addOutputArc("Begin", "Repairing", 1);
+        builder.addInputArc("Repairing", "Repair", false, 1, false, true, 0, INF);
+        builder.addOutputArc("Repair", "Up", 1);
+        builder.addOutputArc("Repair", "Repairman", 1);
+        StochasticModel model;
+        model.placement = builder.initialMarking();
+        model.tapn.reset(builder.make_tapn());
+        AST::SMCSettings settings { 200, INF, 0.05f, 0.05f, 0.01f, 0.01f, 0.95f, 0.01f, false, 0.5f };
+        int down = model.tapn->getPlaceIndex("Down");
+        int repairing = model.tapn->getPlaceIndex("Repairing");
+        auto* failures = new AST::PlusExpression(new AST::IdentifierExpression(down), new AST::IdentifierExpression(repairing));
+        auto* three = new AST::AtomicProposition(new AST::NumberExpression(3), AST::AtomicProposition::LE, failures);
+        model.query = std::make_unique<AST::SMCQuery>(AST::PF, settings, three);
+        return model;
+    }
+
+    VerificationOptions parseArgs(const std::vector<std::string>& args) {
+        std::vector<char*> argv = { (char*) "verifydtapn" };
+        for(const std::string& arg : args) {
+            argv.push_back((char*) arg.c_str());
+        }
+        ArgsParser parser;
+        return parser.parse(argv.size(), argv.data());
+    }
+
+    // Runs in the child process, as main does
+    int runCase(const BenchCase& bench, const std::string& nets) {
+        std::vector<std::string> args = bench.args;
+        if(bench.kind == Stochastic) {
+            // The model and the query are built here, their names only stand for the files
+            args.push_back(bench.model);
+            args.push_back(bench.name);
+            VerificationOptions options = parseArgs(args);
+            StochasticModel model = bench.model == "queue" ? queueModel(bench.name.rfind("queue/compare", 0) == 0) : repairModel();
+            model.tapn->initialize(false, false);
+            model.tapn->updatePlaceTypes(model.query.get(), options);
+            return DiscreteVerification::DiscreteVerification::run(*model.tapn, model.placement, model.query.get(), options);
+        }
+        args.push_back(nets + "/" + bench.model);
+        args.push_back(nets + "/" + bench.query);
+        VerificationOptions options = parseArgs(args);
+        unfoldtacpn::ColoredPetriNetBuilder builder(nullptr);
+        auto [placement, tapn] = parse_net_file(builder, options.getInputFile());
+        tapn->initialize(options.getGlobalMaxConstantsEnabled(), options.getGCDLowerGuardsEnabled());
+        std::vector<std::unique_ptr<AST::Query>> queries = make_queries(builder, options, *tapn);
+        std::unique_ptr<AST::Query> query = std::move(queries.front());
+        if(bench.kind == Synthesis) {
+            query = std::make_unique<AST::Query>(AST::CG, new AST::NotExpression(query->getChild()->clone()));
+            options.setKeepDeadTokens(true);
+        }
+        tapn->updatePlaceTypes(query.get(), options);
+        return DiscreteVerification::DiscreteVerification::run(*tapn, placement, query.get(), options);
+    }
+
+    struct Measure {
+        // "ok", "timeout", "crashed" or "failed" when no statistics were printed
+        std::string status;
+        int exitCode = 0;
+        double wall = 0;
+        double peakRssKb = 0;
+        double states = NAN;
+        double runs = NAN;
+        double estimate = NAN;
+    };
+
+    // First number after label on a line of the output, NaN if absent
+    double statistic(const std::string& output, const std::string& label) {
+        size_t at = output.find(label);
+        if(at == std::string::npos) return NAN;
+        return strtod(output.c_str() + at + label.size(), nullptr);
+    }
+
+    Measure measure(const BenchCase& bench, const std::string& nets, unsigned int timeout) {
+        Measure result;
+        int pipefd[2];
+        if(pipe(pipefd) != 0) {
+            result.status = "failed";
+            return result;
+        }
+        auto start = std::chrono::steady_clock::now();
+        pid_t pid = fork();
+        if(pid == 0) {
+            close(pipefd[0]);
+            dup2(pipefd[1], STDOUT_FILENO);
+            close(pipefd[1]);
+            freopen("/dev/null", "w", stderr);
+            alarm(timeout);
+            int code = runCase(bench, nets);
+            std::cout.flush();
+            fflush(stdout);
+            _exit(code & 0xff);
+        }
+        close(pipefd[1]);
+        std::string output;
+        char buffer[4096];
+        ssize_t n;
+        while((n = read(pipefd[0], buffer, sizeof(buffer))) > 0) {
+            output.append(buffer, n);
+        }
+        close(pipefd[0]);
+        int status = 0;
+        struct rusage usage {};
+        wait4(pid, &status, 0, &usage);
+        auto stop = std::chrono::steady_clock::now();
+        result.wall = std::chrono::duration<double>(stop - start).count();
+        // Kilobytes on Linux, bytes on macOS
+#ifdef __APPLE__
+        result.peakRssKb = usage.ru_maxrss / 1024.0;
+#else
+        result.peakRssKb = usage.ru_maxrss;
+#endif
+        result.states = statistic(output, "explored markings:");
+        result.runs = statistic(output, "runs executed:");
+        result.estimate = statistic(output, "P = ");
+        if(WIFSIGNALED(status)) {
+            result.status = WTERMSIG(status) == SIGALRM ? "timeout" : "crashed";
+        } else {
+            result.exitCode = WEXITSTATUS(status);
+            result.status = std::isnan(result.states) && std::isnan(result.runs) ? "failed" : "ok";
+        }
+        return result;
+    }
+
+    // Numeric fields and the case name of the lines written by report, enough to read a baseline
+    std::map<std::string, std::map<std::string, double>> readBaseline(const std::string& path) {
+        std::map<std::string, std::map<std::string, double>> baseline;
+        std::ifstream file(path);
+        std::string line;
+        while(std::getline(file, line)) {
+            std::string name;
+            std::map<std::string, double> fields;
+            size_t at = 0;
+            while((at = line.find('"', at)) != std::string::npos) {
+                size_t end = line.find('"', at + 1);
+                if(end == std::string::npos || end + 1 >= line.size() || line[end + 1] != ':') break;
+                std::string key = line.substr(at + 1, end - at - 1);
+                const char* value = line.c_str() + end + 2;
+                if(*value == '"') {
+                    size_t close = line.find('"', end + 3);
+                    if(key == "case") name = line.substr(end + 3, close - end - 3);
+                    at = close + 1;
+                } else {
+                    char* next;
+                    double number = strtod(value, &next);
+                    if(next != value) fields[key] = number;
+                    at = end + 2;
+                }
+            }
+            if(!name.empty()) baseline[name] = fields;
+        }
+        return baseline;
+    }
+
+    void usage() {
+        std::cout << "verifydtapn_bench [options]" << std::endl
+                  << "  --nets DIR         directory of the example nets (default : " << VERIFYDTAPN_EXAMPLE_NETS << ")" << std::endl
+                  << "  --output FILE      JSON lines report, '_' for stdout (default : _)" << std::endl
+                  << "  --baseline FILE    report to compare with, regressions make the exit code 1" << std::endl
+                  << "  --threshold R      relative change tolerated before flagging a regression (default : 0.1)" << std::endl
+                  << "  --repeat N         runs per case, the fastest one is kept (default : 1)" << std::endl
+                  << "  --timeout S        seconds before a case is stopped (default : 600)" << std::endl
+                  << "  --filter TEXT      only the cases whose name contains TEXT" << std::endl
+                  << "  --list             list the cases" << std::endl;
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string nets = VERIFYDTAPN_EXAMPLE_NETS;
+    std::string output = "_";
+    std::string baselinePath;
+    std::string filter;
+    double threshold = 0.1;
+    unsigned int repeat = 1;
+    unsigned int timeout = 600;
+    for(int i = 1 ; i < argc ; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if(arg == "--nets" && hasValue) nets = argv[++i];
+        else if(arg == "--output" && hasValue) output = argv[++i];
+        else if(arg == "--baseline" && hasValue) baselinePath = argv[++i];
+        else if(arg == "--threshold" && hasValue) threshold = atof(argv[++i]);
+        else if(arg == "--repeat" && hasValue) repeat = std::max(1, atoi(argv[++i]));
+        else if(arg == "--timeout" && hasValue) timeout = atoi(argv[++i]);
+        else if(arg == "--filter" && hasValue) filter = argv[++i];
+        else if(arg == "--list") {
+            for(const BenchCase& bench : suite) std::cout << bench.name << std::endl;
+            return 0;
+        } else {
+            usage();
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+    }
+
+    Util::ProgressStream report(output);
+    if(!report.isOpen()) {
+        std::cerr << "Unable to open " << output << std::endl;
+        return 1;
+    }
+    std::map<std::string, std::map<std::string, double>> baseline;
+    if(!baselinePath.empty()) {
+        baseline = readBaseline(baselinePath);
+        if(baseline.empty()) {
+            std::cerr << "No case found in the baseline " << baselinePath << std::endl;
+            return 1;
+        }
+    }
+
+    unsigned int regressions = 0;
+    for(const BenchCase& bench : suite) {
+        if(bench.name.find(filter) == std::string::npos) continue;
+        Measure best;
+        for(unsigned int i = 0 ; i < repeat ; i++) {
+            Measure current = measure(bench, nets, timeout);
+            if(i == 0 || current.wall < best.wall) best = current;
+            if(current.status != "ok") break;
+        }
+        double statesPerSecond = best.states / best.wall;
+        double runsPerSecond = best.runs / best.wall;
+        report.field("case", bench.name)
+            .field("status", best.status)
+            .field("exit_code", (uint64_t) best.exitCode)
+            .field("wall", best.wall)
+            .field("peak_rss_kb", best.peakRssKb)
+            .field("states", best.states)
+            .field("states_per_sec", statesPerSecond)
+            .field("runs", best.runs)
+            .field("runs_per_sec", runsPerSecond)
+            .field("estimate", best.estimate)
+            .endLine();
+
+        auto reference = baseline.find(bench.name);
+        if(best.status != "ok") {
+            std::cerr << bench.name << ": " << best.status << std::endl;
+            if(reference != baseline.end()) regressions++;
+            continue;
+        }
+        if(reference == baseline.end()) continue;
+        // Times and memory must not grow, throughputs must not drop
+        auto check = [&](const std::string& key, double value, bool higherIsWorse) {
+            auto field = reference->second.find(key);
+            if(field == reference->second.end() || !std::isfinite(value) || field->second <= 0) return;
+            double change = value / field->second - 1;
+            if(higherIsWorse ? change > threshold : -change > threshold) {
+                std::cerr << bench.name << ": " << key << " " << field->second << " -> " << value
+                          << " (" << (change > 0 ? "+" : "") << change * 100 << "%)" << std::endl;
+                regressions++;
+            }
+        };
+        check("wall", best.wall, true);
+        check("peak_rss_kb", best.peakRssKb, true);
+        check("states_per_sec", statesPerSecond, false);
+        check("runs_per_sec", runsPerSecond, false);
+        // With fixed seeds, other states or estimates are a change of behaviour rather than of speed
+        auto changed = [&](const std::string& key, double value) {
+            auto field = reference->second.find(key);
+            if(field != reference->second.end() && std::isfinite(value) && field->second != value) {
+                std::cerr << bench.name << ": " << key << " changed " << field->second << " -> " << value << std::endl;
+            }
+        };
+        changed("states", best.states);
+        changed("estimate", best.estimate);
+    }
+    if(!baseline.empty()) {
+        std::cerr << regressions << " regression(s) beyond " << threshold * 100 << "%" << std::endl;
+    }
+    return regressions > 0 ? 1 : 0;
+}
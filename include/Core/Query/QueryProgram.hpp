@@ -0,0 +1,138 @@
+/*
+ * QueryProgram.hpp
+ *
+ * A query or an arithmetic expression lowered once into postfix code over place counts,
+ * evaluated on any marking providing numberOfTokensInPlace and canDeadlock, without
+ * going through the visitors.
+ */
+
+#ifndef QUERYPROGRAM_HPP_
+#define QUERYPROGRAM_HPP_
+
+#include "AST.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace VerifyTAPN { namespace AST {
+
+    class QueryProgram {
+    public:
+
+        enum Opcode : uint8_t {
+            PUSH,           // the constant a
+            TOKENS,         // the number of tokens in place a
+            ADD, SUB, MUL, NEG,
+            LT, LE, EQ, NE,
+            // Comparisons of the tokens in place a to the constant b
+            TOKENS_LT, TOKENS_LE, TOKENS_GT, TOKENS_GE, TOKENS_EQ, TOKENS_NE,
+            NOT,
+            DEADLOCK,
+            // Short-circuits of and / or : jumps to a keeping the value, pops it otherwise
+            JUMP_IF_FALSE,
+            JUMP_IF_TRUE
+        };
+
+        struct Instruction {
+            Opcode op;
+            int32_t a;
+            int32_t b;
+        };
+
+        QueryProgram() = default;
+
+        explicit QueryProgram(Query &query);
+
+        // A proposition of a query, evaluated without the negation of its quantifier
+        explicit QueryProgram(Expression &expr);
+
+        explicit QueryProgram(ArithmeticExpression &expr);
+
+        // Whether the marking satisfies the query, negated as the QueryVisitor does for AG, AF and PG
+        template<typename T>
+        bool holds(const T &marking, const TAPN::TimedArcPetriNet &tapn, int maxDelay = 0) const {
+            return (execute(marking, tapn, maxDelay) != 0) != negated;
+        }
+
+        template<typename T>
+        int32_t value(const T &marking, const TAPN::TimedArcPetriNet &tapn, int maxDelay = 0) const {
+            return execute(marking, tapn, maxDelay);
+        }
+
+        const std::vector<Instruction> &getCode() const {
+            return code;
+        }
+
+    private:
+
+        friend class QueryCompiler;
+
+        static constexpr size_t LOCAL_STACK = 32;
+
+        template<typename T>
+        int32_t execute(const T &marking, const TAPN::TimedArcPetriNet &tapn, int maxDelay) const;
+
+        std::vector<Instruction> code;
+        size_t maxDepth = 0;
+        bool negated = false;
+    };
+
+    template<typename T>
+    int32_t QueryProgram::execute(const T &marking, const TAPN::TimedArcPetriNet &tapn, int maxDelay) const {
+        if (code.empty()) return 0;
+        int32_t local[LOCAL_STACK];
+        std::vector<int32_t> spilled;
+        int32_t *stack = local;
+        if (maxDepth > LOCAL_STACK) {
+            spilled.resize(maxDepth);
+            stack = spilled.data();
+        }
+        // top points past the last value pushed
+        int32_t *top = stack;
+        bool deadlockChecked = false;
+        bool deadlocked = false;
+        const size_t size = code.size();
+        size_t pc = 0;
+        while (pc < size) {
+            const Instruction &ins = code[pc++];
+            switch (ins.op) {
+                case PUSH: *top++ = ins.a; break;
+                case TOKENS: *top++ = (int32_t) marking.numberOfTokensInPlace(ins.a); break;
+                case ADD: top--; top[-1] += top[0]; break;
+                case SUB: top--; top[-1] -= top[0]; break;
+                case MUL: top--; top[-1] *= top[0]; break;
+                case NEG: top[-1] = -top[-1]; break;
+                case LT: top--; top[-1] = top[-1] < top[0]; break;
+                case LE: top--; top[-1] = top[-1] <= top[0]; break;
+                case EQ: top--; top[-1] = top[-1] == top[0]; break;
+                case NE: top--; top[-1] = top[-1] != top[0]; break;
+                case TOKENS_LT: *top++ = (int32_t) marking.numberOfTokensInPlace(ins.a) < ins.b; break;
+                case TOKENS_LE: *top++ = (int32_t) marking.numberOfTokensInPlace(ins.a) <= ins.b; break;
+                case TOKENS_GT: *top++ = (int32_t) marking.numberOfTokensInPlace(ins.a) > ins.b; break;
+                case TOKENS_GE: *top++ = (int32_t) marking.numberOfTokensInPlace(ins.a) >= ins.b; break;
+                case TOKENS_EQ: *top++ = (int32_t) marking.numberOfTokensInPlace(ins.a) == ins.b; break;
+                case TOKENS_NE: *top++ = (int32_t) marking.numberOfTokensInPlace(ins.a) != ins.b; break;
+                case NOT: top[-1] = !top[-1]; break;
+                case DEADLOCK:
+                    if (!deadlockChecked) {
+                        deadlockChecked = true;
+                        deadlocked = marking.canDeadlock(tapn, maxDelay);
+                    }
+                    *top++ = deadlocked;
+                    break;
+                case JUMP_IF_FALSE:
+                    if (!top[-1]) pc = ins.a;
+                    else top--;
+                    break;
+                case JUMP_IF_TRUE:
+                    if (top[-1]) pc = ins.a;
+                    else top--;
+                    break;
+            }
+        }
+        return top[-1];
+    }
+
+} }
+
+#endif /* QUERYPROGRAM_HPP_ */
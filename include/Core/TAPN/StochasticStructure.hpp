@@ -1,6 +1,7 @@
 #ifndef STOCHASTIC_STRUCTURE
 #define STOCHASTIC_STRUCTURE
 
+#include <cmath>
 #include <random>
 #include <sstream>
 #include <string>
@@ -115,9 +116,15 @@ namespace VerifyTAPN::SMC {
                     date = std::geometric_distribution(parameters.geometric.p)(engine);
                     break;
                 case Triangular: {
-                        std::vector<double> points{parameters.triangular.a, parameters.triangular.c, parameters.triangular.c};
-                        std::vector<double> grad{0,1,0};
-                        date = std::piecewise_linear_distribution(points.begin(), points.end(), grad.begin())(engine);
+                        // Inverse CDF, a and b are the bounds and c the mode
+                        const double a = parameters.triangular.a;
+                        const double b = parameters.triangular.b;
+                        const double c = parameters.triangular.c;
+                        double u = std::uniform_real_distribution(0.0, 1.0)(engine);
+                        double split = (b > a) ? (c - a) / (b - a) : 0;
+                        date = u < split ?
+                            a + std::sqrt(u * (b - a) * (c - a)) :
+                            b - std::sqrt((1 - u) * (b - a) * (b - c));
                     }
                     break;
                 case LogNormal: 
@@ -2,13 +2,20 @@
 #define WATCH_EXPR_HPP_
 
 #include "Core/Query/AST.hpp"
+#include "Core/Query/QueryProgram.hpp"
 
 #include <cmath>
+#include <limits>
+#include <map>
 #include <string>
 #include <sstream>
 
 namespace VerifyTAPN::DiscreteVerification {
     class RealMarking;
+    namespace Util {
+        class PartialWriter;
+        class PartialReader;
+    }
 }
 using VerifyTAPN::DiscreteVerification::RealMarking;
 
@@ -16,11 +23,21 @@ using VerifyTAPN::AST::ArithmeticExpression;
 
 namespace VerifyTAPN::TAPN {
 
+    // The values a watch took along one run, with the steps and dates it took them at
+    struct WatchRun {
+        std::vector<float> values;
+        std::vector<float> timestamps;
+        std::vector<unsigned int> steps;
+
+        void write(DiscreteVerification::Util::PartialWriter& out) const;
+        void read(DiscreteVerification::Util::PartialReader& in);
+    };
+
     class Watch {
-        friend class WatchAggregator;
 
         protected:
             ArithmeticExpression* _expr;
+            VerifyTAPN::AST::QueryProgram _program;
             std::vector<float> _values;
             std::vector<float> _timestamps;
             std::vector<unsigned int> _steps;
@@ -30,10 +47,12 @@ namespace VerifyTAPN::TAPN {
             float _max_step = 0;
 
         public:
-            Watch(TimedArcPetriNet* tapn, ArithmeticExpression* expr) : _expr(expr), _tapn(tapn) { }
+            Watch(TimedArcPetriNet* tapn, ArithmeticExpression* expr) : _expr(expr), _program(*expr), _tapn(tapn) { }
 
             float new_marking(RealMarking* marking, const uint32_t precision);
             void close();
+            // Closes the watch and moves its values to run, the watch is then reset
+            void take(WatchRun& run);
 
             std::string get_plots(const std::string& name) const;
 
@@ -42,13 +61,84 @@ namespace VerifyTAPN::TAPN {
             size_t n_values() const;
     };
 
+    // Running statistics of the values held over one interval of a plot, weighted by how long
+    // they were held. A value held for no time only counts for the min and the max.
+    struct WatchBin {
+        double sum = 0;
+        double weight = 0;
+        float min = std::numeric_limits<float>::quiet_NaN();
+        float max = std::numeric_limits<float>::quiet_NaN();
+
+        void add(float value, double length);
+        void merge(const WatchBin& other);
+        float avg() const;
+
+        void write(DiscreteVerification::Util::PartialWriter& out) const;
+        void read(DiscreteVerification::Util::PartialReader& in);
+    };
+
+    // Point 0 of an axis holds the values at 0, the point i > 0 the values held over
+    // ((i - 1) delta, i delta]. Delta is the smallest power of two putting the longest run within
+    // scale points (at least 1 on the integral step axis), the axis stays within scale + 1 points
+    // whatever the bound of the query. As the runs get longer, delta doubles and the points are
+    // merged two by two, so axes filled apart merge into the axis of all their runs. A scale of
+    // 0 keeps every step, and every distinct timestamp on the time axis : the axes then grow
+    // with the runs.
+    class WatchAxis {
+
+        public:
+
+            void init(unsigned int scale, bool integral);
+            void reset();
+
+            template<typename T>
+            void add_run(const std::vector<T>& xs, const std::vector<float>& values);
+            void merge(const WatchAxis& other);
+
+            // The points of an axis initialized as this one, only those holding values are written
+            void write(DiscreteVerification::Util::PartialWriter& out) const;
+            void read(DiscreteVerification::Util::PartialReader& in);
+
+            void get_points(std::vector<float>& xs, std::vector<float>& avg, std::vector<float>& min, std::vector<float>& max) const;
+
+        private:
+
+            // Delta of the axis once a run reached x, 0 on the time axis until a run lasted
+            double delta_for(double x) const;
+            // Widens the points until the longest run fits, and adds those up to it
+            void fit(double x);
+            void widen();
+
+            // Values held from step from to step to, both included
+            void add_steps(float value, double from, double to);
+            // Value held from date from to date to
+            void add_span(float value, double from, double to);
+
+            unsigned int _scale = 0;
+            bool _integral = false;
+            double _delta = 0;
+            double _longest = 0;
+            std::vector<WatchBin> _bins;
+            // Exact time axis, one point per timestamp
+            std::map<float, WatchBin> _points;
+
+    };
+
+    // Folds the watchs of each run into its axes as soon as the run is closed, so that the
+    // memory used only depends on the number of points of the plots, not on the number of runs
     class WatchAggregator {
 
         public:
 
-            void new_watch(Watch* watch);
+            void init(unsigned int stepBins, unsigned int timeBins);
+
+            void add_run(const WatchRun& run);
+            void merge(const WatchAggregator& other);
 
-            void aggregate(unsigned int stepBins, unsigned int timeBins);
+            void write(DiscreteVerification::Util::PartialWriter& out) const;
+            void read(DiscreteVerification::Util::PartialReader& in);
+
+            void aggregate();
             void reset();
 
             std::string get_plots(const std::string& name) const;
@@ -63,22 +153,54 @@ namespace VerifyTAPN::TAPN {
             std::vector<float> time_min;
             std::vector<float> time_max;
 
-            std::vector<std::vector<float>> watch_values;
-            std::vector<std::vector<float>> watch_timestamps;
-            std::vector<std::vector<unsigned int>> watch_steps;
-
             float global_steps_avg = 0.0;
             float global_time_avg = 0.0;
 
         private:
 
             void resetAggregation();
-            void aggregateSteps(unsigned int stepBins);
-            void infiniteTimeAggreg();
-            void aggregateTime(unsigned int timeBins);
+
+            WatchAxis steps_axis;
+            WatchAxis time_axis;
 
     };
 
+    // Value k is held from xs[k] until xs[k + 1], the last one only at the end of the run
+    template<typename T>
+    void WatchAxis::add_run(const std::vector<T>& xs, const std::vector<float>& values)
+    {
+        if(xs.empty()) {
+            return;
+        }
+        if(_scale == 0 && !_integral) {
+            for(size_t i = 0 ; i < xs.size() ; i++) {
+                _points[xs[i]].add(values[i], 1);
+            }
+            return;
+        }
+        fit(xs.back());
+        if(!_integral) {
+            // The value at 0 is the last one taken at 0, the others were held for no time
+            size_t start = 0;
+            while(start + 1 < xs.size() && xs[start + 1] <= 0) {
+                start++;
+            }
+            _bins[0].add(values[start], 1);
+        }
+        for(size_t k = 0 ; k + 1 < xs.size() ; k++) {
+            if(_integral) {
+                add_steps(values[k], xs[k], (double) xs[k + 1] - 1);
+            } else {
+                add_span(values[k], xs[k], xs[k + 1]);
+            }
+        }
+        if(_integral) {
+            add_steps(values.back(), xs.back(), xs.back());
+        } else {
+            add_span(values.back(), xs.back(), xs.back());
+        }
+    }
+
     using Observable = std::tuple<std::string, ArithmeticExpression*>;
 
     template<typename T>
@@ -38,6 +38,10 @@ namespace VerifyTAPN {
             ANY_TRACE, SATISFYING_TRACES, UNSATISFYING_TRACES
         };
 
+        enum SMCRandomEngine {
+            XOSHIRO256PP, PCG64
+        };
+
         VerificationOptions() = default;
 
     public: // inspectors
@@ -227,6 +231,167 @@ namespace VerifyTAPN {
             parallel = value;
         }
 
+        inline unsigned int getSmcThreads() const {
+            return smcThreads;
+        }
+
+        inline void setSmcThreads(const unsigned int value) {
+            smcThreads = value;
+        }
+
+        inline unsigned int getSmcBatchSize() const {
+            return smcBatchSize;
+        }
+
+        inline void setSmcBatchSize(const unsigned int value) {
+            smcBatchSize = value;
+        }
+
+        inline bool hasSmcTimeBudget() const {
+            return smcTimeBudget >= 0;
+        }
+
+        inline double getSmcTimeBudget() const {
+            return smcTimeBudget;
+        }
+
+        inline void setSmcTimeBudget(const double value) {
+            smcTimeBudget = value;
+        }
+
+        inline unsigned int getSmcProcesses() const {
+            return smcProcesses;
+        }
+
+        inline void setSmcProcesses(const unsigned int value) {
+            smcProcesses = value;
+        }
+
+        inline const std::vector<std::string>& getSmcWorkerCommands() const {
+            return smcWorkerCommands;
+        }
+
+        inline void setSmcWorkerCommands(const std::vector<std::string>& value) {
+            smcWorkerCommands = value;
+        }
+
+        inline bool isSmcDistributed() const {
+            return smcProcesses > 0 || !smcWorkerCommands.empty();
+        }
+
+        inline bool isSmcWorker() const {
+            return smcWorker;
+        }
+
+        inline void setSmcWorker(const bool value) {
+            smcWorker = value;
+        }
+
+        inline bool hasSmcShard() const {
+            return smcShardCount > 0;
+        }
+
+        inline uint64_t getSmcShardIndex() const {
+            return smcShardIndex;
+        }
+
+        inline uint64_t getSmcShardCount() const {
+            return smcShardCount;
+        }
+
+        inline void setSmcShard(const uint64_t index, const uint64_t count) {
+            smcShardIndex = index;
+            smcShardCount = count;
+        }
+
+        inline const std::string& getSmcPartialOutput() const {
+            return smcPartialOutput;
+        }
+
+        inline void setSmcPartialOutput(const std::string& value) {
+            smcPartialOutput = value;
+        }
+
+        inline const std::vector<std::string>& getSmcMergeFiles() const {
+            return smcMergeFiles;
+        }
+
+        inline void setSmcMergeFiles(const std::vector<std::string>& value) {
+            smcMergeFiles = value;
+        }
+
+        inline uint64_t getSmcSeed() const {
+            return smcSeed;
+        }
+
+        inline void setSmcSeed(const uint64_t value) {
+            smcSeed = value;
+        }
+
+        inline SMCRandomEngine getSmcRandomEngine() const {
+            return smcRandomEngine;
+        }
+
+        inline void setSmcRandomEngine(const SMCRandomEngine value) {
+            smcRandomEngine = value;
+        }
+
+        inline bool isSequentialEstimation() const {
+            return sequentialEstimation;
+        }
+
+        inline void setSequentialEstimation(const bool value) {
+            sequentialEstimation = value;
+        }
+
+        inline bool isSmcCommonRuns() const {
+            return smcCommonRuns;
+        }
+
+        inline void setSmcCommonRuns(const bool value) {
+            smcCommonRuns = value;
+        }
+
+        inline unsigned int getSplittingEffort() const {
+            return splittingEffort;
+        }
+
+        inline void setSplittingEffort(const unsigned int value) {
+            splittingEffort = value;
+        }
+
+        inline const std::string& getSplittingScore() const {
+            return splittingScore;
+        }
+
+        inline void setSplittingScore(const std::string& value) {
+            splittingScore = value;
+        }
+
+        inline unsigned int getImportanceSamplingRuns() const {
+            return importanceSamplingRuns;
+        }
+
+        inline void setImportanceSamplingRuns(const unsigned int value) {
+            importanceSamplingRuns = value;
+        }
+
+        inline const std::string& getProgressOutput() const {
+            return progressOutput;
+        }
+
+        inline void setProgressOutput(const std::string& value) {
+            progressOutput = value;
+        }
+
+        inline unsigned int getProgressInterval() const {
+            return progressInterval;
+        }
+
+        inline void setProgressInterval(const unsigned int value) {
+            progressInterval = value;
+        }
+
         inline bool mustPrintCumulative() const {
             return printCumulative;
         }
@@ -315,6 +480,28 @@ namespace VerifyTAPN {
         bool benchmark = false;
         unsigned int benchmarkRuns = 100;
         bool parallel = false;
+        unsigned int smcThreads = 0;
+        unsigned int smcBatchSize = 0;
+        // Seconds, negative when the runs are not budgeted
+        double smcTimeBudget = -1;
+        // Distributed SMC : local worker processes, commands starting remote ones
+        unsigned int smcProcesses = 0;
+        std::vector<std::string> smcWorkerCommands;
+        bool smcWorker = false;
+        // File based distribution, no shard when the count is 0
+        uint64_t smcShardIndex = 0;
+        uint64_t smcShardCount = 0;
+        std::string smcPartialOutput;
+        std::vector<std::string> smcMergeFiles;
+        uint64_t smcSeed = 0;
+        SMCRandomEngine smcRandomEngine = XOSHIRO256PP;
+        bool sequentialEstimation = false;
+        bool smcCommonRuns = false;
+        unsigned int splittingEffort = 0;
+        std::string splittingScore;
+        unsigned int importanceSamplingRuns = 0;
+        std::string progressOutput;
+        unsigned int progressInterval = 1000;
         bool printCumulative = false;
         unsigned int cumulativeRoundingDigits = 2;
         unsigned int stepsStatsScale = 2000;
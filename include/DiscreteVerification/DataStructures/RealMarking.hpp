@@ -10,44 +10,44 @@ using namespace VerifyTAPN::DiscreteVerification::Util;
 
 namespace VerifyTAPN::DiscreteVerification {
 
+    // Tokens store the date of the global clock at which they were created,
+    // so that letting time pass does not have to touch them
     class RealToken {
 
         private:
 
-            clockValue age;
+            clockValue birth;
             int count;
 
         public:
 
-            RealToken(clockValue value, int count) : age(value), count(count) { }
+            RealToken(clockValue birth, int count) : birth(birth), count(count) { }
             RealToken(const RealToken&) = default;
-            RealToken(const Token& t) : count(t.getCount()) {
-                age = t.getAge();
+            RealToken(const Token& t, clockValue now) : count(t.getCount()) {
+                birth = now - t.getAge();
             }
 
             inline int cmp(const RealToken &t) const {
                 if (count != t.count) return count - t.count;
-                return age - t.age > 0 ? 1 : -1;
+                return t.birth - birth > 0 ? 1 : -1;
             }
 
-            inline bool equals(const RealToken &t) const { return (this->age == t.age && this->count == t.count); };
+            inline bool equals(const RealToken &t) const { return (this->birth == t.birth && this->count == t.count); };
 
             inline void add(int num) { count = count + num; };
 
             inline int getCount() const { return count; };
 
-            inline clockValue getAge() const { return age; };
+            inline clockValue getBirth() const { return birth; };
 
-            inline void setAge(clockValue i) { age = i; };
+            inline clockValue getAge(clockValue now) const { return now - birth; };
+
+            inline void setBirth(clockValue date) { birth = date; };
 
             inline void setCount(int i) { count = i; };
 
             inline void remove(int num) { count = count - num; };
 
-            inline void deltaAge(clockValue x) {
-                age += x;
-            }
-
     };
 
     typedef std::vector<RealToken> RealTokenList;
@@ -65,9 +65,9 @@ namespace VerifyTAPN::DiscreteVerification {
                 tokens = p.tokens;
             };
 
-            RealPlace(const Place& p) : place(p.place) {
+            RealPlace(const Place& p, clockValue now) : place(p.place) {
                 for(const auto& token : p.tokens) {
-                    tokens.push_back(RealToken(token));
+                    add(RealToken(token, now));
                 }
             }
 
@@ -85,31 +85,26 @@ namespace VerifyTAPN::DiscreteVerification {
                 return count;
             }
 
-            inline void deltaAge(clockValue x) {
-                for(auto& token : tokens) {
-                    token.deltaAge(x);
-                }
-            }
-
-            inline clockValue maxTokenAge() const {
+            // Tokens are sorted from the youngest to the oldest, i.e. by decreasing birth date
+            inline clockValue maxTokenAge(clockValue now) const {
                 if(tokens.size() == 0) {
                     return 0;
                 }
-                return tokens.back().getAge();
+                return tokens.back().getAge(now);
             }
 
             void add(RealToken new_token);
 
-            void add(clockValue age = 0) {
-                add(RealToken(age, 1));
+            void add(clockValue birth) {
+                add(RealToken(birth, 1));
             }
 
             bool remove(RealToken to_remove);
 
-            clockValue availableDelay(const uint32_t precision) const {
+            clockValue availableDelay(const uint32_t precision, clockValue now) const {
                 if(tokens.size() == 0) return std::numeric_limits<clockValue>::max();
                 clockValue bound = toClock(place->getInvariant().getBound(), precision);
-                clockValue maxAge = maxTokenAge();
+                clockValue maxAge = maxTokenAge(now);
                 if(bound < maxAge) {
                     return 0;
                 }
@@ -134,14 +129,21 @@ namespace VerifyTAPN::DiscreteVerification {
 
             explicit RealMarking(TAPN::TimedArcPetriNet* net, NonStrictMarkingBase& base);
             RealMarking(const RealMarking& other);
+            // Same semantics as the copy constructor, but reuses the already allocated token lists
+            RealMarking& operator=(const RealMarking& other);
 
             uint32_t size() const;
     
             RealPlaceList& getPlaceList();
             RealTokenList& getTokenList(int placeId);
 
+            // O(1), only the global clock moves
             void deltaAge(clockValue x);
 
+            inline clockValue getGlobalClock() const { return globalClock; }
+
+            inline clockValue tokenAge(const RealToken& token) const { return token.getAge(globalClock); }
+
             NonStrictMarkingBase generateImage();
 
             uint32_t numberOfTokensInPlace(int placeId) const;
@@ -181,6 +183,10 @@ namespace VerifyTAPN::DiscreteVerification {
             bool enables(TAPN::TimedTransition* transition, const uint32_t precision);
 
             unsigned int _thread_id = 0;
+            // Set by the run generator : the run the marking belongs to and the number of
+            // transitions fired since its start, 0 for a marking out of any run
+            uint64_t _run_stamp = 0;
+            uint32_t _firings = 0;
 
         private:
 
@@ -190,6 +196,7 @@ namespace VerifyTAPN::DiscreteVerification {
             const TAPN::TimedTransition *generatedBy = nullptr;
             clockValue fromDelay = 0;
             clockValue totalAge = 0;
+            clockValue globalClock = 0;
 
             static RealTokenList emptyTokenList;
 
@@ -0,0 +1,35 @@
+#ifndef SMCTRACE_HPP
+#define SMCTRACE_HPP
+
+#include "DiscreteVerification/DataStructures/RealMarking.hpp"
+#include "DiscreteVerification/Util/ClockValue.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace VerifyTAPN::DiscreteVerification {
+
+    // A run, recorded as the steps taken from the origin marking of its generator. The
+    // markings are only rebuilt, by SMCRunGenerator::replay, when the trace is printed
+    struct SMCTrace {
+
+        struct Step {
+            Util::clockValue delay;
+            int32_t transition; // Index of the fired transition, -1 if time only passed
+        };
+
+        std::vector<Step> steps;
+        // Tokens consumed by the transitions firing in random mode, in firing then arc order,
+        // the other modes always consume the same tokens of a given marking
+        std::vector<RealToken> chosenTokens;
+
+        inline void clear() {
+            steps.clear();
+            chosenTokens.clear();
+        }
+
+    };
+
+}
+
+#endif /* SMCTRACE_HPP */
@@ -20,6 +20,8 @@
 #include "VerificationTypes/ProbabilityEstimation.hpp"
 #include "VerificationTypes/ProbabilityFloatComparison.hpp"
 #include "VerificationTypes/SMCTracesGenerator.hpp"
+#include "VerificationTypes/SMCMultiQuery.hpp"
+#include "VerificationTypes/SplittingEstimation.hpp"
 #include "VerificationTypes/SMCVerification.hpp"
 #include "SearchStrategies/SearchFactory.h"
 
@@ -45,6 +47,11 @@ namespace VerifyTAPN { namespace DiscreteVerification {
         static int run(TAPN::TimedArcPetriNet &tapn, const std::vector<int>& initialPlacement, AST::Query *query,
                        VerificationOptions &options);
 
+        // Several SMC queries are checked on the same runs, other queries only verify the first one.
+        // Sets up the net for the queries verified.
+        static int run(TAPN::TimedArcPetriNet &tapn, const std::vector<int>& initialPlacement,
+                       const std::vector<AST::Query *>& queries, VerificationOptions &options);
+
     };
 } }
 
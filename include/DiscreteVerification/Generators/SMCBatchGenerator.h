@@ -0,0 +1,144 @@
+/*
+ * File:   SMCBatchGenerator.h
+ *
+ * Simulates a batch of independent SMC runs in lockstep. The state of the runs is stored
+ * by structure of arrays, one lane per run : token counts per place, sampled dates and
+ * enabling per transition, each laid out contiguously over the lanes, so that enabling,
+ * the search of the earliest date and the firings are loops over lanes the compiler
+ * vectorizes. Only nets whose runs depend on nothing but the number of tokens of their
+ * places are supported, a lane then takes the very same run as SMCRunGenerator would.
+ */
+
+#ifndef SMCBATCHGENERATOR_H
+#define SMCBATCHGENERATOR_H
+
+#include "DiscreteVerification/Util/ClockValue.hpp"
+#include "DiscreteVerification/Util/Random.hpp"
+#include "DiscreteVerification/Util/DistributionSampler.hpp"
+#include "DiscreteVerification/DataStructures/RealMarking.hpp"
+#include "Core/TAPN/TimedArcPetriNet.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace VerifyTAPN {
+    namespace DiscreteVerification {
+
+        using Util::clockValue;
+
+        class SMCBatchGenerator {
+
+        public:
+
+            // Nets without transport arcs, guards or invariants, whose transitions do not pick
+            // their tokens at random and cannot sample an infinite date
+            static bool supports(const TAPN::TimedArcPetriNet &tapn);
+
+            SMCBatchGenerator(TAPN::TimedArcPetriNet &tapn, const RealMarking &origin, uint64_t seed,
+                              Util::RandomEngine::Kind engine, unsigned int numericPrecision, size_t lanes);
+
+            SMCBatchGenerator(const SMCBatchGenerator&) = delete;
+            SMCBatchGenerator& operator=(const SMCBatchGenerator&) = delete;
+
+            inline size_t lanes() const { return _lanes; }
+
+            // Starts run number run in lane, with the random stream SMCRunGenerator::reset(run) uses
+            void start(size_t lane, uint64_t run);
+            // Frees lane, the tokens it reached count in the place statistics when the run is done
+            void stop(size_t lane, bool done = true);
+            inline bool isActive(size_t lane) const { return _active[lane] != 0; }
+            size_t activeLanes() const;
+
+            // Samples the dates of the transitions the current markings newly enable, and finds
+            // the date of the next firing of every active lane
+            void schedule();
+            // Fires the next transition of every active lane, a lane without any stays maximal
+            void advance();
+
+            inline bool reachedEnd(size_t lane) const { return _maximal[lane] != 0; }
+            inline uint64_t getRunIndex(size_t lane) const { return _runs[lane]; }
+            inline clockValue getRunDelay(size_t lane) const { return _now[lane]; }
+            inline int getRunSteps(size_t lane) const { return _steps[lane]; }
+
+            // Marking of a lane, as read by the query programs
+            struct LaneMarking {
+                const SMCBatchGenerator &batch;
+                size_t lane;
+
+                inline uint32_t numberOfTokensInPlace(int place) const {
+                    return batch._tokens[place * batch._lanes + lane];
+                }
+
+                inline bool canDeadlock(const TAPN::TimedArcPetriNet &tapn, int maxDelay) const {
+                    return batch._next[lane] == std::numeric_limits<clockValue>::max();
+                }
+            };
+
+            inline LaneMarking marking(size_t lane) const { return LaneMarking { *this, lane }; }
+
+            inline const std::vector<uint32_t>& getTransitionsStatistics() const { return _transitionsStatistics; }
+            inline const std::vector<uint32_t>& getPlacesStatistics() const { return _placesStatistics; }
+
+        private:
+
+            struct Arc {
+                uint32_t place;
+                uint32_t weight;
+            };
+
+            struct Effect {
+                uint32_t place;
+                int32_t delta;
+            };
+
+            static constexpr int32_t NO_WINNER = -1;
+
+            void sample(size_t transition, size_t lane);
+            size_t breakTie(size_t lane);
+
+            TAPN::TimedArcPetriNet &_tapn;
+            const size_t _lanes;
+            const size_t _nPlaces;
+            const size_t _nTransitions;
+            const uint64_t _seed;
+            const unsigned int _numericPrecision;
+
+            // Per transition, the tokens it needs (at least one per input arc), those that
+            // disable it, and the change of the tokens of each place it fires
+            std::vector<std::vector<Arc>> _preset;
+            std::vector<std::vector<Arc>> _inhibitors;
+            std::vector<std::vector<Effect>> _effects;
+            std::vector<uint32_t> _originTokens;
+
+            // Place (or transition) major : entry i * _lanes + lane
+            std::vector<uint32_t> _tokens;
+            std::vector<uint32_t> _peakTokens;
+            std::vector<clockValue> _dates;
+            std::vector<uint8_t> _enabled;
+            std::vector<Util::DistributionSampler> _samplers;
+
+            // Per lane
+            std::vector<clockValue> _now;
+            std::vector<clockValue> _next;
+            std::vector<int32_t> _winner;
+            std::vector<uint32_t> _ties;
+            std::vector<int> _steps;
+            std::vector<int> _sampleIndex;
+            std::vector<uint8_t> _active;
+            std::vector<uint8_t> _maximal;
+            std::vector<uint64_t> _runs;
+            std::vector<Util::RandomEngine> _rngs;
+
+            std::vector<uint32_t> _transitionsStatistics;
+            std::vector<uint32_t> _placesStatistics;
+            // Scratch buffers of breakTie
+            std::vector<size_t> _tied;
+            std::vector<size_t> _infinite;
+
+        };
+
+    }
+}
+
+#endif /* SMCBATCHGENERATOR_H */
@@ -11,10 +11,17 @@
 #include "DiscreteVerification/Generators/Generator.h"
 #include "DiscreteVerification/Util/IntervalOps.hpp"
 #include "DiscreteVerification/Util/ClockValue.hpp"
+#include "DiscreteVerification/Util/EventQueue.hpp"
+#include "DiscreteVerification/Util/Random.hpp"
+#include "DiscreteVerification/Util/DistributionSampler.hpp"
 #include "Core/Query/SMCQuery.hpp"
 #include "DiscreteVerification/DataStructures/RealMarking.hpp"
+#include "DiscreteVerification/DataStructures/SMCTrace.hpp"
 #include "Core/TAPN/StochasticStructure.hpp"
 
+#include <memory>
+#include <cmath>
+
 namespace VerifyTAPN {
     namespace DiscreteVerification {
 
@@ -31,43 +38,49 @@ namespace VerifyTAPN {
             , _currentPlacesStatistics(tapn.getNumberOfPlaces(), 0)
             , _placesStatistics(tapn.getNumberOfPlaces(), 0)
             , _numericPrecision(numericPrecision)
-            {
-                std::random_device rd;
-                _rng = std::ranlux48(rd());
-            };
+            { };
+
+            SMCRunGenerator(const SMCRunGenerator&) = delete;
+            SMCRunGenerator& operator=(const SMCRunGenerator&) = delete;
 
             ~SMCRunGenerator() {
                 delete _origin;
-                if(_trace.size() > 0) {
-                    for(RealMarking* marking : _trace) {
-                        if(marking != nullptr) delete marking;
-                    }
-                }
-                else if(_parent != nullptr) delete _parent;
+                delete _parent;
+                delete _spare;
             }
 
             virtual void prepare(RealMarking *parent);
             virtual RealMarking* next();
             virtual void reset();
+            // Starts run number run, its random stream only depends on the seed, run and part,
+            // part tells apart the independent runs drawn under a same number
+            void reset(uint64_t run, unsigned int part = 0);
+            inline uint64_t getRunIndex() const { return _run; }
 
-            SMCRunGenerator copy() const;
+            inline void setSeed(uint64_t seed) { _seed = seed; }
+            inline void setEngine(Util::RandomEngine::Kind kind) { _rng.select(kind); }
 
-            RealMarking* getMarking() { return _parent; }
+            std::unique_ptr<SMCRunGenerator> copy() const;
 
-            void refreshTransitionsIntervals();
+            RealMarking* getMarking() { return _parent; }
 
-            void disableTransitions(RealMarking* marking);
+            void updateTransitionsIntervals(TimedTransition* fired);
 
-            std::vector<Util::interval<clockValue>> transitionFiringDates(TimedTransition* transi);
-            std::vector<Util::interval<clockValue>> arcFiringDates(TimeInterval time_interval, uint32_t weight, RealTokenList& tokens);
+            void transitionFiringDates(TimedTransition* transi, std::vector<Util::interval<clockValue>>& firingDates);
+            void arcFiringDates(TimeInterval time_interval, uint32_t weight, RealTokenList& tokens, clockValue now, std::vector<Util::interval<clockValue>>& firingDates);
             
-            std::vector<RealToken> removeRandom(RealTokenList& tokenlist, const TimeInterval& interval, const int weight);
-            std::vector<RealToken> removeYoungest(RealTokenList& tokenlist, const TimeInterval& interval, const int weight);
-            std::vector<RealToken> removeOldest(RealTokenList& tokenlist, const TimeInterval& interval, const int weight);
+            void removeRandom(RealTokenList& tokenlist, const TimeInterval& interval, const int weight, clockValue now, std::vector<RealToken>& consumed);
+            void removeYoungest(RealTokenList& tokenlist, const TimeInterval& interval, const int weight, clockValue now, std::vector<RealToken>& consumed);
+            void removeOldest(RealTokenList& tokenlist, const TimeInterval& interval, const int weight, clockValue now, std::vector<RealToken>& consumed);
 
             std::pair<TimedTransition*, clockValue> getWinnerTransitionAndDelay();
+            // Index of the winner of a race between simultaneous transitions, drawn by their weights,
+            // infty_weights is scratch space
+            static size_t weightedChoice(const TimedArcPetriNet& tapn, const std::vector<size_t>& winner_indexs, Util::RandomEngine& rng, std::vector<size_t>& infty_weights);
 
             RealMarking* fire(TimedTransition* transi);
+            // Consumes and produces the tokens of transi in child, a copy of the marking it fires from
+            void applyFiring(TimedTransition* transi, RealMarking& child);
 
             bool reachedEnd() const;
 
@@ -77,27 +90,107 @@ namespace VerifyTAPN {
             void printTransitionStatistics(std::ostream &out, const size_t& n = 1) const;
             void printPlaceStatistics(std::ostream &out, const size_t& n = 1) const;
             void mergeStatistics(const SMCRunGenerator& other);
+            void mergeStatistics(const std::vector<uint32_t>& transitions, const std::vector<uint32_t>& places);
+            void resetStatistics();
+            inline const std::vector<uint32_t>& getTransitionsStatistics() const { return _transitionsStatistics; }
+            inline const std::vector<uint32_t>& getPlacesStatistics() const { return _placesStatistics; }
+
+            inline const SMCTrace& getTrace() const { return _trace; }
+            // Rebuilds the markings of a trace recorded by this generator (or a copy of it),
+            // the caller owns them
+            std::stack<RealMarking*> replay(const SMCTrace& trace);
+
+            // Point reached by a run, from which copies of the run can be continued
+            struct RunState {
+                std::unique_ptr<RealMarking> marking;
+                std::vector<std::vector<Util::interval<clockValue>>> transitionIntervals;
+                std::vector<clockValue> datesSampled;
+                Util::EventQueue events;
+                std::vector<size_t> atUpperBound;
+                std::vector<size_t> enabledTransitions;
+                std::vector<size_t> enabledPosition;
+                clockValue invariantBound = 0;
+                clockValue lastDelay = 0;
+                clockValue totalTime = 0;
+                int totalSteps = 0;
+                int sampleIndex = 0;
+                bool maximal = false;
+                double logLikelihood = 0;
+            };
 
-            std::stack<RealMarking*> getTrace() const;
+            void saveState(RunState& state) const;
+            // Continues the run from state, drawing from the random stream set by the last reset
+            void restoreState(const RunState& state);
+
+            // Importance sampling : per transition, factor applied to the rate of its exponential
+            // distribution and to its weight when racing with simultaneous transitions
+            struct ImportanceBias {
+                std::vector<double> rates;
+                std::vector<double> weights;
+            };
+
+            // What cross-entropy tuning needs to know of a run, per transition : the number and sum
+            // of the exponential samples drawn, the number of times it won a race between
+            // simultaneous transitions, and its unbiased probability to win these races
+            struct ImportanceStatistics {
+                std::vector<double> samples;
+                std::vector<double> sampleSums;
+                std::vector<double> chosen;
+                std::vector<double> expected;
+            };
+
+            // Takes effect at the next prepare
+            inline void setImportanceBias(const ImportanceBias& bias) { _bias = bias; }
+            inline const ImportanceBias& getImportanceBias() const { return _bias; }
+            // Likelihood of the current run under the net over its likelihood under the bias
+            inline double getLikelihoodRatio() const { return std::exp(_logLikelihood); }
+            inline const ImportanceStatistics& getImportanceStatistics() const { return _importance; }
 
             bool recordTrace = false;
+            bool recordImportance = false;
 
             unsigned int _thread_id = 0;
             
         protected:
         
             TimedTransition* chooseWeightedWinner(const std::vector<size_t>& winner_indexs);
+            TimedTransition* chooseBiasedWinner(const std::vector<size_t>& winner_indexs);
+            void weighSample(size_t i, double sample);
+            void removeTokens(TimedTransition* transi, RealTokenList& tokenList, const TimeInterval& interval, const int weight, clockValue now);
+            void removeChosen(RealTokenList& tokenList, const int weight, std::vector<RealToken>& consumed);
+
+            void resetParent();
+            void stampParent();
+            void buildDependencyIndex();
+            void buildSamplers();
+            void markDependents(const TimedPlace& place);
+            void computeTransitionIntervals(TimedTransition* transi);
+            bool updateSampledDate(size_t i);
+            void setEnabled(size_t i, bool enabled);
+            clockValue nextEventDate() const;
             
             bool _maximal = false;
             TimedArcPetriNet& _tapn;
             std::vector<std::vector<Util::interval<clockValue>>> _defaultTransitionIntervals; // Type not pretty, but need disjoint intervals
+            // Firing intervals and sampled dates are dated from the start of the run (_totalTime),
+            // so that a delay leaves them untouched, the invariant bound is only applied when read
             std::vector<std::vector<Util::interval<clockValue>>> _transitionIntervals; // Type not pretty, but need disjoint intervals
             std::vector<clockValue> _dates_sampled;
+            Util::EventQueue _events; // Per transition, earliest of its sampled date and its next interval bound
+            std::vector<std::vector<size_t>> _placeDependents; // Transitions whose firing dates depend on each place
+            std::vector<bool> _dirtyTransitions;
+            std::vector<size_t> _touched;
+            std::vector<size_t> _atUpperBound; // Enabled transitions that cannot wait any longer, revisited by the next step
+            std::vector<size_t> _enabledTransitions;
+            std::vector<size_t> _enabledPosition;
+            clockValue _originMaxDelay = std::numeric_limits<clockValue>::max();
+            clockValue _invariantBound = std::numeric_limits<clockValue>::max();
             std::vector<uint32_t> _transitionsStatistics;
             std::vector<uint32_t> _currentPlacesStatistics;
             std::vector<uint32_t> _placesStatistics;
-            RealMarking* _origin;
-            RealMarking* _parent;
+            RealMarking* _origin = nullptr;
+            RealMarking* _parent = nullptr;
+            RealMarking* _spare = nullptr; // Previous marking of the run, recycled by the next firing
             clockValue _lastDelay = 0;
             clockValue _totalTime = 0;
             int _totalSteps = 0;
@@ -105,9 +198,28 @@ namespace VerifyTAPN {
 
             uint32_t _numericPrecision = 0;
 
-            std::ranlux48 _rng;
-
-            std::vector<RealMarking*> _trace;
+            uint64_t _seed = 0;
+            uint64_t _run = 0;
+            Util::RandomEngine _rng;
+            std::vector<Util::DistributionSampler> _samplers; // One per transition, stateful so never shared between generators
+
+            ImportanceBias _bias;
+            double _logLikelihood = 0;
+            ImportanceStatistics _importance;
+
+            SMCTrace _trace;
+            const SMCTrace* _replaying = nullptr;
+            size_t _replayToken = 0;
+
+            // Scratch buffers, kept between steps so that a run does not allocate once warmed up
+            std::vector<Util::interval<clockValue>> _invInterval;
+            std::vector<Util::interval<clockValue>> _firingDates;
+            std::vector<Util::interval<clockValue>> _arcDates;
+            std::vector<Util::interval<clockValue>> _scratchDates;
+            std::vector<RealToken> _consumed;
+            std::vector<std::pair<const TimedPlace*, RealToken>> _toCreate;
+            std::vector<size_t> _winners;
+            std::vector<size_t> _inftyWinners;
             
         };
 
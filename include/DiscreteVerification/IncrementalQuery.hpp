@@ -0,0 +1,130 @@
+/*
+ * IncrementalQuery.hpp
+ *
+ * A query split into its propositions, each compiled on its own, and the and / or / not
+ * structure over them. Along a run, only the propositions over the places changed by the
+ * last firing are evaluated again, and the changes are propagated up the structure.
+ */
+
+#ifndef INCREMENTALQUERY_HPP_
+#define INCREMENTALQUERY_HPP_
+
+#include "Core/Query/AST.hpp"
+#include "Core/Query/QueryProgram.hpp"
+#include "Core/TAPN/TimedArcPetriNet.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace VerifyTAPN { namespace DiscreteVerification {
+
+    class RealMarking;
+
+    class IncrementalQuery {
+    public:
+
+        // Values of the nodes on the last marking evaluated, one state per run being simulated
+        struct State {
+            std::vector<uint8_t> values;
+            std::vector<uint32_t> trueChildren;
+            uint64_t run = 0;
+            uint32_t firings = 0;
+        };
+
+        IncrementalQuery(AST::Query &query, const TAPN::TimedArcPetriNet &tapn);
+
+        // Evaluates the query on the marking of a run. When the marking follows the one the state
+        // was last evaluated on, only the propositions over the places the firing in between
+        // changed, and those depending on time through deadlock, are evaluated again.
+        bool holds(State &state, const RealMarking &marking) const;
+
+        template<typename T>
+        void evaluate(State &state, const T &marking, int maxDelay = 0) const;
+
+        // Evaluates the given propositions again, the other ones are unchanged since the last evaluation
+        template<typename T>
+        void update(State &state, const T &marking, const std::vector<uint32_t> &changed, int maxDelay = 0) const;
+
+        bool result(const State &state) const {
+            return (state.values[ROOT] != 0) != negated;
+        }
+
+        size_t numberOfPropositions() const {
+            return propositions.size();
+        }
+
+    private:
+
+        enum NodeKind : uint8_t {
+            PROPOSITION, AND, OR, NOT
+        };
+
+        struct Node {
+            NodeKind kind;
+            uint32_t parent;
+            uint32_t children = 0;
+        };
+
+        static constexpr uint32_t ROOT = 0;
+        static constexpr uint32_t NO_PARENT = std::numeric_limits<uint32_t>::max();
+
+        uint32_t build(AST::Expression &expr, uint32_t parent);
+        void addChildren(NodeKind kind, AST::Expression &expr, uint32_t node);
+
+        bool nodeValue(const State &state, uint32_t node) const {
+            const Node &n = nodes[node];
+            switch (n.kind) {
+                case AND: return state.trueChildren[node] == n.children;
+                case OR: return state.trueChildren[node] > 0;
+                case NOT: return state.trueChildren[node] == 0;
+                default: return state.values[node] != 0;
+            }
+        }
+
+        void propagate(State &state, uint32_t node) const;
+
+        // Parents come before their children
+        std::vector<Node> nodes;
+        // Node of each proposition, and its program
+        std::vector<uint32_t> propositions;
+        std::vector<AST::QueryProgram> programs;
+        // Propositions that can change when the tokens of a place, or only time, change
+        std::vector<std::vector<uint32_t>> placePropositions;
+        std::vector<uint32_t> timedPropositions;
+        // Propositions over the places changed by each transition
+        std::vector<std::vector<uint32_t>> transitionPropositions;
+        const TAPN::TimedArcPetriNet &tapn;
+        bool negated = false;
+    };
+
+    // Nodes come after their parents, so the children are done first walking them backwards
+    template<typename T>
+    void IncrementalQuery::evaluate(State &state, const T &marking, int maxDelay) const {
+        state.values.resize(nodes.size());
+        state.trueChildren.assign(nodes.size(), 0);
+        for (size_t i = 0; i < propositions.size(); i++) {
+            state.values[propositions[i]] = programs[i].value(marking, tapn, maxDelay) != 0;
+        }
+        for (size_t node = nodes.size(); node-- > 0;) {
+            state.values[node] = nodeValue(state, node);
+            if (state.values[node] && nodes[node].parent != NO_PARENT) {
+                state.trueChildren[nodes[node].parent]++;
+            }
+        }
+    }
+
+    template<typename T>
+    void IncrementalQuery::update(State &state, const T &marking, const std::vector<uint32_t> &changed, int maxDelay) const {
+        for (uint32_t i : changed) {
+            uint32_t node = propositions[i];
+            uint8_t value = programs[i].value(marking, tapn, maxDelay) != 0;
+            if (value == state.values[node]) continue;
+            state.values[node] = value;
+            propagate(state, node);
+        }
+    }
+
+} }
+
+#endif /* INCREMENTALQUERY_HPP_ */
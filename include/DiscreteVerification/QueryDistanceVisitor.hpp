@@ -0,0 +1,117 @@
+/*
+ * QueryDistanceVisitor.hpp
+ *
+ * Distance of a marking to the satisfaction of a query : the number of tokens that
+ * must be added or removed for the query to hold, 0 exactly when it holds.
+ */
+
+#ifndef QUERYDISTANCEVISITOR_HPP_
+#define QUERYDISTANCEVISITOR_HPP_
+
+#include "DiscreteVerification/QueryVisitor.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace VerifyTAPN { namespace DiscreteVerification {
+
+    using namespace AST;
+
+    // Arithmetic expressions are evaluated as by QueryVisitor, negations are pushed down to
+    // the atomic propositions. The result is an IntResult.
+    template<typename T>
+    class QueryDistanceVisitor : public QueryVisitor<T> {
+    public:
+
+        QueryDistanceVisitor(T &marking, const TAPN::TimedArcPetriNet &tapn) : QueryVisitor<T>(marking, tapn) { }
+
+        ~QueryDistanceVisitor() override = default;
+
+        using QueryVisitor<T>::visit;
+
+        void visit(NotExpression &expr, AST::Result &context) override;
+
+        void visit(OrExpression &expr, AST::Result &context) override;
+
+        void visit(AndExpression &expr, AST::Result &context) override;
+
+        void visit(AtomicProposition &expr, AST::Result &context) override;
+
+        void visit(BoolExpression &expr, AST::Result &context) override;
+
+        void visit(Query &query, AST::Result &context) override;
+
+        void visit(DeadlockExpression &expr, AST::Result &context) override;
+
+    private:
+        int distance(int left, AtomicProposition::op_e op, int right) const;
+
+        bool negated = false;
+    };
+
+    template<typename T>
+    void QueryDistanceVisitor<T>::visit(NotExpression &expr, AST::Result &context) {
+        negated = !negated;
+        expr.getChild().accept(*this, context);
+        negated = !negated;
+    }
+
+    template<typename T>
+    void QueryDistanceVisitor<T>::visit(OrExpression &expr, AST::Result &context) {
+        IntResult left, right;
+        expr.getLeft().accept(*this, left);
+        expr.getRight().accept(*this, right);
+        static_cast<IntResult &>(context).value = negated ?
+            left.value + right.value : std::min(left.value, right.value);
+    }
+
+    template<typename T>
+    void QueryDistanceVisitor<T>::visit(AndExpression &expr, AST::Result &context) {
+        IntResult left, right;
+        expr.getLeft().accept(*this, left);
+        expr.getRight().accept(*this, right);
+        static_cast<IntResult &>(context).value = negated ?
+            std::min(left.value, right.value) : left.value + right.value;
+    }
+
+    template<typename T>
+    void QueryDistanceVisitor<T>::visit(AtomicProposition &expr, AST::Result &context) {
+        IntResult left;
+        expr.getLeft().accept(*this, left);
+        IntResult right;
+        expr.getRight().accept(*this, right);
+        static_cast<IntResult &>(context).value = distance(left.value, expr.getOperator(), right.value);
+    }
+
+    template<typename T>
+    void QueryDistanceVisitor<T>::visit(BoolExpression &expr, AST::Result &context) {
+        static_cast<IntResult &>(context).value = expr.getValue() != negated ? 0 : 1;
+    }
+
+    template<typename T>
+    void QueryDistanceVisitor<T>::visit(Query &query, AST::Result &context) {
+        negated = query.getQuantifier() == AG || query.getQuantifier() == AF || query.getQuantifier() == PG;
+        query.getChild()->accept(*this, context);
+    }
+
+    template<typename T>
+    void QueryDistanceVisitor<T>::visit(DeadlockExpression &expr, AST::Result &context) {
+        BoolResult deadlocked;
+        QueryVisitor<T>::visit(expr, deadlocked);
+        static_cast<IntResult &>(context).value = deadlocked.value != negated ? 0 : 1;
+    }
+
+    template<typename T>
+    int QueryDistanceVisitor<T>::distance(int left, AtomicProposition::op_e op, int right) const {
+        switch(op) {
+            case AtomicProposition::LT: return negated ? std::max(0, right - left) : std::max(0, left - right + 1);
+            case AtomicProposition::LE: return negated ? std::max(0, right - left + 1) : std::max(0, left - right);
+            case AtomicProposition::EQ: return negated ? (left == right ? 1 : 0) : std::abs(left - right);
+            case AtomicProposition::NE: return negated ? std::abs(left - right) : (left == right ? 1 : 0);
+            default: assert(false);
+        }
+        return 0;
+    }
+
+} } /* namespace VerifyTAPN */
+#endif /* QUERYDISTANCEVISITOR_HPP_ */
@@ -0,0 +1,13 @@
+#ifndef ALLOCATIONCOUNTER_HPP
+#define ALLOCATIONCOUNTER_HPP
+
+#include <cstdint>
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    // Number of calls to the global operator new made so far by the calling thread
+    uint64_t threadAllocations();
+
+}
+
+#endif /* ALLOCATIONCOUNTER_HPP */
@@ -0,0 +1,21 @@
+#ifndef BINOMIALINTERVAL_HPP
+#define BINOMIALINTERVAL_HPP
+
+#include <cstdint>
+#include <utility>
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    // Regularized incomplete beta function I_x(a, b)
+    double regularizedBeta(double a, double b, double x);
+
+    // Exact (Clopper-Pearson) two-sided interval of level 1 - alpha for the
+    // parameter of a binomial distribution, after successes out of n trials
+    std::pair<double, double> clopperPearson(uint64_t successes, uint64_t n, double alpha);
+
+    // Quantile of the standard normal distribution, by bisection
+    double normalQuantile(double q);
+
+}
+
+#endif /* BINOMIALINTERVAL_HPP */
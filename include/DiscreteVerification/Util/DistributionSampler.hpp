@@ -0,0 +1,57 @@
+#ifndef DISTRIBUTIONSAMPLER_HPP
+#define DISTRIBUTIONSAMPLER_HPP
+
+#include "Core/TAPN/StochasticStructure.hpp"
+#include "DiscreteVerification/Util/Random.hpp"
+
+#include <random>
+#include <vector>
+
+// Largest number of samples drawn at once by a DistributionSampler
+#define SMC_SAMPLER_BATCH 64
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    // Distribution compiled once into a stateful sampler. Continuous distributions
+    // are drawn by batches : a buffer of uniforms is filled, then transformed in place
+    // by branch free loops. Batches start at one sample after each reset and double
+    // on every refill, so short runs do not waste the engine.
+    class DistributionSampler {
+
+        public:
+
+            explicit DistributionSampler(const SMC::Distribution& distribution);
+
+            inline double operator()(RandomEngine& engine, int& index) {
+                if(_next < _filled) return _buffer[_next++];
+                return draw(engine, index);
+            }
+
+            // Drops the buffered samples and cached state, the next samples only depend on the engine
+            void reset();
+
+        private:
+
+            double draw(RandomEngine& engine, int& index);
+            void refill(RandomEngine& engine);
+
+            static inline double uniform(RandomEngine& engine) {
+                return (engine() >> 11) * 0x1.0p-53;
+            }
+
+            SMC::Distribution _distribution;
+            bool _batched;
+            std::vector<double> _buffer;
+            size_t _next = 0;
+            size_t _filled = 0;
+            size_t _batch = 1;
+
+            std::gamma_distribution<double> _gamma;
+            std::uniform_int_distribution<int> _discreteUniform;
+            std::geometric_distribution<int> _geometric;
+
+    };
+
+}
+
+#endif /* DISTRIBUTIONSAMPLER_HPP */
@@ -0,0 +1,49 @@
+#ifndef EVENTQUEUE_HPP
+#define EVENTQUEUE_HPP
+
+#include "DiscreteVerification/Util/ClockValue.hpp"
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    // Indexed binary min-heap holding one event date per id, ids without
+    // an event are kept with an infinite (max) date
+    class EventQueue {
+
+        public:
+
+            // Sets every date of ids 0 to n - 1 to infinity
+            void reset(size_t n);
+
+            // Moves id to its new date, in O(log n)
+            void update(size_t id, clockValue date);
+
+            inline clockValue top() const {
+                return _heap.empty() ? std::numeric_limits<clockValue>::max() : _heap.front().date;
+            }
+
+            // Appends the ids whose date is at most bound, in no particular order
+            void collect(clockValue bound, std::vector<size_t>& ids) const;
+
+        private:
+
+            struct Event {
+                clockValue date;
+                size_t id;
+            };
+
+            void place(size_t slot, const Event& event);
+            void siftUp(size_t slot);
+            void siftDown(size_t slot);
+
+            std::vector<Event> _heap;
+            std::vector<size_t> _position;
+
+    };
+
+}
+
+#endif /* EVENTQUEUE_HPP */
@@ -150,13 +150,15 @@ namespace VerifyTAPN {
                 first.push_back(element);
             }
 
+            // Writes the intersection into result, reusing its storage, result must not alias the inputs
             template<typename T = int>
-            std::vector<interval<T>> setIntersection(const std::vector<interval<T>> &first,
-                                                  const std::vector<interval<T>> &second) {
-                std::vector<interval<T>> result;
+            void setIntersection(const std::vector<interval<T>> &first,
+                                 const std::vector<interval<T>> &second,
+                                 std::vector<interval<T>> &result) {
+                result.clear();
 
                 if (first.empty() || second.empty()) {
-                    return result;
+                    return;
                 }
 
                 unsigned int i = 0, j = 0;
@@ -179,6 +181,13 @@ namespace VerifyTAPN {
                         j++;
                     }
                 }
+            }
+
+            template<typename T = int>
+            std::vector<interval<T>> setIntersection(const std::vector<interval<T>> &first,
+                                                  const std::vector<interval<T>> &second) {
+                std::vector<interval<T>> result;
+                setIntersection(first, second, result);
                 return result;
             }
 
@@ -0,0 +1,66 @@
+#ifndef LOGHISTOGRAM_HPP
+#define LOGHISTOGRAM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Buckets per power of two, a value is known up to a relative error of 1 / (2 * SUB_BUCKETS)
+#define LOG_HISTOGRAM_SUB_BUCKETS 1024
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    class PartialWriter;
+    class PartialReader;
+
+    // Histogram of non-negative values over log-linear buckets (as HDR histograms), its
+    // memory only depends on the range of the values. Merging adds the counts, so the
+    // result does not depend on how the values were split between instances
+    class LogHistogram {
+
+        public:
+
+            void add(double value, uint64_t count = 1);
+            void merge(const LogHistogram& other);
+            // Empties the histogram, keeping the memory of its buckets
+            void clear();
+
+            // Only the non-empty buckets are written
+            void write(PartialWriter& out) const;
+            void read(PartialReader& in);
+
+            inline uint64_t count() const { return _count; }
+            inline double min() const { return _min; }
+            inline double max() const { return _max; }
+
+            // Smallest bucket value with at least q * count values up to it
+            double quantile(double q) const;
+
+            // Calls f(value, count) for every non-empty bucket, by increasing values
+            template<typename F>
+            void forEach(F f) const {
+                if(_zeros > 0) f(0.0, _zeros);
+                for(size_t i = 0 ; i < _counts.size() ; i++) {
+                    if(_counts[i] > 0) f(bucketValue(_firstKey + (int32_t) i), _counts[i]);
+                }
+            }
+
+        private:
+
+            static int32_t bucketKey(double value);
+            // Middle of the bucket, kept within the values seen
+            double bucketValue(int32_t key) const;
+
+            std::vector<uint64_t> _counts;
+            int32_t _firstKey = 0;
+            uint64_t _zeros = 0;
+            uint64_t _count = 0;
+            double _min = std::numeric_limits<double>::quiet_NaN();
+            double _max = std::numeric_limits<double>::quiet_NaN();
+
+    };
+
+}
+
+#endif /* LOGHISTOGRAM_HPP */
@@ -0,0 +1,90 @@
+#ifndef PARTIALRESULTS_HPP
+#define PARTIALRESULTS_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    // Partial results of SMC runs, exchanged between the processes of a distributed verification
+    // or written to files merged later. A record is one line : its kind, then values separated by
+    // spaces, doubles in hexadecimal so that they read back exactly.
+    class PartialWriter {
+
+        public:
+
+            explicit PartialWriter(const std::string& kind) : _line(kind) { }
+
+            void putUnsigned(uint64_t value);
+            void putSigned(int64_t value);
+            void putDouble(double value);
+
+            // The size of the vector, then its values
+            template<typename T>
+            void putUnsigned(const std::vector<T>& values) {
+                putUnsigned(values.size());
+                for(const T& value : values) putUnsigned(value);
+            }
+
+            template<typename T>
+            void putDouble(const std::vector<T>& values) {
+                putUnsigned(values.size());
+                for(const T& value : values) putDouble(value);
+            }
+
+            // The record, ended by a new line
+            inline std::string line() const { return _line + "\n"; }
+
+        private:
+
+            std::string _line;
+
+    };
+
+    class PartialReader {
+
+        public:
+
+            explicit PartialReader(const std::string& line);
+
+            inline const std::string& kind() const { return _kind; }
+
+            uint64_t getUnsigned();
+            int64_t getSigned();
+            double getDouble();
+
+            template<typename T>
+            void getUnsigned(std::vector<T>& values) {
+                values.resize(getSize());
+                for(T& value : values) value = (T) getUnsigned();
+            }
+
+            template<typename T>
+            void getDouble(std::vector<T>& values) {
+                values.resize(getSize());
+                for(T& value : values) value = (T) getDouble();
+            }
+
+            // Size of a sequence of values, 0 when the record cannot hold that many of them
+            size_t getSize();
+
+            // Whether every value read so far was there and well formed
+            inline bool good() const { return _good; }
+            // For values that are there but make no sense
+            inline void fail() { _good = false; }
+
+        private:
+
+            const char* next();
+
+            std::string _line;
+            std::string _kind;
+            size_t _position = 0;
+            bool _good = true;
+
+    };
+
+}
+
+#endif /* PARTIALRESULTS_HPP */
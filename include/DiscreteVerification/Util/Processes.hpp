@@ -0,0 +1,87 @@
+#ifndef PROCESSES_HPP
+#define PROCESSES_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    // Whether worker processes can be started and talked to, not on Windows
+    bool processesSupported();
+
+    // A worker process, and our ends of the pipes to its standard input and output
+    struct ChildProcess {
+        int pid = -1;
+        int input = -1;
+        int output = -1;
+    };
+
+    // Runs body(input, output) in a fork of this process, which then exits. The fork writes
+    // nothing to our standard output, and closes its copies of the pipes of the siblings.
+    bool forkProcess(const std::function<void(int input, int output)>& body, const std::vector<ChildProcess>& siblings, ChildProcess& child);
+    // Runs command through /bin/sh, with its standard input and output piped to us
+    bool spawnCommand(const std::string& command, ChildProcess& child);
+    // Closes our ends of the pipes and waits for the process, true if it exited with status 0
+    bool waitProcess(ChildProcess& child);
+
+    // A process whose peer went away gets write errors instead of SIGPIPE
+    void ignoreBrokenPipes();
+    // Moves our standard output to a new file descriptor, returned, what is printed from now on
+    // goes to the standard error
+    int detachStandardOutput();
+    // Writes all of data, false once the other end is closed
+    bool writeAll(int fd, const std::string& data);
+    // Reads one line, without its new line, a byte at a time so that nothing after it is taken
+    bool readLine(int fd, std::string& line);
+    // Waits up to timeoutMs for data (or the end of the stream) on some of fds, negative ones
+    // are skipped. Returns the indexes of those ready.
+    std::vector<size_t> waitReadable(const std::vector<int>& fds, int timeoutMs);
+
+    // Splits what comes from a file descriptor into lines
+    class LineReader {
+
+        public:
+
+            explicit LineReader(int fd) : _fd(fd) { }
+
+            // Appends the lines completed by what is available, false once the stream ended
+            bool read(std::vector<std::string>& lines);
+
+        private:
+
+            int _fd;
+            std::string _pending;
+
+    };
+
+    // Raises a stop flag once the line "smc-stop", or the end of the stream, comes from fd, and
+    // raises committed to the n of the lines "smc-committed n"
+    class StopListener {
+
+        public:
+
+            StopListener(int fd, std::atomic<bool>& stop, std::atomic<uint64_t>& committed);
+            ~StopListener();
+
+            StopListener(const StopListener&) = delete;
+            StopListener& operator=(const StopListener&) = delete;
+
+        private:
+
+            void listen();
+
+            int _fd;
+            std::atomic<bool>& _stop;
+            std::atomic<uint64_t>& _committed;
+            std::atomic<bool> _done { false };
+            std::thread _listener;
+
+    };
+
+}
+
+#endif /* PROCESSES_HPP */
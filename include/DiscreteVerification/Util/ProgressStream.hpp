@@ -0,0 +1,56 @@
+#ifndef PROGRESSSTREAM_HPP
+#define PROGRESSSTREAM_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    // "_" is stdout, "&N" the already open file descriptor N, anything else a file. owned tells
+    // whether the caller must close the stream, nullptr when it cannot be opened.
+    FILE* openOutput(const std::string& destination, bool& owned);
+
+    // Progress of a verification as JSON lines, one object per report, each line flushed
+    // as soon as it is complete so that a monitoring process can follow the stream
+    class ProgressStream {
+
+        public:
+
+            // "_" is stdout, "&N" the already open file descriptor N, anything else a file
+            explicit ProgressStream(const std::string& destination);
+            ~ProgressStream();
+
+            ProgressStream(const ProgressStream&) = delete;
+            ProgressStream& operator=(const ProgressStream&) = delete;
+
+            inline bool isOpen() const { return _out != nullptr; }
+
+            // Fields of the current object, non finite numbers are written as null
+            ProgressStream& field(const std::string& key, double value);
+            ProgressStream& field(const std::string& key, uint64_t value);
+            ProgressStream& field(const std::string& key, bool value);
+            ProgressStream& field(const std::string& key, const std::string& value);
+            ProgressStream& field(const std::string& key, const std::vector<double>& values);
+            ProgressStream& nullField(const std::string& key);
+
+            // Writes the current object as one line
+            void endLine();
+
+        private:
+
+            void key(const std::string& key);
+            void number(double value);
+
+            FILE* _out = nullptr;
+            bool _owned = false;
+            std::ostringstream _line;
+            bool _empty = true;
+
+    };
+
+}
+
+#endif /* PROGRESSSTREAM_HPP */
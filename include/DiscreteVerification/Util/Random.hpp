@@ -0,0 +1,179 @@
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+
+#include <cstdint>
+#include <limits>
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    // SplitMix64 step, used to expand a 64 bits seed into engine states
+    inline uint64_t splitmix64(uint64_t& state) {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    // xoshiro256++ (Blackman & Vigna), satisfies UniformRandomBitGenerator
+    // so it can be fed to the standard distributions
+    class Xoshiro256pp {
+
+        public:
+
+            typedef uint64_t result_type;
+
+            Xoshiro256pp() : Xoshiro256pp(0, 0) { }
+
+            // The state only depends on (seed, stream), half of it is drawn from the seed and
+            // half from the stream, so distinct pairs never share a state
+            Xoshiro256pp(uint64_t seed, uint64_t stream) {
+                this->seed(seed, stream);
+            }
+
+            void seed(uint64_t seed, uint64_t stream) {
+                uint64_t fromSeed = seed;
+                uint64_t fromStream = stream ^ splitmix64(seed);
+                _s[0] = splitmix64(fromSeed);
+                _s[1] = splitmix64(fromStream);
+                _s[2] = splitmix64(fromSeed);
+                _s[3] = splitmix64(fromStream);
+            }
+
+            static constexpr result_type min() { return 0; }
+            static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+            inline result_type operator()() {
+                const uint64_t result = rotl(_s[0] + _s[3], 23) + _s[0];
+                const uint64_t t = _s[1] << 17;
+                _s[2] ^= _s[0];
+                _s[3] ^= _s[1];
+                _s[1] ^= _s[2];
+                _s[0] ^= _s[3];
+                _s[2] ^= t;
+                _s[3] = rotl(_s[3], 45);
+                return result;
+            }
+
+        private:
+
+            static inline uint64_t rotl(const uint64_t x, int k) {
+                return (x << k) | (x >> (64 - k));
+            }
+
+            uint64_t _s[4];
+
+    };
+
+    // PCG64, the XSL RR 128/64 generator of O'Neill, satisfies UniformRandomBitGenerator. The
+    // stream selects the increment of the underlying LCG, so distinct streams never overlap.
+    class Pcg64 {
+
+        public:
+
+            typedef uint64_t result_type;
+
+            Pcg64() : Pcg64(0, 0) { }
+
+            Pcg64(uint64_t seed, uint64_t stream) {
+                this->seed(seed, stream);
+            }
+
+            // As pcg64_srandom_r, from a 128 bits state and sequence made of the seed and stream
+            void seed(uint64_t seed, uint64_t stream) {
+                uint64_t state = seed;
+                seed128(splitmix64(state), splitmix64(state), splitmix64(state), stream);
+            }
+
+            void seed128(uint64_t stateHigh, uint64_t stateLow, uint64_t sequenceHigh, uint64_t sequenceLow) {
+                _incHigh = (sequenceHigh << 1) | (sequenceLow >> 63);
+                _incLow = (sequenceLow << 1) | 1;
+                _high = 0;
+                _low = 0;
+                step();
+                _low += stateLow;
+                _high += stateHigh + (_low < stateLow);
+                step();
+            }
+
+            static constexpr result_type min() { return 0; }
+            static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+            inline result_type operator()() {
+                step();
+                uint64_t folded = _high ^ _low;
+                unsigned int rotation = _high >> 58;
+                return (folded >> rotation) | (folded << ((64 - rotation) & 63));
+            }
+
+        private:
+
+            static constexpr uint64_t MULTIPLIER_HIGH = 0x2360ed051fc65da4ULL;
+            static constexpr uint64_t MULTIPLIER_LOW = 0x4385df649fccf645ULL;
+
+            // state = state * multiplier + increment, modulo 2^128
+            inline void step() {
+#ifdef __SIZEOF_INT128__
+                unsigned __int128 product = (unsigned __int128) _low * MULTIPLIER_LOW;
+                uint64_t high = (uint64_t) (product >> 64) + _low * MULTIPLIER_HIGH + _high * MULTIPLIER_LOW;
+                uint64_t low = (uint64_t) product;
+#else
+                uint64_t a = _low >> 32, b = _low & 0xffffffffULL;
+                uint64_t c = MULTIPLIER_LOW >> 32, d = MULTIPLIER_LOW & 0xffffffffULL;
+                uint64_t bd = b * d, ad = a * d, bc = b * c;
+                uint64_t middle = (bd >> 32) + (ad & 0xffffffffULL) + (bc & 0xffffffffULL);
+                uint64_t high = a * c + (ad >> 32) + (bc >> 32) + (middle >> 32) + _low * MULTIPLIER_HIGH + _high * MULTIPLIER_LOW;
+                uint64_t low = (middle << 32) | (bd & 0xffffffffULL);
+#endif
+                _low = low + _incLow;
+                _high = high + _incHigh + (_low < low);
+            }
+
+            uint64_t _high, _low;
+            uint64_t _incHigh, _incLow;
+
+    };
+
+    // Engine used by the SMC run generators, chosen at run time among those above. The choice
+    // costs a branch per draw, always taken the same way.
+    class RandomEngine {
+
+        public:
+
+            enum Kind {
+                XOSHIRO256PP, PCG64
+            };
+
+            typedef uint64_t result_type;
+
+            explicit RandomEngine(Kind kind = XOSHIRO256PP) : _kind(kind) { }
+
+            inline Kind kind() const { return _kind; }
+            // The engine drawn from once it is seeded again
+            inline void select(Kind kind) { _kind = kind; }
+
+            void seed(uint64_t seed, uint64_t stream) {
+                if(_kind == PCG64) {
+                    _pcg.seed(seed, stream);
+                } else {
+                    _xoshiro.seed(seed, stream);
+                }
+            }
+
+            static constexpr result_type min() { return 0; }
+            static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+            inline result_type operator()() {
+                return _kind == PCG64 ? _pcg() : _xoshiro();
+            }
+
+        private:
+
+            Kind _kind;
+            Xoshiro256pp _xoshiro;
+            Pcg64 _pcg;
+
+    };
+
+}
+
+#endif /* RANDOM_HPP */
@@ -0,0 +1,53 @@
+#ifndef REORDERBUFFER_HPP
+#define REORDERBUFFER_HPP
+
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    // Hands back values pushed in any order of their indexes 0, 1, 2... in index order,
+    // only the values beyond the first missing index are kept
+    template<typename T>
+    class ReorderBuffer {
+
+        public:
+
+            void clear() {
+                _pending.clear();
+                _next = 0;
+            }
+
+            // Values whose index was already handed back are ignored
+            void push(uint64_t index, T value) {
+                if(index < _next) return;
+                size_t offset = index - _next;
+                if(_pending.size() <= offset) {
+                    _pending.resize(offset + 1);
+                }
+                _pending[offset] = std::make_pair(true, std::move(value));
+            }
+
+            // Pops the value of the next index if it is known
+            bool pop(T& value) {
+                if(_pending.empty() || !_pending.front().first) return false;
+                value = std::move(_pending.front().second);
+                _pending.pop_front();
+                _next++;
+                return true;
+            }
+
+            // Index of the next value to be handed back
+            inline uint64_t next() const { return _next; }
+
+        private:
+
+            std::deque<std::pair<bool, T>> _pending;
+            uint64_t _next = 0;
+
+    };
+
+}
+
+#endif /* REORDERBUFFER_HPP */
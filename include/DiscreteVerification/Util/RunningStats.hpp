@@ -0,0 +1,46 @@
+#ifndef RUNNINGSTATS_HPP
+#define RUNNINGSTATS_HPP
+
+#include <cstdint>
+#include <limits>
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    class PartialWriter;
+    class PartialReader;
+
+    // Count, mean and variance of a stream of values in constant memory (Welford),
+    // two instances fed with disjoint values merge exactly (Chan et al.)
+    class RunningStats {
+
+        public:
+
+            void add(double value);
+            void merge(const RunningStats& other);
+
+            void write(PartialWriter& out) const;
+            void read(PartialReader& in);
+
+            inline uint64_t count() const { return _count; }
+            inline double mean() const { return _count == 0 ? 0 : _mean; }
+            inline double sum() const { return _mean * _count; }
+            inline double min() const { return _min; }
+            inline double max() const { return _max; }
+
+            // Population variance, as the values are all the runs we made
+            double variance() const;
+            double stdDev() const;
+
+        private:
+
+            uint64_t _count = 0;
+            double _mean = 0;
+            double _m2 = 0;
+            double _min = std::numeric_limits<double>::quiet_NaN();
+            double _max = std::numeric_limits<double>::quiet_NaN();
+
+    };
+
+}
+
+#endif /* RUNNINGSTATS_HPP */
@@ -0,0 +1,46 @@
+#ifndef TIMEBUDGET_HPP
+#define TIMEBUDGET_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    // Raises a stop flag once a wall-clock deadline is reached, or as soon as the process
+    // receives SIGTERM or SIGUSR1, so that the SMC runs can end with the results at hand.
+    // The signals are caught while the budget lives, their previous handlers restored after.
+    class TimeBudget {
+
+        public:
+
+            // No deadline when seconds is 0, only the signals then raise the flag
+            TimeBudget(double seconds, std::atomic<bool>& stop);
+            ~TimeBudget();
+
+            TimeBudget(const TimeBudget&) = delete;
+            TimeBudget& operator=(const TimeBudget&) = delete;
+
+            // Whether the deadline or a signal raised the flag
+            inline bool expired() const { return _expired.load(); }
+
+        private:
+
+            void watch();
+
+            std::atomic<bool>& _stop;
+            std::atomic<bool> _expired { false };
+            bool _hasDeadline;
+            std::chrono::steady_clock::time_point _deadline;
+            std::mutex _mutex;
+            std::condition_variable _wake;
+            bool _done = false;
+            std::thread _watcher;
+
+    };
+
+}
+
+#endif /* TIMEBUDGET_HPP */
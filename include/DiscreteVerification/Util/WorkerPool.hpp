@@ -0,0 +1,50 @@
+#ifndef WORKERPOOL_HPP
+#define WORKERPOOL_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    // Number of cores this process may use, taking affinity and cgroup CPU quotas into account
+    unsigned int availableCores();
+
+    // Fixed set of threads, kept alive between tasks so that successive
+    // verification phases do not pay thread creation again
+    class WorkerPool {
+
+        public:
+
+            explicit WorkerPool(unsigned int n_threads);
+            ~WorkerPool();
+
+            WorkerPool(const WorkerPool&) = delete;
+            WorkerPool& operator=(const WorkerPool&) = delete;
+
+            inline unsigned int size() const { return _threads.size(); }
+
+            // Runs task(thread_id) once on every worker, returns when all of them are done
+            void run(const std::function<void(unsigned int)>& task);
+
+        private:
+
+            void work(unsigned int thread_id);
+
+            std::vector<std::thread> _threads;
+            std::mutex _mutex;
+            std::condition_variable _start;
+            std::condition_variable _done;
+            const std::function<void(unsigned int)>* _task = nullptr;
+            uint64_t _generation = 0;
+            unsigned int _running = 0;
+            bool _stop = false;
+
+    };
+
+}
+
+#endif /* WORKERPOOL_HPP */
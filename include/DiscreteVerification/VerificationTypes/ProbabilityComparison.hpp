@@ -1,8 +1,8 @@
 #ifndef PROBABILITYCOMPARISON_HPP
 #define PROBABILITYCOMPARISON_HPP
 
-#include "DiscreteVerification/VerificationTypes/Verification.hpp"
-#include "DiscreteVerification/Generators/SMCRunGenerator.h"
+#include "DiscreteVerification/VerificationTypes/SMCVerification.hpp"
+#include "DiscreteVerification/Util/ReorderBuffer.hpp"
 #include "Core/Query/SMCQuery.hpp"
 
 #define INDIFFERENT 0
@@ -11,7 +11,11 @@
 
 namespace VerifyTAPN::DiscreteVerification {
 
-class ProbabilityComparison : public Verification<RealMarking> {
+// Tests whether query_1 is at least as likely as query_2. Every run number draws one
+// independent run per query, or a single run checked against both with --smc-common-runs,
+// and the pairs of outcomes are fed in run order to two sequential tests : one on the
+// pairs that disagree, one deciding indifference.
+class ProbabilityComparison : public SMCVerification {
 
     public:
 
@@ -19,35 +23,61 @@ class ProbabilityComparison : public Verification<RealMarking> {
             TAPN::TimedArcPetriNet &tapn, RealMarking &initialMarking, AST::SMCQuery *query_1, AST::SMCQuery *query_2, VerificationOptions options
         );
 
-        virtual bool run();
-        virtual bool executeRunFor(AST::SMCQuery *query);
+        void prepare() override;
 
-        bool handleSuccessor(AST::SMCQuery *query, RealMarking* marking);
+        bool executeRun(SMCRunGenerator* generator = nullptr) override;
+        bool executeRunFor(AST::SMCQuery *query, SMCRunGenerator* generator);
+        void executeCommonRun(SMCRunGenerator* generator);
 
-        void handleRunsResults(bool resQ1, bool resQ2);
+        bool handleMarking(RealMarking& marking) override;
+        void handleRunResult(const bool res, int steps, double delay, uint64_t run, unsigned int thread_id = 0) override;
+        bool mustDoAnotherRun() override;
 
-        bool reachedRunBound(AST::SMCQuery *query);
+        void initRunsResults(unsigned int n_threads = 1) override;
+        void mergeRunResults(unsigned int thread_id) override;
+        void discardRunResults(unsigned int thread_id) override;
+        void finalizeRunsResults() override;
 
-        bool mustDoAnotherRun();
+        void handleRunsResults(bool resQ1, bool resQ2);
 
         int getResult();
 
         void computeAcceptingBounds(const float alpha, const float beta);
         void computeIndifferenceRegion(const float p, const float sigma0, const float sigma1);
 
-        void printStats();
-
-        void printResult();
+        void printStats() override;
 
-        unsigned int maxUsedTokens() override;
-        void setMaxTokensIfGreater(unsigned int i);
+        void printResult() override;
 
     protected:
 
-        SMCRunGenerator runGenerator;
+        bool evaluate(AST::SMCQuery *query, RealMarking& marking);
+        void recordRunLength(SMCRunGenerator* generator, double timeBound, int stepBound);
+
+        struct PairOutcome {
+            bool resQ1 = false;
+            bool resQ2 = false;
+            int steps = 0;
+            double delay = 0;
+        };
+
+        // Pair being run by each thread, and the pairs it finished since its last merge
+        std::vector<PairOutcome> threadCurrent;
+        std::vector<std::vector<std::pair<uint64_t, PairOutcome>>> threadOutcomes;
+        Util::ReorderBuffer<PairOutcome> pendingOutcomes;
+        uint64_t committedPairs = 0;
+        double committedTime = 0;
+        uint64_t committedSteps = 0;
+
         AST::SMCQuery *query_1;
         AST::SMCQuery *query_2;
-        size_t numberOfRuns;
+        // query_1 is the query of the verification
+        AST::QueryProgram program_2;
+        IncrementalQuery incrementalQuery_2;
+        std::vector<IncrementalQuery::State> queryStates_2;
+        // A common run is simulated up to the larger bounds of the two queries
+        double maxTimeBound;
+        int maxStepBound;
 
         bool mayBeIndifferent;
         float ratio_indifferent;
@@ -69,12 +99,9 @@ class ProbabilityComparison : public Verification<RealMarking> {
 
         unsigned int validRunsQ1;
         unsigned int validRunsQ2;
-        unsigned int maxTokensSeen;
-        unsigned long totalTime = 0;
-        unsigned long totalSteps = 0;
 
 };
 
 }
 
-#endif /* PROBABILITYCOMPARISON_HPP */
\ No newline at end of file
+#endif /* PROBABILITYCOMPARISON_HPP */
@@ -3,6 +3,9 @@
 
 #include "DiscreteVerification/VerificationTypes/SMCVerification.hpp"
 #include "Core/TAPN/WatchExpression.hpp"
+#include "DiscreteVerification/Util/RunningStats.hpp"
+#include "DiscreteVerification/Util/LogHistogram.hpp"
+#include "DiscreteVerification/Util/ReorderBuffer.hpp"
 
 namespace VerifyTAPN::DiscreteVerification {
 
@@ -17,18 +20,41 @@ class ProbabilityEstimation : public SMCVerification {
         ProbabilityEstimation(
             TAPN::TimedArcPetriNet &tapn, RealMarking &initialMarking, AST::SMCQuery *query, VerificationOptions options, unsigned int runs
         )
-        : SMCVerification(tapn, initialMarking, query, options), validRuns(0), runsNeeded(runs)
+        : SMCVerification(tapn, initialMarking, query, options), validRuns(0), runsNeeded(runs),
+          importanceRuns(options.getImportanceSamplingRuns())
         { }
 
-        bool handleSuccessor(RealMarking* marking) override;
-        void handleRunResult(const bool res, int steps, double delay, unsigned int thread_id = 0) override;
+        // Stores the likelihood ratio of the run for handleRunResult
+        bool executeRun(SMCRunGenerator* generator = nullptr) override;
+
+        bool handleMarking(RealMarking& marking) override;
+        bool batchable() override;
+        bool distributable() override { return options.getSmcTraces() == 0; }
+        void writeRunResults(Util::PartialWriter& out, unsigned int thread_id) override;
+        void readRunResults(Util::PartialReader& in, unsigned int thread_id) override;
+        void handleRunResult(const bool res, int steps, double delay, uint64_t run, unsigned int thread_id = 0) override;
         bool mustDoAnotherRun() override;
 
         void prepare() override;
 
+        // Multilevel cross-entropy : biases the generator towards the runs closest to satisfying
+        // the query, until the elite runs of an iteration all satisfy it
+        void tuneImportanceBias();
+
+        uint64_t runsBudget() const override { return runsNeeded; }
+        void initRunsResults(unsigned int n_threads = 1) override;
+        void mergeRunResults(unsigned int thread_id) override;
+        void discardRunResults(unsigned int thread_id) override;
+        void finalizeRunsResults() override;
+
         float getEstimation();
 
-        void computeChernoffHoeffdingBound(const float intervalWidth, const float confidence);
+        static uint64_t computeChernoffHoeffdingBound(const float intervalWidth, const float confidence);
+
+        // Level of the next check of the precision, counts it and schedules the one after
+        double nextCheckLevel(double alpha);
+        bool sequentialPrecisionReached();
+        bool weightedPrecisionReached();
 
         void printStats() override;
 
@@ -36,28 +62,78 @@ class ProbabilityEstimation : public SMCVerification {
         void printViolatingRunsStats();
         void printGlobalRunsStats();
 
-        static void printRunsStats(const std::string category, uint64_t n, uint64_t totalSteps, double totalDelay, std::vector<uint64_t> perStep, std::vector<float> perDelay);
+        static void printRunsStats(const std::string category, const Util::RunningStats& delays, const Util::RunningStats& steps, const Util::LogHistogram& delaysSketch);
 
         void printCumulativeStats();
 
         void printWatchStats();
 
         void printResult() override;
+        void printInterruptedResult();
+
+        bool progressEstimate(double& estimate, double& lower, double& upper) override;
 
     protected:
 
+        struct RunOutcome {
+            uint64_t run;
+            bool decisive;
+            int steps;
+            double delay;
+            // Likelihood ratio of the run under importance sampling, 1 otherwise
+            double likelihood;
+            // Values the watchs took along the run
+            std::vector<TAPN::WatchRun> watchs;
+        };
+
+        // The runs are committed in the order of their indexes, whatever the thread or process
+        // that simulated them, so that the stopping rule neither depends on scheduling nor
+        // favours the runs ending early
+        void commitRun(const RunOutcome& outcome);
+
+        // Constant memory, apart from the count of valid runs per number of steps
+        struct RunsStatistics {
+            Util::RunningStats validDelays;
+            Util::RunningStats validSteps;
+            Util::RunningStats violatingDelays;
+            Util::RunningStats violatingSteps;
+            Util::LogHistogram validDelaysSketch;
+            Util::LogHistogram violatingDelaysSketch;
+            std::vector<uint64_t> validPerStep;
+            // Likelihood ratio of the valid runs, 0 for the others, under importance sampling
+            Util::RunningStats weighted;
+        };
+
+        // Outcomes produced by each thread since its last merge
+        std::vector<std::vector<RunOutcome>> threadOutcomes;
+        Util::ReorderBuffer<RunOutcome> pendingOutcomes;
+        uint64_t committedRuns = 0;
+        double committedTime = 0;
+        uint64_t committedSteps = 0;
+        uint64_t committedValidRuns = 0;
+        // The runs committed so far are enough, the others are dropped
+        bool decided = false;
+
         uint64_t runsNeeded;
         uint64_t validRuns;
-        double validRunsTime = 0;
-        uint64_t validRunsSteps = 0;
-        double violatingRunTime = 0;
-        uint64_t violatingRunSteps = 0;
-
-        std::vector<uint64_t> validPerStep;
-        std::vector<float> validPerDelay;
-        std::vector<uint64_t> violatingPerStep;
-        std::vector<float> violatingPerDelay;
-        float maxValidDuration = 0.0f;
+
+        // Sequential estimation, runsNeeded is then only an upper bound, as under importance sampling
+        bool sequential = false;
+        uint64_t hoeffdingRuns = 0;
+        uint64_t nextCheck = 0;
+        unsigned int checks = 0;
+
+        // Importance sampling, runs per cross-entropy iteration (0 when disabled)
+        unsigned int importanceRuns = 0;
+        uint64_t tuningRuns = 0;
+        std::vector<double> threadLikelihoods;
+        // The weighted runs stop on their interval, unless their number is fixed (benchmark)
+        bool weightedStopping = false;
+        // The weighted runs stopped at the requested width, rather than on their cap
+        bool precisionReached = false;
+
+        // Statistics of the runs committed
+        RunsStatistics mergedStats;
 
 };
 
@@ -2,6 +2,7 @@
 #define PROBABILITYFLOATCOMPARISON_HPP
 
 #include "DiscreteVerification/VerificationTypes/SMCVerification.hpp"
+#include "DiscreteVerification/Util/ReorderBuffer.hpp"
 
 namespace VerifyTAPN::DiscreteVerification {
 
@@ -13,10 +14,19 @@ class ProbabilityFloatComparison : public SMCVerification {
             TAPN::TimedArcPetriNet &tapn, RealMarking &initialMarking, AST::SMCQuery *query, VerificationOptions options
         );
 
-        bool handleSuccessor(RealMarking* marking) override;
-        void handleRunResult(const bool res, int steps, double delay, unsigned int thread_id = 0) override;
+        bool handleMarking(RealMarking& marking) override;
+        bool batchable() override { return options.getSmcTraces() == 0; }
+        bool distributable() override { return options.getSmcTraces() == 0; }
+        void writeRunResults(Util::PartialWriter& out, unsigned int thread_id) override;
+        void readRunResults(Util::PartialReader& in, unsigned int thread_id) override;
+        void handleRunResult(const bool res, int steps, double delay, uint64_t run, unsigned int thread_id = 0) override;
         bool mustDoAnotherRun() override;
 
+        void initRunsResults(unsigned int n_threads = 1) override;
+        void mergeRunResults(unsigned int thread_id) override;
+        void discardRunResults(unsigned int thread_id) override;
+        void finalizeRunsResults() override;
+
         bool getResult();
 
         void computeAcceptingBounds(const float alpha, const float beta);
@@ -26,8 +36,29 @@ class ProbabilityFloatComparison : public SMCVerification {
 
         void printResult() override;
 
+        bool progressEstimate(double& estimate, double& lower, double& upper) override;
+
     protected:
 
+        // Wald's test is fed with the outcomes in run order, whatever the thread that produced them,
+        // so that the decision does not depend on scheduling nor favours short runs
+        void commitRun(bool valid);
+
+        struct RunOutcome {
+            uint64_t run;
+            bool valid;
+            int steps;
+            double delay;
+        };
+
+        // Outcomes produced by each thread since its last merge
+        std::vector<std::vector<RunOutcome>> threadOutcomes;
+        Util::ReorderBuffer<RunOutcome> pendingOutcomes;
+        uint64_t committedRuns = 0;
+        double committedTime = 0;
+        uint64_t committedSteps = 0;
+        bool decided = false;
+
         float ratio;
         float p0;
         float p1;
@@ -98,10 +98,7 @@ namespace VerifyTAPN { namespace DiscreteVerification {
             }
 
             if (this->pwList->add(marking)) {
-                QueryVisitor<NonStrictMarking> checker(*marking, this->tapn);
-                BoolResult context;
-                this->query->accept(checker, context);
-                if (context.value) {
+                if (this->queryProgram.holds(*marking, this->tapn)) {
                     this->lastMarking = marking;
                     return true;
                 } else {
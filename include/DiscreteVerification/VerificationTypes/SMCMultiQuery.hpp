@@ -0,0 +1,76 @@
+#ifndef SMCMULTIQUERY_HPP
+#define SMCMULTIQUERY_HPP
+
+#include "DiscreteVerification/VerificationTypes/SMCVerification.hpp"
+#include "Core/Query/SMCQuery.hpp"
+
+#include <memory>
+#include <string>
+
+namespace VerifyTAPN::DiscreteVerification {
+
+// Checks several SMC queries on the same runs. Every run is simulated once, up to the largest
+// bounds, and handed to the verifier of each query still undecided, which sees it exactly as
+// if it had simulated it alone : each query keeps its own bounds, observables and stopping rule.
+class SMCMultiQuery : public SMCVerification {
+
+    public:
+
+        SMCMultiQuery(
+            TAPN::TimedArcPetriNet &tapn, RealMarking &initialMarking, const std::vector<AST::SMCQuery*>& queries,
+            const std::vector<std::string>& names, VerificationOptions options
+        );
+
+        void prepare() override;
+
+        bool executeRun(SMCRunGenerator* generator = nullptr) override;
+
+        // Feeds the marking to the queries still pending in the run, true once none is left
+        bool handleMarking(RealMarking& marking) override;
+        void handleRunResult(const bool res, int steps, double delay, uint64_t run, unsigned int thread_id = 0) override;
+        bool mustDoAnotherRun() override;
+
+        uint64_t runsBudget() const override;
+        void initRunsResults(unsigned int n_threads = 1) override;
+        void mergeRunResults(unsigned int thread_id) override;
+        void discardRunResults(unsigned int thread_id) override;
+        void finalizeRunsResults() override;
+
+        void initWatchs(unsigned int n_threads = 1) override;
+
+        void printStats() override;
+
+        void printResult() override;
+
+    protected:
+
+        // The runs committed by every undecided query, called under run_res_mutex
+        void updateRunsCommitted();
+
+        struct QueryRun {
+            // The query takes part in the run, and has neither held nor exceeded its bounds yet
+            bool active = false;
+            bool pending = false;
+            bool res = false;
+            int steps = 0;
+            double delay = 0;
+        };
+
+        std::vector<std::unique_ptr<SMCVerification>> verifiers;
+        std::vector<std::string> names;
+        std::vector<clockValue> timeBounds;
+        std::vector<int> stepBounds;
+
+        // Set under run_res_mutex once the verifier of a query needs no more runs, the runs
+        // still in progress then are dropped for this query as parallel_run would drop them
+        std::unique_ptr<std::atomic<bool>[]> decided;
+
+        // Indexed by thread, then by query
+        std::vector<std::vector<QueryRun>> threadRuns;
+        std::vector<std::vector<RunsAccumulator>> threadAccs;
+
+};
+
+}
+
+#endif  /* SMCMULTIQUERY_HPP */
@@ -19,8 +19,8 @@ class SMCTracesGenerator : public SMCVerification {
         : SMCVerification(tapn, initialMarking, query, options)
         { }
 
-        bool handleSuccessor(RealMarking* marking) override;
-        void handleRunResult(const bool res, int steps, double delay, unsigned int thread_id = 0) override;
+        bool handleMarking(RealMarking& marking) override;
+        void handleRunResult(const bool res, int steps, double delay, uint64_t run, unsigned int thread_id = 0) override;
         bool mustDoAnotherRun() override;
 
         void printResult() override;
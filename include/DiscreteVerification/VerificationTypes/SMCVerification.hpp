@@ -2,17 +2,30 @@
 #define SMCVERIFICATION_HPP
 
 #include "DiscreteVerification/VerificationTypes/Verification.hpp"
+#include "DiscreteVerification/IncrementalQuery.hpp"
 #include "DiscreteVerification/DataStructures/NonStrictMarking.hpp"
 #include "DiscreteVerification/Generators/SMCRunGenerator.h"
+#include "DiscreteVerification/Generators/SMCBatchGenerator.h"
 #include "Core/Query/SMCQuery.hpp"
 #include "Core/TAPN/WatchExpression.hpp"
+#include "DiscreteVerification/Util/WorkerPool.hpp"
+#include "DiscreteVerification/Util/ProgressStream.hpp"
+#include "DiscreteVerification/Util/TimeBudget.hpp"
+#include "DiscreteVerification/Util/PartialResults.hpp"
+#include "DiscreteVerification/Util/Processes.hpp"
 
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
 
 namespace VerifyTAPN::DiscreteVerification {
 
 class SMCVerification : public Verification<RealMarking> {
 
+    // Drives the verifiers of its queries on the runs it simulates
+    friend class SMCMultiQuery;
+
     public:
 
         SMCVerification(TAPN::TimedArcPetriNet &tapn, RealMarking &initialMarking, AST::SMCQuery *query,
@@ -20,15 +33,56 @@ class SMCVerification : public Verification<RealMarking> {
             : Verification(tapn, initialMarking, query, options)
             , runGenerator(tapn, options.getSMCNumericPrecision())
             , numberOfRuns(0), maxTokensSeen(0), smcSettings(query->getSmcSettings())
-            { }
+            , incrementalQuery(*query, tapn)
+            {
+                runGenerator.setSeed(options.getSmcSeed());
+                runGenerator.setEngine(randomEngine());
+                unsigned int n_threads = options.getSmcThreads();
+                if(n_threads == 0) n_threads = Util::availableCores();
+                queryStates.resize(std::max(1u, n_threads));
+            }
 
         virtual bool run() override;
         virtual bool parallel_run();
+        // Same runs as run and parallel_run, simulated by batches advanced in lockstep
+        bool batch_run(unsigned int n_threads);
+
+        // Whether nothing but the query is evaluated on the markings of the runs, and their
+        // results do not depend on anything SMCBatchGenerator does not keep
+        virtual bool batchable() { return false; }
+
+        // Distributed verification : worker processes each simulate their share of the runs of
+        // the seed, and stream the results of their epochs to this process, which applies the
+        // stopping rule and tells them when to stop. The workers are forked, or started by the
+        // commands of --smc-worker-command.
+        bool coordinate();
+        // --smc-worker : the share of the runs comes from stdin, their results go to stdout
+        bool serveCoordinator();
+        // --smc-shard : the results of the share go to the partial output, for a later merge
+        bool runShard();
+        // --smc-merge : the results are those of the runs of the shards written in files
+        bool mergePartialResults(const std::vector<std::string>& files);
+
+        // Whether the results of the runs can be written by the processes simulating them and
+        // added up by another one
+        virtual bool distributable() { return false; }
+        // Writes the results thread_id gathered since its last epoch, and clears them
+        virtual void writeRunResults(Util::PartialWriter& out, unsigned int thread_id) { }
+        // Adds the results written by writeRunResults to those of thread_id, nothing when the
+        // record is malformed
+        virtual void readRunResults(Util::PartialReader& in, unsigned int thread_id) { }
 
         virtual void prepare() { }
 
         virtual bool executeRun(SMCRunGenerator* generator = nullptr);
 
+        // Evaluates the query and the watchs on the live marking of a run, the marking is not owned
+        virtual bool handleMarking(RealMarking& marking) = 0;
+        // The query on the live marking of a run, incrementally from the last marking of the
+        // run the thread evaluated
+        bool queryHolds(RealMarking& marking);
+        bool handleSuccessor(RealMarking* marking) override;
+
         virtual void printStats() override;
         void printTransitionStatistics() const override;
         void printPlaceStatistics() override;
@@ -38,11 +92,29 @@ class SMCVerification : public Verification<RealMarking> {
 
         virtual bool reachedRunBound(clockValue timeBound, int stepBound, SMCRunGenerator* generator = nullptr);
         
-        virtual void handleRunResult(const bool res, int steps, double delay, unsigned int thread_id = 0) = 0;
+        // Called concurrently by the workers of parallel_run, must only touch the state of thread_id.
+        // Runs are numbered in the order they are claimed, run only depends on the seed and its number
+        virtual void handleRunResult(const bool res, int steps, double delay, uint64_t run, unsigned int thread_id = 0) = 0;
         virtual bool mustDoAnotherRun() = 0;
 
+        // Upper bound on the number of runs, claimed atomically by the workers
+        virtual uint64_t runsBudget() const { return std::numeric_limits<uint64_t>::max(); }
+
+        virtual void initRunsResults(unsigned int n_threads = 1) { }
+        // Folds the results of thread_id into the shared state, called under run_res_mutex
+        virtual void mergeRunResults(unsigned int thread_id) { }
+        // Drops the results thread_id gathered since its last merge, their runs ended after the
+        // verification concluded. Called under run_res_mutex.
+        virtual void discardRunResults(unsigned int thread_id) { }
+        // Called once all the runs are done, no more concurrent access
+        virtual void finalizeRunsResults() { }
+
         virtual void printResult() = 0;
 
+        // Current estimate of the probability and its interval for the progress stream, called
+        // under run_res_mutex, false when the verification has none
+        virtual bool progressEstimate(double& estimate, double& lower, double& upper) { return false; }
+
         inline bool mustSaveTrace() const { return traces.size() < options.getSmcTraces(); }
         virtual void handleTrace(const bool runRes, SMCRunGenerator* generator = nullptr);
         void saveTrace(SMCRunGenerator* generator = nullptr);
@@ -64,10 +136,52 @@ class SMCVerification : public Verification<RealMarking> {
                                       const TAPN::TimeInterval &interval, int weight);
 
         rapidxml::xml_node<> *
-        createTokenNode(rapidxml::xml_document<> &doc, const TAPN::TimedPlace &place, const RealToken &token);
+        createTokenNode(rapidxml::xml_document<> &doc, const TAPN::TimedPlace &place, clockValue age);
 
     protected:
 
+        struct RunsAccumulator {
+            size_t runs = 0;
+            double time = 0;
+            uint64_t steps = 0;
+            // Seconds spent simulating, apart from waiting for run_res_mutex
+            double busy = 0;
+        };
+
+        unsigned int prepareWorkers();
+        // --smc-rng, as the generators take it
+        Util::RandomEngine::Kind randomEngine() const {
+            return options.getSmcRandomEngine() == VerificationOptions::PCG64
+                ? Util::RandomEngine::PCG64 : Util::RandomEngine::XOSHIRO256PP;
+        }
+        // Lanes of the batches asked for, 0 when the runs are simulated one at a time
+        size_t batchLanes();
+        void simulateBatches(SMCBatchGenerator& batch, unsigned int thread_id);
+        // Claims the next run of this process, false once there is none or the verification
+        // stopped. A claim too far ahead of the runs committed is deferred : it fails with
+        // deferred set, and the caller merges what it holds before trying again.
+        bool claimRun(uint64_t& run, bool& deferred);
+        bool mergeEpoch(RunsAccumulator& acc, unsigned int thread_id);
+
+        // Opens the progress stream if one is asked for, and starts its clock
+        void startProgress(unsigned int n_threads);
+        // Reports at most once per progress interval unless done, called under run_res_mutex
+        void reportProgress(bool done);
+
+        // Simulates the runs index, index + count, index + 2 count... of the seed, writing their
+        // results to output epoch by epoch, until they are done or control says to stop
+        void runWorker(uint64_t index, uint64_t count, FILE* output, int control);
+        void writePartialRecord(const Util::PartialWriter& record);
+        // Folds a record written by a worker into the results, false if it is malformed
+        bool foldPartialRecord(Util::PartialReader& record);
+        Util::PartialWriter shardRecord(uint64_t index, uint64_t count) const;
+
+        // Arms the time budget if one is asked for, and the stop and the runs committed sent by
+        // the coordinator of a worker, once stopRequested is cleared
+        void startTimeBudget();
+        // Called once the runs are done, before finalizeRunsResults
+        void stopTimeBudget();
+
         SMCRunGenerator runGenerator;
         SMCSettings smcSettings;
         size_t numberOfRuns;
@@ -75,14 +189,52 @@ class SMCVerification : public Verification<RealMarking> {
         double totalTime = 0;
         uint64_t totalSteps = 0;
         int64_t durationNs = 0;
+        uint64_t allocations = 0;
 
         std::mutex run_res_mutex;
-
-        std::vector<std::stack<RealMarking*>> traces;
+        std::atomic<uint64_t> runsClaimed { 0 };
+        std::atomic<bool> stopRequested { false };
+        // The runs before this one are committed, for a verification committing them in the
+        // order of their indexes, the maximum otherwise. The results of the runs claimed
+        // past it wait for it, claimRun keeps them within SMC_REORDER_WINDOW runs. A worker
+        // process gets it from its coordinator.
+        std::atomic<uint64_t> runsCommitted { std::numeric_limits<uint64_t>::max() };
+
+        std::unique_ptr<Util::TimeBudget> timeBudget;
+        // The runs ended because mustDoAnotherRun said so
+        bool concluded = false;
+        // The time budget stopped the runs before the verification concluded, the results
+        // only hold for the runs completed by then
+        bool interrupted = false;
+
+        // Share of the runs simulated by this process, all of them unless it is a worker
+        uint64_t shardIndex = 0;
+        uint64_t shardCount = 1;
+        // Where a worker writes the results of its epochs, the stopping rule is then up to
+        // whoever reads them
+        FILE* partialOutput = nullptr;
+        // Where the messages of the coordinator of a worker come from, negative if none
+        int controlInput = -1;
+        std::unique_ptr<Util::StopListener> stopListener;
+
+        // Kept between calls to parallel_run, along with one generator per worker
+        std::unique_ptr<Util::WorkerPool> workers;
+        std::vector<std::unique_ptr<SMCRunGenerator>> workerGenerators;
+
+        std::vector<SMCTrace> traces;
+
+        std::unique_ptr<Util::ProgressStream> progress;
+        std::chrono::steady_clock::time_point progressStart;
+        std::chrono::steady_clock::time_point lastProgress;
+        std::vector<double> threadBusy;
 
         std::vector<std::vector<Watch>> watchs;
+        // Aggregated by the verification, from the runs it keeps
         std::vector<WatchAggregator> watch_aggrs;
 
+        IncrementalQuery incrementalQuery;
+        std::vector<IncrementalQuery::State> queryStates;
+
 };
 
 }
@@ -11,6 +11,7 @@
 #include "DiscreteVerification/DataStructures/MarkingStore.h"
 #include "Core/TAPN/TAPN.hpp"
 #include "DiscreteVerification/QueryVisitor.hpp"
+#include "Core/Query/QueryProgram.hpp"
 #include "DiscreteVerification/DataStructures/NonStrictMarkingBase.hpp"
 #include "DiscreteVerification/Generators/GameGenerator.h"
 #include "DiscreteVerification/DataStructures/Waiting.h"
@@ -54,6 +55,7 @@ namespace VerifyTAPN { namespace DiscreteVerification {
         TAPN::TimedArcPetriNet &tapn;
         NonStrictMarking &initial_marking;
         AST::Query *query;
+        AST::QueryProgram queryProgram;
         VerificationOptions options;
         std::vector<int> placeStats;
         std::unique_ptr<GameGenerator> generator;
@@ -0,0 +1,79 @@
+#ifndef SPLITTINGESTIMATION_HPP
+#define SPLITTINGESTIMATION_HPP
+
+#include "DiscreteVerification/VerificationTypes/SMCVerification.hpp"
+#include "Core/Query/SMCQuery.hpp"
+
+#include <limits>
+
+namespace VerifyTAPN::DiscreteVerification {
+
+// Estimates the probability of a rare event by fixed effort multilevel splitting. The runs
+// climb levels of a score : every level starts a fixed number of runs from the states
+// where the runs of the previous level crossed it, and the estimation is the product of the
+// proportions of runs reaching the next level. The score is an observable of the query,
+// or minus the distance of the marking to the query, and markings satisfying the query are
+// above every level.
+class SplittingEstimation : public SMCVerification {
+
+    public:
+
+        SplittingEstimation(
+            TAPN::TimedArcPetriNet &tapn, RealMarking &initialMarking, AST::SMCQuery *query, VerificationOptions options
+        );
+
+        static constexpr int64_t GOAL_LEVEL = std::numeric_limits<int64_t>::max();
+
+        bool run() override;
+        bool parallel_run() override;
+
+        void prepare() override;
+
+        // Runs from the restored state of the generator until it reaches the current threshold
+        bool executeRun(SMCRunGenerator* generator = nullptr) override;
+
+        bool handleMarking(RealMarking& marking) override;
+        // The runs of a level are collected by runLevel, not by the generic loops of SMCVerification
+        void handleRunResult(const bool res, int steps, double delay, uint64_t run, unsigned int thread_id = 0) override { }
+        bool mustDoAnotherRun() override { return false; }
+
+        uint64_t runsBudget() const override { return effort; }
+
+        int64_t level(RealMarking& marking);
+
+        float getEstimation();
+
+        void printStats() override;
+
+        void printResult() override;
+
+    protected:
+
+        struct Crossing {
+            uint64_t run;
+            int64_t level;
+            SMCRunGenerator::RunState state;
+        };
+
+        void runLevels(bool parallel);
+        void runLevel(SMCRunGenerator& generator, uint64_t index, std::vector<Crossing>& crossings, RunsAccumulator& acc);
+
+        unsigned int effort;
+        AST::ArithmeticExpression* score = nullptr;
+        AST::QueryProgram scoreProgram;
+
+        // States the runs of the current level start from, in the order of the runs that reached them
+        std::vector<SMCRunGenerator::RunState> entries;
+        int64_t threshold = 0;
+        uint64_t firstRun = 0;
+        std::vector<std::vector<Crossing>> threadCrossings;
+
+        std::vector<int64_t> levelThresholds;
+        std::vector<double> levelProbabilities;
+        double estimation = 0;
+
+};
+
+}
+
+#endif /* SPLITTINGESTIMATION_HPP */
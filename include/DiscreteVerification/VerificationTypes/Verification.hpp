@@ -3,6 +3,7 @@
 
 #include "DiscreteVerification/DataStructures/NonStrictMarking.hpp"
 #include "../DeadlockVisitor.hpp"
+#include "Core/Query/QueryProgram.hpp"
 
 #include "Core/TAPN/TimedPlace.hpp"
 
@@ -92,6 +93,8 @@ namespace VerifyTAPN { namespace DiscreteVerification {
         TAPN::TimedArcPetriNet &tapn;
         T &initialMarking;
         AST::Query *query;
+        // The query lowered once, evaluated on every marking
+        AST::QueryProgram queryProgram;
         VerificationOptions options;
         std::vector<int> placeStats{};
 
@@ -100,8 +103,9 @@ namespace VerifyTAPN { namespace DiscreteVerification {
     template<typename T>
     Verification<T>::Verification(TAPN::TimedArcPetriNet &tapn, T &initialMarking, AST::Query *query,
                                   VerificationOptions options)
-            : tapn(tapn), initialMarking(initialMarking), query(query), options(std::move(std::move(options))),
-              placeStats(tapn.getNumberOfPlaces()) {
+            : tapn(tapn), initialMarking(initialMarking), query(query),
+              queryProgram(query != nullptr ? AST::QueryProgram(*query) : AST::QueryProgram()),
+              options(std::move(std::move(options))), placeStats(tapn.getNumberOfPlaces()) {
 
     }
 
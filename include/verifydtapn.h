@@ -17,7 +17,7 @@
 
 using namespace VerifyTAPN;
 namespace VerifyTAPN {
-std::unique_ptr<AST::Query> parse_queries(const VerificationOptions& options, const unfoldtacpn::ColoredPetriNetBuilder& builder, const TAPN::TimedArcPetriNet& net);
+std::vector<std::unique_ptr<AST::Query>> parse_queries(const VerificationOptions& options, const unfoldtacpn::ColoredPetriNetBuilder& builder, const TAPN::TimedArcPetriNet& net);
 
 std::pair<std::vector<int>,std::unique_ptr<TAPN::TimedArcPetriNet>>
 build_net(unfoldtacpn::ColoredPetriNetBuilder& builder);
@@ -25,7 +25,7 @@ build_net(unfoldtacpn::ColoredPetriNetBuilder& builder);
 std::pair<std::vector<int>,std::unique_ptr<TAPN::TimedArcPetriNet>>
 parse_net_file(unfoldtacpn::ColoredPetriNetBuilder& builder, const std::string& filename);
 
-std::unique_ptr<AST::Query> make_query(const unfoldtacpn::ColoredPetriNetBuilder& builder, VerificationOptions& options, const TAPN::TimedArcPetriNet& net);
+std::vector<std::unique_ptr<AST::Query>> make_queries(const unfoldtacpn::ColoredPetriNetBuilder& builder, VerificationOptions& options, const TAPN::TimedArcPetriNet& net);
 }
 #endif /* VERIFYDTAPN_H */
 
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <iomanip>
+#include <random>
 #include <boost/program_options.hpp>
 
 namespace po = boost::program_options;
@@ -174,6 +175,24 @@ namespace VerifyTAPN {
             ("strategy-output", po::value<std::string>(), "File to write synthesized strategy to, use '_' (an underscore) for stdout")
             ("smc-benchmark", po::value<unsigned int>(), "Benchmark mode for SMC, runs the number of runs specified to estimate performance")
             ("smc-parallel", po::bool_switch()->default_value(false), "Enable parallel verification for SMC.")
+            ("smc-threads", po::value<unsigned int>(), "Specify the number of threads to use for parallel SMC verification, implies --smc-parallel (default = 0, one per available core)")
+            ("smc-batch", po::value<unsigned int>(), "Simulate SMC runs by batches of the given number of runs advanced in lockstep, for probability estimation and hypothesis testing on nets whose runs only depend on the number of tokens in places (default = 0, one run at a time)")
+            ("smc-time-budget", po::value<double>(), "Stop SMC probability estimation and hypothesis testing after the given number of seconds of runs, or on SIGTERM or SIGUSR1, and report the estimate and confidence interval of the runs completed so far, or an undecided hypothesis (0 = only on a signal)")
+            ("smc-processes", po::value<unsigned int>(), "Distribute the runs of SMC probability estimation and hypothesis testing over the given number of worker processes forked on this host, each simulating its own share of the runs of the seed, merged by this process which applies the stopping rule")
+            ("smc-worker-command", po::value<std::vector<std::string>>()->composing(), "Start an additional SMC worker process through the given shell command, e.g. 'ssh host verifydtapn --smc-worker model.xml query.xml' with the same options, talking to it through its standard input and output. Can be given several times")
+            ("smc-worker", po::bool_switch()->default_value(false), "Act as an SMC worker process : read the share of the runs from stdin, write their partial results to stdout and stop when told to, the rest of the output goes to stderr")
+            ("smc-shard", po::value<std::string>(), "Only simulate the shard K/N (0 <= K < N) of the SMC runs and write their partial results to the file given by --smc-partial-output, to be combined by --smc-merge. Requires --smc-seed, the same for every shard, and --smc-time-budget for hypothesis testing whose runs are not bounded")
+            ("smc-partial-output", po::value<std::string>(), "File the partial results of an SMC shard are written to, use '_' (an underscore) for stdout and '&N' for the open file descriptor N")
+            ("smc-merge", po::value<std::vector<std::string>>()->composing(), "Merge the partial results files of SMC shards instead of simulating runs, and report the result of the runs they hold. Can be given several times")
+            ("smc-seed", po::value<uint64_t>(), "Specify the seed of SMC random runs, a given seed always yields the same runs whatever the number of threads (default : random)")
+            ("smc-rng", po::value<std::string>(), "Specify the random engine of SMC runs, xoshiro256++ or pcg64 (default : xoshiro256++)")
+            ("smc-sequential-estimation", po::bool_switch()->default_value(false), "Stop SMC probability estimation as soon as an exact (Clopper-Pearson) confidence interval is narrow enough, instead of running the number of runs given by the Chernoff-Hoeffding bound")
+            ("smc-common-runs", po::bool_switch()->default_value(false), "Check both queries of an SMC probability comparison on the same run, instead of one independent run per query")
+            ("smc-splitting", po::value<unsigned int>(), "Estimate the probability of a rare SMC event by fixed effort multilevel splitting, with the given number of runs per level")
+            ("smc-splitting-score", po::value<std::string>(), "Name of the query observable used as the splitting score, the levels are its successive integer values (default : distance of the marking to the query)")
+            ("smc-importance-sampling", po::value<unsigned int>(), "Estimate SMC probabilities by importance sampling, biasing the exponential rates and the weights of the transitions by cross-entropy tuning with the given number of runs per iteration (default = 0, no importance sampling)")
+            ("smc-progress", po::value<std::string>(), "Stream the progress of SMC verifications as JSON lines to the given file, use '_' (an underscore) for stdout and '&N' for the open file descriptor N")
+            ("smc-progress-interval", po::value<unsigned int>(), "Specify the number of milliseconds between two SMC progress reports (default = 1000)")
             ("smc-print-cumulative-stats", po::value<unsigned int>(), "Prints the cumulative probability stats for SMC quantitative estimation, specifying the rounding precision")
             ("smc-steps-scale", po::value<unsigned int>(), "Specify the number of slices to use to print steps cumulative stats (scale = 0 means every step, default = 2000)")
             ("smc-time-scale", po::value<unsigned int>(), "Specify the number of slices to use to print time cumulative stats (scale = 0 means every 1 unit, default = 2000)")
@@ -273,6 +292,105 @@ namespace VerifyTAPN {
             opts.setParallel(vm["smc-parallel"].as<bool>());
         }
 
+        if(vm.count("smc-threads")) {
+            opts.setParallel(true);
+            opts.setSmcThreads(vm["smc-threads"].as<unsigned int>());
+        }
+
+        if(vm.count("smc-batch")) {
+            opts.setSmcBatchSize(vm["smc-batch"].as<unsigned int>());
+        }
+
+        if(vm.count("smc-time-budget")) {
+            double budget = vm["smc-time-budget"].as<double>();
+            if(!(budget >= 0)) {
+                std::cout << "The SMC time budget must be a non-negative number of seconds." << std::endl;
+                std::exit(1);
+            }
+            opts.setSmcTimeBudget(budget);
+        }
+
+        if(vm.count("smc-processes")) {
+            opts.setSmcProcesses(vm["smc-processes"].as<unsigned int>());
+        }
+
+        if(vm.count("smc-worker-command")) {
+            opts.setSmcWorkerCommands(vm["smc-worker-command"].as<std::vector<std::string>>());
+        }
+
+        if(vm.count("smc-worker")) {
+            opts.setSmcWorker(vm["smc-worker"].as<bool>());
+        }
+
+        if(vm.count("smc-shard")) {
+            std::string shard = vm["smc-shard"].as<std::string>();
+            size_t slash = shard.find('/');
+            char* end = nullptr;
+            uint64_t index = strtoull(shard.c_str(), &end, 10);
+            uint64_t count = slash == std::string::npos ? 0 : strtoull(shard.c_str() + slash + 1, nullptr, 10);
+            if(slash == std::string::npos || end != shard.c_str() + slash || count == 0 || index >= count) {
+                std::cout << "The SMC shard must be given as K/N, with 0 <= K < N." << std::endl;
+                std::exit(1);
+            }
+            if(!vm.count("smc-seed") || !vm.count("smc-partial-output")) {
+                std::cout << "An SMC shard needs --smc-seed, the same for every shard, and --smc-partial-output." << std::endl;
+                std::exit(1);
+            }
+            opts.setSmcShard(index, count);
+            opts.setSmcPartialOutput(vm["smc-partial-output"].as<std::string>());
+        }
+
+        if(vm.count("smc-merge")) {
+            opts.setSmcMergeFiles(vm["smc-merge"].as<std::vector<std::string>>());
+        }
+
+        if(vm.count("smc-rng")) {
+            std::string engine = vm["smc-rng"].as<std::string>();
+            if(engine == "xoshiro256++") {
+                opts.setSmcRandomEngine(VerificationOptions::XOSHIRO256PP);
+            } else if(engine == "pcg64") {
+                opts.setSmcRandomEngine(VerificationOptions::PCG64);
+            } else {
+                std::cout << "The SMC random engine must be xoshiro256++ or pcg64." << std::endl;
+                std::exit(1);
+            }
+        }
+
+        if(vm.count("smc-seed")) {
+            opts.setSmcSeed(vm["smc-seed"].as<uint64_t>());
+        } else {
+            std::random_device rd;
+            opts.setSmcSeed(((uint64_t) rd() << 32) | rd());
+        }
+
+        if(vm.count("smc-sequential-estimation")) {
+            opts.setSequentialEstimation(vm["smc-sequential-estimation"].as<bool>());
+        }
+
+        if(vm.count("smc-common-runs")) {
+            opts.setSmcCommonRuns(vm["smc-common-runs"].as<bool>());
+        }
+
+        if(vm.count("smc-splitting")) {
+            opts.setSplittingEffort(vm["smc-splitting"].as<unsigned int>());
+        }
+
+        if(vm.count("smc-splitting-score")) {
+            opts.setSplittingScore(vm["smc-splitting-score"].as<std::string>());
+        }
+
+        if(vm.count("smc-importance-sampling")) {
+            opts.setImportanceSamplingRuns(vm["smc-importance-sampling"].as<unsigned int>());
+        }
+
+        if(vm.count("smc-progress")) {
+            opts.setProgressOutput(vm["smc-progress"].as<std::string>());
+        }
+
+        if(vm.count("smc-progress-interval")) {
+            opts.setProgressInterval(vm["smc-progress-interval"].as<unsigned int>());
+        }
+
         if(vm.count("smc-print-cumulative-stats")) {
             opts.setPrintCumulative(true);
             if(!vm["smc-print-cumulative-stats"].empty()) {
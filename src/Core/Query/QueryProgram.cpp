@@ -0,0 +1,145 @@
+#include "Core/Query/QueryProgram.hpp"
+
+#include <algorithm>
+
+namespace VerifyTAPN {
+namespace AST {
+
+    // Emits the postfix code of the expressions it visits, and tracks the depth of the stack
+    class QueryCompiler : public Visitor {
+    public:
+        explicit QueryCompiler(QueryProgram &program) : program(program) {};
+
+        ~QueryCompiler() override = default;
+
+        void visit(NotExpression &expr, Result &context) override {
+            expr.getChild().accept(*this, context);
+            emit(QueryProgram::NOT, 0);
+        }
+
+        void visit(OrExpression &expr, Result &context) override {
+            shortCircuit(QueryProgram::JUMP_IF_TRUE, expr.getLeft(), expr.getRight(), context);
+        }
+
+        void visit(AndExpression &expr, Result &context) override {
+            shortCircuit(QueryProgram::JUMP_IF_FALSE, expr.getLeft(), expr.getRight(), context);
+        }
+
+        void visit(AtomicProposition &expr, Result &context) override {
+            auto *leftPlace = dynamic_cast<IdentifierExpression *>(&expr.getLeft());
+            auto *rightPlace = dynamic_cast<IdentifierExpression *>(&expr.getRight());
+            auto *leftNumber = dynamic_cast<NumberExpression *>(&expr.getLeft());
+            auto *rightNumber = dynamic_cast<NumberExpression *>(&expr.getRight());
+            // A place compared to a constant, the most common proposition, is a single instruction
+            if (leftPlace != nullptr && rightNumber != nullptr) {
+                emit(tokensOperator(expr.getOperator(), false), 1, leftPlace->getPlace(), rightNumber->getValue());
+                return;
+            }
+            if (leftNumber != nullptr && rightPlace != nullptr) {
+                emit(tokensOperator(expr.getOperator(), true), 1, rightPlace->getPlace(), leftNumber->getValue());
+                return;
+            }
+            expr.getLeft().accept(*this, context);
+            expr.getRight().accept(*this, context);
+            switch (expr.getOperator()) {
+                case AtomicProposition::LT: emit(QueryProgram::LT, -1); break;
+                case AtomicProposition::LE: emit(QueryProgram::LE, -1); break;
+                case AtomicProposition::EQ: emit(QueryProgram::EQ, -1); break;
+                case AtomicProposition::NE: emit(QueryProgram::NE, -1); break;
+            }
+        }
+
+        void visit(BoolExpression &expr, Result &context) override {
+            emit(QueryProgram::PUSH, 1, expr.getValue() ? 1 : 0);
+        }
+
+        void visit(Query &query, Result &context) override {
+            query.getChild()->accept(*this, context);
+            program.negated = query.getQuantifier() == AG || query.getQuantifier() == AF || query.getQuantifier() == PG;
+        }
+
+        void visit(DeadlockExpression &expr, Result &context) override {
+            emit(QueryProgram::DEADLOCK, 1);
+        }
+
+        void visit(NumberExpression &expr, Result &context) override {
+            emit(QueryProgram::PUSH, 1, expr.getValue());
+        }
+
+        void visit(IdentifierExpression &expr, Result &context) override {
+            emit(QueryProgram::TOKENS, 1, expr.getPlace());
+        }
+
+        void visit(MultiplyExpression &expr, Result &context) override {
+            expr.getLeft().accept(*this, context);
+            expr.getRight().accept(*this, context);
+            emit(QueryProgram::MUL, -1);
+        }
+
+        void visit(MinusExpression &expr, Result &context) override {
+            expr.getValue().accept(*this, context);
+            emit(QueryProgram::NEG, 0);
+        }
+
+        void visit(SubtractExpression &expr, Result &context) override {
+            expr.getLeft().accept(*this, context);
+            expr.getRight().accept(*this, context);
+            emit(QueryProgram::SUB, -1);
+        }
+
+        void visit(PlusExpression &expr, Result &context) override {
+            expr.getLeft().accept(*this, context);
+            expr.getRight().accept(*this, context);
+            emit(QueryProgram::ADD, -1);
+        }
+
+    private:
+
+        void emit(QueryProgram::Opcode op, int effect, int32_t a = 0, int32_t b = 0) {
+            program.code.push_back({op, a, b});
+            depth += effect;
+            program.maxDepth = std::max(program.maxDepth, (size_t) depth);
+        }
+
+        // The left value stays on the stack when it decides, and is popped before the right one otherwise
+        void shortCircuit(QueryProgram::Opcode jump, Expression &left, Expression &right, Result &context) {
+            left.accept(*this, context);
+            size_t at = program.code.size();
+            emit(jump, -1);
+            right.accept(*this, context);
+            program.code[at].a = program.code.size();
+        }
+
+        static QueryProgram::Opcode tokensOperator(AtomicProposition::op_e op, bool swapped) {
+            switch (op) {
+                case AtomicProposition::LT: return swapped ? QueryProgram::TOKENS_GT : QueryProgram::TOKENS_LT;
+                case AtomicProposition::LE: return swapped ? QueryProgram::TOKENS_GE : QueryProgram::TOKENS_LE;
+                case AtomicProposition::EQ: return QueryProgram::TOKENS_EQ;
+                default: return QueryProgram::TOKENS_NE;
+            }
+        }
+
+        QueryProgram &program;
+        int depth = 0;
+    };
+
+    QueryProgram::QueryProgram(Query &query) {
+        QueryCompiler compiler(*this);
+        BoolResult context;
+        query.accept(compiler, context);
+    }
+
+    QueryProgram::QueryProgram(Expression &expr) {
+        QueryCompiler compiler(*this);
+        BoolResult context;
+        expr.accept(compiler, context);
+    }
+
+    QueryProgram::QueryProgram(ArithmeticExpression &expr) {
+        QueryCompiler compiler(*this);
+        IntResult context;
+        expr.accept(compiler, context);
+    }
+
+}
+}
@@ -1,16 +1,18 @@
 #include "Core/TAPN/WatchExpression.hpp"
-#include "DiscreteVerification/QueryVisitor.hpp"
 #include "DiscreteVerification/DataStructures/RealMarking.hpp"
 
 #include "DiscreteVerification/Util/ClockValue.hpp"
+#include "DiscreteVerification/Util/PartialResults.hpp"
 
+#include <algorithm>
 #include <numeric>
 
 using namespace VerifyTAPN::TAPN;
 using VerifyTAPN::DiscreteVerification::RealMarking;
-using VerifyTAPN::DiscreteVerification::QueryVisitor;
 
 using VerifyTAPN::DiscreteVerification::Util::clockToDouble;
+using VerifyTAPN::DiscreteVerification::Util::PartialWriter;
+using VerifyTAPN::DiscreteVerification::Util::PartialReader;
 
 using std::vector;
 
@@ -20,10 +22,7 @@ float Watch::new_marking(RealMarking *marking, const uint32_t precision)
         return _values.back();
     }
     float timestamp = clockToDouble(marking->getTotalAge(), precision);
-    QueryVisitor<RealMarking> checker(*marking, *_tapn);
-    IntResult res;
-    _expr->accept(checker, res);
-    double value = res.value;
+    double value = _program.value(*marking, *_tapn);
     if(_values.size() == 0 || value != _values.back()) {
         _values.push_back(value);
         _timestamps.push_back(timestamp);
@@ -44,6 +43,15 @@ void Watch::close()
     _steps.push_back(_max_step);
 }
 
+void Watch::take(WatchRun& run)
+{
+    close();
+    run.values.swap(_values);
+    run.timestamps.swap(_timestamps);
+    run.steps.swap(_steps);
+    reset();
+}
+
 void Watch::reset()
 {
     _values.clear();
@@ -67,203 +75,295 @@ std::string Watch::get_plots(const std::string& name) const
     return plots.str();
 }
 
-void WatchAggregator::new_watch(Watch* watch)
+void WatchRun::write(PartialWriter& out) const
+{
+    out.putDouble(values);
+    out.putDouble(timestamps);
+    out.putUnsigned(steps);
+}
+
+void WatchRun::read(PartialReader& in)
 {
-    watch_values.push_back(watch->_values);
-    watch_timestamps.push_back(watch->_timestamps);
-    watch_steps.push_back(watch->_steps);
+    in.getDouble(values);
+    in.getDouble(timestamps);
+    in.getUnsigned(steps);
+    if(timestamps.size() != values.size() || steps.size() != values.size()) {
+        in.fail();
+    }
+}
+
+void WatchBin::add(float value, double length)
+{
+    sum += value * length;
+    weight += length;
+    if(std::isnan(min) || value < min) {
+        min = value;
+    }
+    if(std::isnan(max) || value > max) {
+        max = value;
+    }
 }
 
-void WatchAggregator::aggregateSteps(unsigned int nBins)
+void WatchBin::merge(const WatchBin& other)
 {
-    unsigned int longest = 0;
-    for(const auto& steps : watch_steps) {
-        unsigned int max_step = steps.back();
-        if(max_step > longest) {
-            longest = max_step;
+    if(std::isnan(other.min)) {
+        return;
+    }
+    sum += other.sum;
+    weight += other.weight;
+    if(std::isnan(min) || other.min < min) {
+        min = other.min;
+    }
+    if(std::isnan(max) || other.max > max) {
+        max = other.max;
+    }
+}
+
+float WatchBin::avg() const
+{
+    return sum / weight;
+}
+
+void WatchBin::write(PartialWriter& out) const
+{
+    out.putDouble(sum);
+    out.putDouble(weight);
+    out.putDouble(min);
+    out.putDouble(max);
+}
+
+void WatchBin::read(PartialReader& in)
+{
+    sum = in.getDouble();
+    weight = in.getDouble();
+    min = (float) in.getDouble();
+    max = (float) in.getDouble();
+}
+
+void WatchAxis::init(unsigned int scale, bool integral)
+{
+    _scale = scale;
+    _integral = integral;
+    reset();
+}
+
+void WatchAxis::reset()
+{
+    _points.clear();
+    _bins.clear();
+    _longest = 0;
+    _delta = delta_for(0);
+}
+
+double WatchAxis::delta_for(double x) const
+{
+    if(x <= 0 || _scale == 0) {
+        return _integral ? 1 : 0;
+    }
+    int exponent;
+    double mantissa = std::frexp(x / _scale, &exponent);
+    double delta = std::ldexp(1.0, mantissa == 0.5 ? exponent - 1 : exponent);
+    return _integral ? std::max(delta, 1.0) : delta;
+}
+
+void WatchAxis::fit(double x)
+{
+    _longest = std::max(_longest, x);
+    double delta = delta_for(_longest);
+    if(_delta == 0) {
+        _delta = delta;
+    }
+    while(_delta < delta) {
+        widen();
+    }
+    size_t points = _delta > 0 ? (size_t) std::ceil(_longest / _delta) + 1 : 1;
+    if(_bins.size() < points) {
+        _bins.resize(points);
+    }
+}
+
+// The points 2j - 1 and 2j at delta make the point j at twice delta
+void WatchAxis::widen()
+{
+    size_t points = _bins.size();
+    for(size_t j = 1 ; 2 * j - 1 < points ; j++) {
+        WatchBin bin = _bins[2 * j - 1];
+        if(2 * j < points) {
+            bin.merge(_bins[2 * j]);
         }
+        _bins[j] = bin;
+    }
+    _bins.resize(std::min(points, points / 2 + 1));
+    _delta *= 2;
+}
+
+void WatchAxis::add_steps(float value, double from, double to)
+{
+    if(to < from) {
+        _bins[from > 0 ? (size_t) std::ceil(from / _delta) : 0].add(value, 0);
+        return;
+    }
+    if(from == 0) {
+        _bins[0].add(value, 1);
+        from = 1;
     }
-    if(nBins == 0 || nBins >= longest) {
-        nBins = longest;
+    for(size_t i = (size_t) std::ceil(from / _delta) ; from <= to ; i++) {
+        double end = std::min(to, i * _delta);
+        _bins[i].add(value, end - from + 1);
+        from = end + 1;
     }
-    float delta = longest / nBins;
-    step_avg = std::vector(nBins + 1, std::numeric_limits<float>::quiet_NaN());
-    step_min = std::vector(step_avg);
-    step_max = std::vector(step_avg);
-    std::vector<float> current_values(watch_steps.size());
-    for(int j = 0 ; j < watch_values.size() ; j++) {
-        current_values[j] = watch_values[j][0];
+}
+
+void WatchAxis::add_span(float value, double from, double to)
+{
+    if(to <= from) {
+        _bins[from > 0 ? (size_t) std::ceil(from / _delta) : 0].add(value, 0);
+        return;
     }
-    std::vector<size_t> current_indexs(watch_steps.size(), 0);
-    for(int i = 0 ; i <= nBins ; i++) {
-        float current_x = i * delta;
-        float avg = 0;
-        float min = std::numeric_limits<float>::quiet_NaN();
-        float max = std::numeric_limits<float>::quiet_NaN();
-        int n_runs = 0;
-        for(int j = 0 ; j < watch_steps.size() ; j++) {
-            size_t idx = current_indexs[j];
-            if(idx >= watch_steps[j].size()) {
-                continue;
-            }
-            if(idx < watch_steps[j].size() && watch_steps[j][idx] > current_x) {
-                float value = current_values[j];
-                avg += value;
-                n_runs++;
-                if(std::isnan(max) || value > max) {
-                    max = value;
-                }
-                if(std::isnan(min) || value < min) {
-                    min = value;
-                }
-            }
-            while(idx < watch_steps[j].size() && watch_steps[j][idx] <= current_x) {
-                float value = watch_values[j][idx];;
-                avg += value;
-                n_runs++;
-                if(std::isnan(max) || value > max) {
-                    max = value;
-                }
-                if(std::isnan(min) || value < min) {
-                    min = value;
-                }
-                current_values[j] = value;
-                idx++;
-            }
-            current_indexs[j] = idx;
+    size_t last = (size_t) std::ceil(to / _delta);
+    for(size_t i = (size_t) std::floor(from / _delta) + 1 ; i <= last ; i++) {
+        double length = std::min(to, i * _delta) - std::max(from, (i - 1) * _delta);
+        if(length > 0) {
+            _bins[i].add(value, length);
         }
-        step_avg[i] = avg / n_runs;
-        step_min[i] = min;
-        step_max[i] = max;
-        step_bins.push_back(i * delta);
-        global_steps_avg += step_avg[i];
     }
-    global_steps_avg /= (nBins + 1);
-    watch_steps.clear();
 }
 
-void WatchAggregator::infiniteTimeAggreg() 
+void WatchAxis::merge(const WatchAxis& other)
 {
-    std::vector<float> current_values(watch_values.size());
-    for(int j = 0 ; j < watch_values.size() ; j++) {
-        current_values[j] = watch_values[j][0];
+    for(const auto& [x, bin] : other._points) {
+        _points[x].merge(bin);
     }
-    std::vector<size_t> current_indexs(watch_timestamps.size(), 0);
-    float next_x = 0;
-    while(next_x != std::numeric_limits<float>::infinity()) {
-        float avg = 0;
-        float min = std::numeric_limits<float>::quiet_NaN();
-        float max = std::numeric_limits<float>::quiet_NaN();
-        int n_runs = 0;
-        next_x = std::numeric_limits<float>::infinity();
-        for(int j = 0 ; j < watch_timestamps.size() ; j++) {
-            size_t idx = current_indexs[j];
-            if(idx >= watch_timestamps[j].size()) {
-                continue;
-            }
-            if(watch_timestamps[j][idx] < next_x) {
-                next_x = watch_timestamps[j][idx];
-            }
+    if(other._bins.empty()) {
+        return;
+    }
+    fit(other._longest);
+    const WatchAxis* source = &other;
+    WatchAxis widened;
+    if(other._delta > 0 && other._delta < _delta) {
+        widened = other;
+        while(widened._delta < _delta) {
+            widened.widen();
         }
-        if(next_x == std::numeric_limits<float>::infinity()) {
-            break;
+        source = &widened;
+    }
+    for(size_t i = 0 ; i < source->_bins.size() ; i++) {
+        _bins[i].merge(source->_bins[i]);
+    }
+}
+
+void WatchAxis::write(PartialWriter& out) const
+{
+    out.putDouble(_delta);
+    out.putDouble(_longest);
+    size_t filled = std::count_if(_bins.begin(), _bins.end(), [](const WatchBin& bin) { return !std::isnan(bin.min); });
+    out.putUnsigned(filled);
+    for(size_t i = 0 ; i < _bins.size() ; i++) {
+        if(std::isnan(_bins[i].min)) continue;
+        out.putUnsigned(i);
+        _bins[i].write(out);
+    }
+    out.putUnsigned(_points.size());
+    for(const auto& [x, bin] : _points) {
+        out.putDouble(x);
+        bin.write(out);
+    }
+}
+
+void WatchAxis::read(PartialReader& in)
+{
+    reset();
+    double delta = in.getDouble();
+    double longest = in.getDouble();
+    // The delta follows from the longest run, which bounds the points
+    if(!in.good() || !(longest >= 0) || delta != delta_for(longest)) {
+        in.fail();
+        return;
+    }
+    _delta = delta;
+    _longest = longest;
+    size_t points = _delta > 0 ? (size_t) std::ceil(_longest / _delta) + 1 : 1;
+    size_t filled = in.getSize();
+    for(size_t k = 0 ; k < filled && in.good() ; k++) {
+        uint64_t i = in.getUnsigned();
+        if(i >= points) {
+            in.fail();
+            return;
         }
-        for(int j = 0 ; j < watch_timestamps.size() ; j++) {
-            size_t idx = current_indexs[j];
-            if(idx >= watch_timestamps[j].size()) {
-                continue;
-            }
-            while(idx < watch_timestamps[j].size() && watch_timestamps[j][idx] == next_x) {
-                float value = watch_values[j][idx];
-                avg += value;
-                if(std::isnan(min) || value < min) {
-                    min = value;
-                }
-                if(std::isnan(max) || value > max) {
-                    max = value;
-                }
-                n_runs++;
-                idx++;
-            }
-            current_indexs[j] = idx;
+        if(i >= _bins.size()) {
+            _bins.resize(i + 1);
         }
-        time_avg.push_back(avg / n_runs);
-        time_min.push_back(min);
-        time_max.push_back(max);
-        timestamps.push_back(next_x);
-        global_time_avg += time_avg.back();
+        _bins[i].read(in);
+    }
+    size_t exact = in.getSize();
+    for(size_t k = 0 ; k < exact && in.good() ; k++) {
+        float x = (float) in.getDouble();
+        _points[x].read(in);
     }
-    global_time_avg /= time_avg.size();
-    watch_timestamps.clear();
 }
 
-void WatchAggregator::aggregateTime(unsigned int nBins)
+void WatchAxis::get_points(vector<float>& xs, vector<float>& avg, vector<float>& min, vector<float>& max) const
 {
-    float longest = 0;
-    for(const auto& times : watch_timestamps) {
-        float max_time = times.back();
-        if(max_time > longest) {
-            longest = max_time;
+    if(_scale == 0 && !_integral) {
+        for(const auto& [x, bin] : _points) {
+            xs.push_back(x);
+            avg.push_back(bin.avg());
+            min.push_back(bin.min);
+            max.push_back(bin.max);
         }
-    }
-    if(nBins == 0) {
-        infiniteTimeAggreg();
         return;
     }
-    float delta = longest / (float) nBins;
-    time_avg = std::vector(nBins + 1, std::numeric_limits<float>::quiet_NaN());
-    time_min = std::vector(time_avg);
-    time_max = std::vector(time_avg);
-    std::vector<float> current_values(watch_timestamps.size());
-    for(int j = 0 ; j < current_values.size() ; j++) {
-        current_values[j] = watch_values[j][0];
+    // The last point ends with the longest run
+    for(size_t i = 0 ; i < _bins.size() ; i++) {
+        xs.push_back(std::min(i * _delta, _longest));
+        avg.push_back(_bins[i].avg());
+        min.push_back(_bins[i].min);
+        max.push_back(_bins[i].max);
     }
-    std::vector<size_t> current_indexs(watch_timestamps.size(), (size_t) 0);
-    for(int i = 0 ; i <= nBins ; i++) {
-        float current_x = i * delta;
-        float avg = 0;
-        float min = std::numeric_limits<float>::quiet_NaN();
-        float max = std::numeric_limits<float>::quiet_NaN();
-        int n_runs = 0;
-        for(int j = 0 ; j < watch_timestamps.size() ; j++) {
-            size_t idx = current_indexs[j];
-            if(idx >= watch_timestamps[j].size()) {
-                continue;
-            }
-            if(idx < watch_timestamps[j].size() && watch_timestamps[j][idx] > current_x) {
-                float value = current_values[j];
-                avg += value;
-                n_runs++;
-                if(std::isnan(max) || value > max) {
-                    max = value;
-                }
-                if(std::isnan(min) || value < min) {
-                    min = value;
-                }
-            }
-            while(idx < watch_timestamps[j].size() && watch_timestamps[j][idx] <= current_x) {
-                float value = watch_values[j][idx];;
-                avg += value;
-                n_runs++;
-                if(std::isnan(max) || value > max) {
-                    max = value;
-                }
-                if(std::isnan(min) || value < min) {
-                    min = value;
-                }
-                current_values[j] = value;
-                idx++;
-            }
-            current_indexs[j] = idx;
-        }
-        time_avg[i] = avg / n_runs;
-        time_min[i] = min;
-        time_max[i] = max;
-        timestamps.push_back(i * delta);
-        global_time_avg += time_avg[i];
+}
+
+void WatchAggregator::init(unsigned int stepBins, unsigned int timeBins)
+{
+    steps_axis.init(stepBins, true);
+    time_axis.init(timeBins, false);
+    resetAggregation();
+}
+
+void WatchAggregator::add_run(const WatchRun& run)
+{
+    steps_axis.add_run(run.steps, run.values);
+    time_axis.add_run(run.timestamps, run.values);
+}
+
+void WatchAggregator::merge(const WatchAggregator& other)
+{
+    steps_axis.merge(other.steps_axis);
+    time_axis.merge(other.time_axis);
+}
+
+void WatchAggregator::write(PartialWriter& out) const
+{
+    steps_axis.write(out);
+    time_axis.write(out);
+}
+
+void WatchAggregator::read(PartialReader& in)
+{
+    steps_axis.read(in);
+    time_axis.read(in);
+}
+
+// Points no run reached have no value, and are left out of the global averages
+static float globalAverage(const vector<float>& avg)
+{
+    float sum = 0;
+    size_t n = 0;
+    for(float value : avg) {
+        if(std::isnan(value)) continue;
+        sum += value;
+        n++;
     }
-    global_time_avg /= (float) (nBins + 1);
-    watch_timestamps.clear();
+    return sum / n;
 }
 
 void WatchAggregator::resetAggregation() 
@@ -282,19 +382,19 @@ void WatchAggregator::resetAggregation()
     global_time_avg = 0.0;
 }
 
-void WatchAggregator::aggregate(unsigned int stepBins, unsigned int timeBins)
+void WatchAggregator::aggregate()
 {
     resetAggregation();
-    aggregateSteps(stepBins);
-    aggregateTime(timeBins);
-    watch_values.clear();
+    steps_axis.get_points(step_bins, step_avg, step_min, step_max);
+    time_axis.get_points(timestamps, time_avg, time_min, time_max);
+    global_steps_avg = globalAverage(step_avg);
+    global_time_avg = globalAverage(time_avg);
 }
 
 void WatchAggregator::reset()
 {
-    watch_values.clear();
-    watch_timestamps.clear();
-    watch_steps.clear();
+    steps_axis.reset();
+    time_axis.reset();
     resetAggregation();
 }
 
@@ -1,16 +1,18 @@
 #include "DiscreteVerification/DataStructures/RealMarking.hpp"
 
+#include <algorithm>
+
 namespace VerifyTAPN::DiscreteVerification {
 
 void RealPlace::add(RealToken new_token)
 {
     size_t index = 0;
     for(auto& token : tokens) {
-        if(token.getAge() == new_token.getAge()) {
+        if(token.getBirth() == new_token.getBirth()) {
             token.add(new_token.getCount());
             return;
         }
-        if(token.getAge() > new_token.getAge()) break;
+        if(token.getBirth() < new_token.getBirth()) break;
         index++;
     }
     tokens.insert(tokens.begin() + index, new_token);
@@ -20,7 +22,7 @@ bool RealPlace::remove(RealToken to_remove)
 {
     size_t index = 0;
     for(auto it = tokens.begin() ; it != tokens.end() ; it++) {
-        if(it->getAge() == to_remove.getAge()) {
+        if(it->getBirth() == to_remove.getBirth()) {
             it->remove(to_remove.getCount());
             if(it->getCount() == 0) {
                 tokens.erase(it);
@@ -37,10 +39,16 @@ RealMarking::RealMarking(TAPN::TimedArcPetriNet* tapn, NonStrictMarkingBase& bas
 {
     size_t n_places = tapn->getNumberOfPlaces();
     auto placeList = base.getPlaceList();
+    // The clock starts at the oldest initial age, so that no birth date is negative
+    for(const auto& place : placeList) {
+        for(const auto& token : place.tokens) {
+            globalClock = std::max(globalClock, (clockValue) token.getAge());
+        }
+    }
     auto pit = placeList.begin();
     for(int i = 0 ; i < n_places ; i++) {
         if(pit != placeList.end() && pit->place->getIndex() == i) {
-            places.push_back(RealPlace(*pit));
+            places.push_back(RealPlace(*pit, globalClock));
             pit++;
         } else {
             places.push_back(RealPlace(&tapn->getPlace(i)));
@@ -53,7 +61,32 @@ RealMarking::RealMarking(const RealMarking& other)
     places = other.places;
     deadlocked = other.deadlocked;
     totalAge = other.totalAge;
+    globalClock = other.globalClock;
+    _thread_id = other._thread_id;
+    _run_stamp = other._run_stamp;
+    _firings = other._firings;
+}
+
+RealMarking& RealMarking::operator=(const RealMarking& other)
+{
+    if(this == &other) return *this;
+    if(places.size() == other.places.size()) {
+        for(size_t i = 0 ; i < places.size() ; i++) {
+            places[i].place = other.places[i].place;
+            places[i].tokens.assign(other.places[i].tokens.begin(), other.places[i].tokens.end());
+        }
+    } else {
+        places = other.places;
+    }
+    deadlocked = other.deadlocked;
+    totalAge = other.totalAge;
+    globalClock = other.globalClock;
     _thread_id = other._thread_id;
+    _run_stamp = other._run_stamp;
+    _firings = other._firings;
+    generatedBy = nullptr;
+    fromDelay = 0;
+    return *this;
 }
 
 uint32_t RealMarking::size() const
@@ -77,9 +110,7 @@ RealTokenList& RealMarking::getTokenList(int placeId)
 
 void RealMarking::deltaAge(clockValue x)
 {
-    for(auto& place : places) {
-        place.deltaAge(x);
-    }
+    globalClock += x;
     totalAge += x;
 }
 
@@ -106,7 +137,7 @@ bool RealMarking::canDeadlock(const TAPN::TimedArcPetriNet &tapn, int maxDelay,
 
 bool RealMarking::removeToken(int placeId, clockValue age)
 {
-    RealToken token(age, 1);
+    RealToken token(globalClock - age, 1);
     return removeToken(placeId, token);
 }
 
@@ -122,7 +153,7 @@ bool RealMarking::removeToken(RealPlace &place, RealToken &token)
 
 void RealMarking::addTokenInPlace(TAPN::TimedPlace &place, clockValue age)
 {
-    RealToken token(age, 1);
+    RealToken token(globalClock - age, 1);
     addTokenInPlace(place, token);
 }
 
@@ -141,7 +172,7 @@ clockValue RealMarking::availableDelay(const uint32_t precision) const
     clockValue available = std::numeric_limits<clockValue>::max();
     for(const auto& place : places) {
         if(place.isEmpty()) continue;
-        clockValue delay = place.availableDelay(precision);
+        clockValue delay = place.availableDelay(precision, globalClock);
         if(delay < available) {
             available = delay;
         }
@@ -157,7 +188,7 @@ void RealMarking::setDeadlocked(const bool dead)
 bool RealMarking::enables(TAPN::TimedTransition* transition, const uint32_t precision) {
     for(auto input : transition->getInhibitorArcs()) {
         uint32_t weight = input->getWeight();
-        RealTokenList tokens = getTokenList(input->getInputPlace().getIndex());
+        RealTokenList& tokens = getTokenList(input->getInputPlace().getIndex());
         for(auto& token : tokens) {
             if(token.getCount() > weight) {
                 weight = 0;
@@ -173,9 +204,9 @@ bool RealMarking::enables(TAPN::TimedTransition* transition, const uint32_t prec
         clockValue lower = toClock(interval.getLowerBound(), precision);
         clockValue upper = toClock(interval.getUpperBound(), precision);
         uint32_t weight = input->getWeight();
-        RealTokenList tokens = getTokenList(input->getInputPlace().getIndex());
+        RealTokenList& tokens = getTokenList(input->getInputPlace().getIndex());
         for(auto& token : tokens) {
-            clockValue age = token.getAge();
+            clockValue age = tokenAge(token);
             if(lower <= age && upper >= age) {
                 if(token.getCount() > weight) {
                     weight = 0;
@@ -195,9 +226,9 @@ bool RealMarking::enables(TAPN::TimedTransition* transition, const uint32_t prec
         clockValue lower = toClock(interval.getLowerBound(), precision);
         clockValue upper = toClock(interval.getUpperBound(), precision);
         uint32_t weight = input->getWeight();
-        RealTokenList tokens = getTokenList(input->getSource().getIndex());
+        RealTokenList& tokens = getTokenList(input->getSource().getIndex());
         for(auto& token : tokens) {
-            clockValue age = token.getAge();
+            clockValue age = tokenAge(token);
             if(lower <= age && upper >= age) {
                 if(token.getCount() > weight) {
                     weight = 0;
@@ -199,6 +199,9 @@ namespace VerifyTAPN { namespace DiscreteVerification {
             if(options.isBenchmarkMode()) {
                 ProbabilityEstimation estimator(tapn, marking, smcQuery, options, options.getBenchmarkRuns());
                 ComputeAndPrint(tapn, estimator, options, query);
+            } else if(options.getSplittingEffort() > 0) {
+                SplittingEstimation estimator(tapn, marking, smcQuery, options);
+                ComputeAndPrint(tapn, estimator, options, query);
             } else if(options.getSmcTraces() > 0) {
                 SMCTracesGenerator estimator(tapn, marking, smcQuery, options);
                 ComputeAndPrint(tapn, estimator, options, query);
@@ -334,6 +337,63 @@ namespace VerifyTAPN { namespace DiscreteVerification {
         return 0;
     }
 
+    int
+    DiscreteVerification::run(TAPN::TimedArcPetriNet &tapn, const std::vector<int>& initialPlacement,
+                              const std::vector<AST::Query *>& queries, VerificationOptions &options) {
+        bool allSMC = true;
+        for (auto* query : queries) {
+            allSMC &= query->getQuantifier() == PF || query->getQuantifier() == PG;
+        }
+        if (queries.size() > 1 && !allSMC) {
+            std::cout << "Several queries are only verified together for SMC, verifying the first one" << std::endl;
+        }
+        // Only the queries verified set up the net
+        size_t verified = allSMC ? queries.size() : 1;
+        for (size_t i = 0; i < verified; i++) {
+            if (queries[i]->getQuantifier() == CF || queries[i]->getQuantifier() == CG) {
+                options.setKeepDeadTokens(true);
+            }
+            tapn.updatePlaceTypes(queries[i], options);
+        }
+        if (verified == 1) {
+            return run(tapn, initialPlacement, queries.front(), options);
+        }
+        if (!tapn.isNonStrict()) {
+            std::cout << "The supplied net contains strict intervals." << std::endl;
+            return -1;
+        }
+        if (options.getSmcTraces() > 0) {
+            std::cout << "SMC traces are not supported when verifying several queries" << std::endl;
+            std::exit(1);
+        }
+        if (options.getSplittingEffort() > 0) {
+            std::cout << "SMC splitting is not supported when verifying several queries" << std::endl;
+            std::exit(1);
+        }
+
+        std::cout << "MC: " << tapn.getMaxConstant() << std::endl;
+        std::cout << "SMC Verification (all irrelevant options will be ignored)" << std::endl;
+        std::cout << "Model file is: " << options.getInputFile() << std::endl;
+        if (!options.getQueryFile().empty())
+            std::cout << "Query file is: " << options.getQueryFile() << std::endl;
+
+        // Queries are selected in increasing index order, see parse_queries
+        std::vector<AST::SMCQuery *> smcQueries;
+        std::vector<std::string> names;
+        auto index = options.getQueryNumbers().begin();
+        for (auto* query : queries) {
+            smcQueries.push_back((SMCQuery *) query);
+            names.push_back("Query index " + std::to_string(*index + 1));
+            ++index;
+        }
+
+        NonStrictMarking initialMarking(tapn, initialPlacement);
+        RealMarking marking(&tapn, initialMarking);
+        SMCMultiQuery verifier(tapn, marking, smcQueries, names, options);
+        ComputeAndPrint(tapn, verifier, options, queries.front());
+        return 0;
+    }
+
     template<typename T>
     void VerifyAndPrint(TAPN::TimedArcPetriNet &tapn, Verification<T> &verifier, VerificationOptions &options,
                         AST::Query *query) {
@@ -372,7 +432,18 @@ namespace VerifyTAPN { namespace DiscreteVerification {
 
         std::cout << "Starting SMC..." << std::endl;
 
-        if(options.isParallel()) {
+        if(!options.getSmcMergeFiles().empty()) {
+            estimator.mergePartialResults(options.getSmcMergeFiles());
+        } else if(options.isSmcWorker()) {
+            estimator.serveCoordinator();
+            return;
+        } else if(options.hasSmcShard()) {
+            // The results are those of the merge of the shards
+            estimator.runShard();
+            return;
+        } else if(options.isSmcDistributed()) {
+            estimator.coordinate();
+        } else if(options.isParallel()) {
             estimator.parallel_run();
         } else {
             estimator.run();
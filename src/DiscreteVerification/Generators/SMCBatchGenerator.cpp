@@ -0,0 +1,250 @@
+/*
+ * File:   SMCBatchGenerator.cpp
+ */
+
+#include "DiscreteVerification/Generators/SMCBatchGenerator.h"
+#include "DiscreteVerification/Generators/SMCRunGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace VerifyTAPN {
+    namespace DiscreteVerification {
+
+        using namespace Util;
+
+        static const clockValue NEVER = std::numeric_limits<clockValue>::max();
+
+        // SMCRunGenerator samples again the date of a transition whose last date was infinite
+        // whenever it revisits it, which a lane cannot reproduce
+        static bool finiteDates(const SMC::Distribution& distribution) {
+            const SMC::DistributionParameters& params = distribution.parameters;
+            switch(distribution.type) {
+                case SMC::Constant:
+                    return std::isfinite(params.constant.value);
+                case SMC::Uniform:
+                    return std::isfinite(params.uniform.b);
+                case SMC::Exponential:
+                    return params.exp.rate > 0;
+                case SMC::Custom:
+                    for(int i = 0 ; i < params.custom.len ; i++) {
+                        if(!std::isfinite(params.custom.values[i])) return false;
+                    }
+                    return true;
+                default:
+                    return true;
+            }
+        }
+
+        bool SMCBatchGenerator::supports(const TAPN::TimedArcPetriNet& tapn) {
+            for(auto* place : tapn.getPlaces()) {
+                if(place->getInvariant().getBound() != std::numeric_limits<int>::max()) return false;
+            }
+            for(auto* transi : tapn.getTransitions()) {
+                if(!transi->getTransportArcs().empty()) return false;
+                if(transi->getFiringMode() == SMC::Random && !transi->getPreset().empty()) return false;
+                if(!finiteDates(transi->getDistribution())) return false;
+                for(auto* arc : transi->getPreset()) {
+                    const TAPN::TimeInterval& interval = arc->getInterval();
+                    if(interval.getLowerBound() != 0 || interval.getUpperBound() != std::numeric_limits<int>::max()) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        SMCBatchGenerator::SMCBatchGenerator(TAPN::TimedArcPetriNet& tapn, const RealMarking& origin, uint64_t seed,
+                                             Util::RandomEngine::Kind engine, unsigned int numericPrecision, size_t lanes)
+        : _tapn(tapn)
+        , _lanes(lanes)
+        , _nPlaces(tapn.getNumberOfPlaces())
+        , _nTransitions(tapn.getTransitions().size())
+        , _seed(seed)
+        , _numericPrecision(numericPrecision)
+        , _preset(_nTransitions)
+        , _inhibitors(_nTransitions)
+        , _effects(_nTransitions)
+        , _originTokens(_nPlaces)
+        , _tokens(_nPlaces * lanes, 0)
+        , _peakTokens(_nPlaces * lanes, 0)
+        , _dates(_nTransitions * lanes, NEVER)
+        , _enabled(lanes, 0)
+        , _now(lanes, 0)
+        , _next(lanes, NEVER)
+        , _winner(lanes, NO_WINNER)
+        , _ties(lanes, 0)
+        , _steps(lanes, 0)
+        , _sampleIndex(lanes, 0)
+        , _active(lanes, 0)
+        , _maximal(lanes, 0)
+        , _runs(lanes, 0)
+        , _rngs(lanes, Util::RandomEngine(engine))
+        , _transitionsStatistics(_nTransitions, 0)
+        , _placesStatistics(_nPlaces, 0)
+        {
+            for(size_t p = 0 ; p < _nPlaces ; p++) {
+                _originTokens[p] = origin.numberOfTokensInPlace(p);
+            }
+            for(auto* transi : tapn.getTransitions()) {
+                size_t t = transi->getIndex();
+                std::vector<int32_t> delta(_nPlaces, 0);
+                // An input arc needs a token even when its weight is 0
+                for(auto* arc : transi->getPreset()) {
+                    uint32_t place = arc->getInputPlace().getIndex();
+                    _preset[t].push_back({ place, std::max<uint32_t>(arc->getWeight(), 1) });
+                    delta[place] -= arc->getWeight();
+                }
+                for(auto* arc : transi->getInhibitorArcs()) {
+                    _inhibitors[t].push_back({ (uint32_t) arc->getInputPlace().getIndex(), arc->getWeight() });
+                }
+                for(auto* arc : transi->getPostset()) {
+                    delta[arc->getOutputPlace().getIndex()] += arc->getWeight();
+                }
+                for(size_t p = 0 ; p < _nPlaces ; p++) {
+                    if(delta[p] != 0) _effects[t].push_back({ (uint32_t) p, delta[p] });
+                }
+                for(size_t lane = 0 ; lane < lanes ; lane++) {
+                    _samplers.emplace_back(transi->getDistribution());
+                }
+            }
+        }
+
+        void SMCBatchGenerator::start(size_t lane, uint64_t run) {
+            _runs[lane] = run;
+            _rngs[lane].seed(_seed, run);
+            _active[lane] = 1;
+            _maximal[lane] = 0;
+            _now[lane] = 0;
+            _steps[lane] = 0;
+            _sampleIndex[lane] = 0;
+            for(size_t p = 0 ; p < _nPlaces ; p++) {
+                _tokens[p * _lanes + lane] = _originTokens[p];
+                _peakTokens[p * _lanes + lane] = _originTokens[p];
+            }
+            for(size_t t = 0 ; t < _nTransitions ; t++) {
+                _dates[t * _lanes + lane] = NEVER;
+                _samplers[t * _lanes + lane].reset();
+            }
+        }
+
+        void SMCBatchGenerator::stop(size_t lane, bool done) {
+            _active[lane] = 0;
+            if(!done) return;
+            for(size_t p = 0 ; p < _nPlaces ; p++) {
+                _placesStatistics[p] += _peakTokens[p * _lanes + lane];
+            }
+        }
+
+        size_t SMCBatchGenerator::activeLanes() const {
+            size_t active = 0;
+            for(size_t lane = 0 ; lane < _lanes ; lane++) {
+                active += _active[lane];
+            }
+            return active;
+        }
+
+        // Transitions are visited in index order, so that a lane draws its samples in the same
+        // order as SMCRunGenerator does
+        void SMCBatchGenerator::schedule() {
+            const size_t n = _lanes;
+            const uint8_t* active = _active.data();
+            uint8_t* enabled = _enabled.data();
+            clockValue* next = _next.data();
+            std::fill(_next.begin(), _next.end(), NEVER);
+            for(size_t t = 0 ; t < _nTransitions ; t++) {
+                for(size_t lane = 0 ; lane < n ; lane++) {
+                    enabled[lane] = active[lane];
+                }
+                for(const Arc& arc : _preset[t]) {
+                    const uint32_t* tokens = &_tokens[arc.place * n];
+                    for(size_t lane = 0 ; lane < n ; lane++) {
+                        enabled[lane] &= tokens[lane] >= arc.weight;
+                    }
+                }
+                for(const Arc& arc : _inhibitors[t]) {
+                    const uint32_t* tokens = &_tokens[arc.place * n];
+                    for(size_t lane = 0 ; lane < n ; lane++) {
+                        enabled[lane] &= tokens[lane] < arc.weight;
+                    }
+                }
+                clockValue* dates = &_dates[t * n];
+                for(size_t lane = 0 ; lane < n ; lane++) {
+                    if(enabled[lane] && dates[lane] == NEVER) sample(t, lane);
+                }
+                for(size_t lane = 0 ; lane < n ; lane++) {
+                    dates[lane] = enabled[lane] ? dates[lane] : NEVER;
+                    next[lane] = std::min(next[lane], dates[lane]);
+                }
+            }
+            int32_t* winner = _winner.data();
+            uint32_t* ties = _ties.data();
+            std::fill(_winner.begin(), _winner.end(), NO_WINNER);
+            std::fill(_ties.begin(), _ties.end(), 0);
+            for(size_t t = 0 ; t < _nTransitions ; t++) {
+                const clockValue* dates = &_dates[t * n];
+                for(size_t lane = 0 ; lane < n ; lane++) {
+                    bool due = dates[lane] == next[lane] && next[lane] != NEVER;
+                    winner[lane] = (due && winner[lane] == NO_WINNER) ? (int32_t) t : winner[lane];
+                    ties[lane] += due;
+                }
+            }
+        }
+
+        void SMCBatchGenerator::sample(size_t transition, size_t lane) {
+            double sample = _samplers[transition * _lanes + lane](_rngs[lane], _sampleIndex[lane]);
+            clockValue date = toClock(sample, _numericPrecision);
+            _dates[transition * _lanes + lane] = date == NEVER ? date : _now[lane] + date;
+        }
+
+        // Same race between simultaneous transitions as SMCRunGenerator, on the stream of the lane
+        size_t SMCBatchGenerator::breakTie(size_t lane) {
+            _tied.clear();
+            for(size_t t = 0 ; t < _nTransitions ; t++) {
+                if(_dates[t * _lanes + lane] == _next[lane]) _tied.push_back(t);
+            }
+            return SMCRunGenerator::weightedChoice(_tapn, _tied, _rngs[lane], _infinite);
+        }
+
+        void SMCBatchGenerator::advance() {
+            const size_t n = _lanes;
+            int32_t* winner = _winner.data();
+            for(size_t lane = 0 ; lane < n ; lane++) {
+                if(!_active[lane]) {
+                    winner[lane] = NO_WINNER;
+                } else if(winner[lane] == NO_WINNER) {
+                    _maximal[lane] = 1;
+                } else {
+                    if(_ties[lane] > 1) winner[lane] = breakTie(lane);
+                    _now[lane] = _next[lane];
+                    _steps[lane]++;
+                }
+            }
+            for(size_t t = 0 ; t < _nTransitions ; t++) {
+                const int32_t transition = t;
+                uint32_t fired = 0;
+                for(size_t lane = 0 ; lane < n ; lane++) {
+                    fired += winner[lane] == transition;
+                }
+                if(fired == 0) continue;
+                _transitionsStatistics[t] += fired;
+                // The fired transition samples a new date if it stays enabled
+                clockValue* dates = &_dates[t * n];
+                for(size_t lane = 0 ; lane < n ; lane++) {
+                    dates[lane] = winner[lane] == transition ? NEVER : dates[lane];
+                }
+                for(const Effect& effect : _effects[t]) {
+                    uint32_t* tokens = &_tokens[effect.place * n];
+                    uint32_t* peak = &_peakTokens[effect.place * n];
+                    const uint32_t delta = effect.delta;
+                    for(size_t lane = 0 ; lane < n ; lane++) {
+                        uint32_t count = tokens[lane] + (winner[lane] == transition ? delta : 0u);
+                        tokens[lane] = count;
+                        peak[lane] = std::max(peak[lane], count);
+                    }
+                }
+            }
+        }
+
+    }
+}
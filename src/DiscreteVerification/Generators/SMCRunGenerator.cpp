@@ -8,9 +8,11 @@
 #include "DiscreteVerification/Generators/SMCRunGenerator.h"
 
 #include <numeric>
+#include <atomic>
 #include <deque>
 #include <random>
 #include <algorithm>
+#include <cmath>
 
 namespace VerifyTAPN {
     namespace DiscreteVerification {
@@ -18,119 +20,291 @@ namespace VerifyTAPN {
         using namespace Util;
 
         void SMCRunGenerator::prepare(RealMarking *parent) {
+            delete _origin;
             _origin = new RealMarking(*parent);
-            _parent = new RealMarking(*_origin);
-            RealPlaceList& places = _origin->getPlaceList();
-            std::vector<bool> transitionSeen(_defaultTransitionIntervals.size(), false);
-            clockValue originMaxDelay = _origin->availableDelay(_numericPrecision);
-            std::vector<interval<clockValue>> invInterval = { interval<clockValue>(0, originMaxDelay) };
+            resetParent();
+            _originMaxDelay = _origin->availableDelay(_numericPrecision);
             for(auto transi : _tapn.getTransitions()) {
-                if(transi->getPresetSize() == 0 && transi->getNumberOfInhibitorArcs() == 0) {
-                    _defaultTransitionIntervals[transi->getIndex()] = invInterval;
-                } else {
-                    std::vector<interval<clockValue>> firingDates = transitionFiringDates(transi);
-                    _defaultTransitionIntervals[transi->getIndex()] = Util::setIntersection(firingDates, invInterval);
-                }
+                transitionFiringDates(transi, _defaultTransitionIntervals[transi->getIndex()]);
             }
+            buildDependencyIndex();
+            buildSamplers();
             reset();
         }
 
-        void SMCRunGenerator::reset() {
-            if(_trace.size() > 0) {
-                for(RealMarking* marking : _trace) {
-                    if(marking != nullptr) delete marking;
+        void SMCRunGenerator::buildSamplers() {
+            _samplers.clear();
+            _samplers.reserve(_tapn.getTransitions().size());
+            for(auto transi : _tapn.getTransitions()) {
+                SMC::Distribution distribution = transi->getDistribution();
+                if(!_bias.rates.empty() && distribution.type == SMC::Exponential) {
+                    distribution.parameters.exp.rate *= _bias.rates[transi->getIndex()];
                 }
-                _trace.clear();
+                _samplers.emplace_back(distribution);
             }
-            else if(_parent != nullptr) delete _parent;
-            _parent = new RealMarking(*_origin);
-            if(recordTrace) {
-                _trace = { new RealMarking(*_origin), _parent };
+        }
+
+        void SMCRunGenerator::buildDependencyIndex() {
+            _placeDependents = std::vector<std::vector<size_t>>(_tapn.getNumberOfPlaces());
+            for(auto transi : _tapn.getTransitions()) {
+                std::vector<size_t> places;
+                for(auto* arc : transi->getPreset()) places.push_back(arc->getInputPlace().getIndex());
+                for(auto* arc : transi->getTransportArcs()) places.push_back(arc->getSource().getIndex());
+                for(auto* arc : transi->getInhibitorArcs()) places.push_back(arc->getInputPlace().getIndex());
+                std::sort(places.begin(), places.end());
+                places.erase(std::unique(places.begin(), places.end()), places.end());
+                for(auto place : places) {
+                    _placeDependents[place].push_back(transi->getIndex());
+                }
+            }
+            _dirtyTransitions = std::vector<bool>(_tapn.getTransitions().size(), false);
+        }
+
+        // Brings _parent back to the origin marking, reusing its storage
+        void SMCRunGenerator::resetParent() {
+            if(_parent == nullptr) {
+                _parent = new RealMarking(*_origin);
+            } else {
+                *_parent = *_origin;
             }
+        }
+
+        void SMCRunGenerator::reset() {
+            resetParent();
+            _trace.clear();
             _transitionIntervals = _defaultTransitionIntervals;
+            _invariantBound = _originMaxDelay;
             _maximal = false;
             _totalTime = 0;
             _totalSteps = 0;
             _sample_index = 0;
-            _dates_sampled = std::vector<clockValue>(_transitionIntervals.size(), std::numeric_limits<clockValue>::max());
-            bool deadlocked = true;
-            for(int i = 0 ; i < _dates_sampled.size() ; i++) {
-                auto* intervals = &_transitionIntervals[i];
-                if(!intervals->empty() && intervals->front().lower() == 0) {
-                    const Distribution& distrib = _tapn.getTransitions()[i]->getDistribution();
-                    _dates_sampled[i] = toClock(distrib.sample(_rng, _sample_index), _numericPrecision);
-                }
-                deadlocked &=   _transitionIntervals[i].empty() || 
-                                (
-                                    _transitionIntervals[i].size() == 1 &&
-                                    _transitionIntervals[i].front().upper() == 0 &&
-                                    _dates_sampled[i] > 0
-                                );
-            }
-            _parent->setDeadlocked(deadlocked);
+            _logLikelihood = 0;
+            stampParent();
+            for(auto& sampler : _samplers) {
+                sampler.reset();
+            }
+            size_t n_transitions = _transitionIntervals.size();
+            if(recordImportance) {
+                _importance.samples.assign(n_transitions, 0);
+                _importance.sampleSums.assign(n_transitions, 0);
+                _importance.chosen.assign(n_transitions, 0);
+                _importance.expected.assign(n_transitions, 0);
+            }
+            _dates_sampled.assign(n_transitions, std::numeric_limits<clockValue>::max());
+            _events.reset(n_transitions);
+            _enabledTransitions.clear();
+            _enabledPosition.assign(n_transitions, std::numeric_limits<size_t>::max());
+            _atUpperBound.clear();
+            for(size_t i = 0 ; i < n_transitions ; i++) {
+                if(updateSampledDate(i)) _atUpperBound.push_back(i);
+            }
+            _parent->setDeadlocked(nextEventDate() == std::numeric_limits<clockValue>::max());
             for(int i = 0 ; i < _currentPlacesStatistics.size() ; i++) {
                 _placesStatistics[i] += _currentPlacesStatistics[i];
                 _currentPlacesStatistics[i] = _origin->numberOfTokensInPlace(i);
             }
         }
 
-        SMCRunGenerator SMCRunGenerator::copy() const
+        void SMCRunGenerator::reset(uint64_t run, unsigned int part) {
+            _run = run;
+            _rng.seed(_seed + part * 0x9e3779b97f4a7c15ULL, run);
+            reset();
+        }
+
+        std::unique_ptr<SMCRunGenerator> SMCRunGenerator::copy() const
         {
-            SMCRunGenerator clone(_tapn, _numericPrecision);
-            clone._origin = new RealMarking(*_origin);
-            clone._numericPrecision = _numericPrecision;
-            clone._defaultTransitionIntervals = _defaultTransitionIntervals;
-            clone.recordTrace = recordTrace;
-            clone.reset();
+            auto clone = std::make_unique<SMCRunGenerator>(_tapn, _numericPrecision);
+            clone->_origin = new RealMarking(*_origin);
+            clone->_numericPrecision = _numericPrecision;
+            clone->_seed = _seed;
+            clone->_rng.select(_rng.kind());
+            clone->_defaultTransitionIntervals = _defaultTransitionIntervals;
+            clone->_originMaxDelay = _originMaxDelay;
+            clone->_placeDependents = _placeDependents;
+            clone->_bias = _bias;
+            clone->_dirtyTransitions = _dirtyTransitions;
+            clone->buildSamplers();
+            clone->recordTrace = recordTrace;
+            clone->reset();
             return clone;
         }
 
-        void SMCRunGenerator::refreshTransitionsIntervals()
+        void SMCRunGenerator::saveState(RunState& state) const {
+            if(state.marking == nullptr) {
+                state.marking = std::make_unique<RealMarking>(*_parent);
+            } else {
+                *state.marking = *_parent;
+            }
+            state.transitionIntervals = _transitionIntervals;
+            state.datesSampled = _dates_sampled;
+            state.events = _events;
+            state.atUpperBound = _atUpperBound;
+            state.enabledTransitions = _enabledTransitions;
+            state.enabledPosition = _enabledPosition;
+            state.invariantBound = _invariantBound;
+            state.lastDelay = _lastDelay;
+            state.totalTime = _totalTime;
+            state.totalSteps = _totalSteps;
+            state.sampleIndex = _sample_index;
+            state.maximal = _maximal;
+            state.logLikelihood = _logLikelihood;
+        }
+
+        // The sampled firing dates are part of the state, only the dates sampled from now on
+        // differ between the copies of a run
+        void SMCRunGenerator::restoreState(const RunState& state) {
+            *_parent = *state.marking;
+            _trace.clear();
+            _transitionIntervals = state.transitionIntervals;
+            _dates_sampled = state.datesSampled;
+            _events = state.events;
+            _atUpperBound = state.atUpperBound;
+            _enabledTransitions = state.enabledTransitions;
+            _enabledPosition = state.enabledPosition;
+            _invariantBound = state.invariantBound;
+            _lastDelay = state.lastDelay;
+            _totalTime = state.totalTime;
+            _totalSteps = state.totalSteps;
+            _sample_index = state.sampleIndex;
+            _maximal = state.maximal;
+            _logLikelihood = state.logLikelihood;
+            stampParent();
+            for(auto& sampler : _samplers) {
+                sampler.reset();
+            }
+            for(int i = 0 ; i < _currentPlacesStatistics.size() ; i++) {
+                _currentPlacesStatistics[i] = _parent->numberOfTokensInPlace(i);
+            }
+        }
+
+        // Every (re)start of a run gets a stamp no other run of any generator has
+        void SMCRunGenerator::stampParent() {
+            static std::atomic<uint64_t> runStamps { 1 };
+            _parent->_run_stamp = runStamps.fetch_add(1, std::memory_order_relaxed);
+            _parent->_firings = _totalSteps;
+            _parent->_thread_id = _thread_id;
+        }
+
+        // Only revisits the transitions whose state may have changed since the last step :
+        // those depending on a place touched by the firing, those whose event date is reached,
+        // and those that were (or now are) blocked at their upper bound
+        void SMCRunGenerator::updateTransitionsIntervals(TimedTransition* fired)
         {
             clockValue max_delay = _parent->availableDelay(_numericPrecision);
-            std::vector<interval<clockValue>> invInterval = { interval<clockValue>(0, max_delay) };
-            bool deadlocked = true;
-            for(auto transi : _tapn.getTransitions()) {
-                int i = transi->getIndex();
-                if(transi->getPresetSize() == 0 && transi->getNumberOfInhibitorArcs() == 0) {
-                    _transitionIntervals[i] = invInterval;
-                } else {
-                    std::vector<interval<clockValue>> firingDates = transitionFiringDates(transi);
-                    _transitionIntervals[i] = Util::setIntersection(firingDates, invInterval);
+            // An infinite invariant leaves a delay close to the maximum, the bound saturates
+            clockValue max = std::numeric_limits<clockValue>::max();
+            _invariantBound = max_delay >= max - _totalTime ? max : _totalTime + max_delay;
+            _touched.clear();
+            _touched.insert(_touched.end(), _atUpperBound.begin(), _atUpperBound.end());
+            if(fired != nullptr) {
+                _touched.push_back(fired->getIndex());
+                for(auto* arc : fired->getPreset()) markDependents(arc->getInputPlace());
+                for(auto* arc : fired->getPostset()) markDependents(arc->getOutputPlace());
+                for(auto* arc : fired->getTransportArcs()) {
+                    markDependents(arc->getSource());
+                    markDependents(arc->getDestination());
                 }
-                bool enabled = (!_transitionIntervals[i].empty()) && (_transitionIntervals[i].front().lower() == 0);
-                bool newlyEnabled = enabled && (_dates_sampled[i] == std::numeric_limits<clockValue>::max());
-                bool reachedUpper = enabled && !newlyEnabled && (_transitionIntervals[i].front().upper() == 0) && _dates_sampled[i] > 0;
-                if(!enabled || reachedUpper) {
-                    _dates_sampled[i] = std::numeric_limits<clockValue>::max();
-                } else if(newlyEnabled) {
-                    const Distribution& distrib = _tapn.getTransitions()[i]->getDistribution();
-                    clockValue date = toClock(distrib.sample(_rng, _sample_index), _numericPrecision);
-                    if(_transitionIntervals[i].front().upper() > 0 || date == 0) {
-                        _dates_sampled[i] = date;
-                    }
+            }
+            _events.collect(_totalTime, _touched);
+            if(_invariantBound == _totalTime) {
+                _touched.insert(_touched.end(), _enabledTransitions.begin(), _enabledTransitions.end());
+            }
+            // Index order keeps the sampling order, hence the runs, independent of the queue layout
+            std::sort(_touched.begin(), _touched.end());
+            _touched.erase(std::unique(_touched.begin(), _touched.end()), _touched.end());
+            _atUpperBound.clear();
+            for(auto i : _touched) {
+                if(_dirtyTransitions[i]) {
+                    computeTransitionIntervals(_tapn.getTransitions()[i]);
+                    _dirtyTransitions[i] = false;
                 }
-                deadlocked &=   _transitionIntervals[i].empty() || 
-                                (
-                                    _transitionIntervals[i].size() == 1 &&
-                                    _transitionIntervals[i].front().upper() == 0 &&
-                                    _dates_sampled[i] > 0
-                                );
-            }
-            _parent->setDeadlocked(deadlocked);
-        }
-
-        void SMCRunGenerator::disableTransitions(RealMarking* marking) {
-            for(int i = 0 ; i < _dates_sampled.size() ; i++) {
-                clockValue date = _dates_sampled[i];
-                if(date == std::numeric_limits<clockValue>::max()) continue;
-                TimedTransition* transition = _tapn.getTransitions()[i];
-                if(!marking->enables(transition, _numericPrecision)) {
-                    _dates_sampled[i] = std::numeric_limits<clockValue>::max();
+                if(updateSampledDate(i)) _atUpperBound.push_back(i);
+            }
+            _parent->setDeadlocked(nextEventDate() == std::numeric_limits<clockValue>::max());
+        }
+
+        void SMCRunGenerator::markDependents(const TimedPlace& place) {
+            for(auto i : _placeDependents[place.getIndex()]) {
+                if(!_dirtyTransitions[i]) {
+                    _dirtyTransitions[i] = true;
+                    _touched.push_back(i);
                 }
             }
         }
 
+        void SMCRunGenerator::computeTransitionIntervals(TimedTransition* transi) {
+            auto& intervals = _transitionIntervals[transi->getIndex()];
+            transitionFiringDates(transi, intervals);
+            for(auto& interv : intervals) {
+                interv.delta(_totalTime);
+            }
+        }
+
+        // Samples or discards the firing date of transition i according to its intervals (clipped
+        // by the invariant bound) and schedules its next event, returns whether i is enabled but
+        // cannot wait any longer
+        bool SMCRunGenerator::updateSampledDate(size_t i) {
+            const clockValue now = _totalTime;
+            auto& intervals = _transitionIntervals[i];
+            size_t passed = 0;
+            while(passed < intervals.size() && intervals[passed].upper() < now) passed++;
+            if(passed > 0) intervals.erase(intervals.begin(), intervals.begin() + passed);
+            bool enabled = (!intervals.empty()) && (intervals.front().lower() <= now);
+            bool atUpper = enabled && std::min(intervals.front().upper(), _invariantBound) == now;
+            bool newlyEnabled = enabled && (_dates_sampled[i] == std::numeric_limits<clockValue>::max());
+            bool reachedUpper = enabled && !newlyEnabled && atUpper && _dates_sampled[i] > now;
+            if(!enabled || reachedUpper) {
+                _dates_sampled[i] = std::numeric_limits<clockValue>::max();
+            } else if(newlyEnabled) {
+                double sample = _samplers[i](_rng, _sample_index);
+                if(!_bias.rates.empty()) weighSample(i, sample);
+                clockValue date = toClock(sample, _numericPrecision);
+                if(!atUpper || date == 0) {
+                    _dates_sampled[i] = date == std::numeric_limits<clockValue>::max() ? date : now + date;
+                }
+            }
+            setEnabled(i, enabled);
+            // Next bound of the raw intervals, the invariant bound is accounted for by nextEventDate
+            clockValue bound = std::numeric_limits<clockValue>::max();
+            for(auto& interv : intervals) {
+                if(interv.lower() > now) {
+                    bound = interv.lower();
+                    break;
+                }
+                if(interv.upper() > now) {
+                    bound = interv.upper();
+                    break;
+                }
+            }
+            _events.update(i, std::min(_dates_sampled[i], bound));
+            return atUpper;
+        }
+
+        void SMCRunGenerator::setEnabled(size_t i, bool enabled) {
+            size_t& position = _enabledPosition[i];
+            bool wasEnabled = position != std::numeric_limits<size_t>::max();
+            if(enabled == wasEnabled) return;
+            if(enabled) {
+                position = _enabledTransitions.size();
+                _enabledTransitions.push_back(i);
+            } else {
+                size_t last = _enabledTransitions.back();
+                _enabledTransitions[position] = last;
+                _enabledPosition[last] = position;
+                _enabledTransitions.pop_back();
+                position = std::numeric_limits<size_t>::max();
+            }
+        }
+
+        // Date of the next step : the earliest queued event within the invariant bound,
+        // or the bound itself if some enabled transition can wait until then
+        clockValue SMCRunGenerator::nextEventDate() const {
+            clockValue top = _events.top();
+            if(top <= _invariantBound) return top;
+            if(!_enabledTransitions.empty() && _invariantBound > _totalTime) return _invariantBound;
+            return std::numeric_limits<clockValue>::max();
+        }
+
         RealMarking* SMCRunGenerator::next() {
             auto [transi, delay] = getWinnerTransitionAndDelay();
             
@@ -139,9 +313,8 @@ namespace VerifyTAPN {
                 return nullptr;
             }
 
-            if(recordTrace && _parent->getGeneratedBy() != nullptr) {
-                _parent = new RealMarking(*_parent);
-                _trace.push_back(_parent);
+            if(recordTrace) {
+                _trace.steps.push_back({ delay, transi == nullptr ? -1 : (int32_t) transi->getIndex() });
             }
 
             // std::cout << "Marking ---------------" << std::endl;
@@ -149,7 +322,7 @@ namespace VerifyTAPN {
             //     if(place.numberOfTokens() == 0) continue;
             //     std::cout << "place " << place.placeId() << " ";
             //     for(auto& tok : place.tokens) {
-            //         std::cout << tok.getAge() << ", ";
+            //         std::cout << tok.getAge(_parent->getGlobalClock()) << ", ";
             //     }
             //     std::cout << std::endl;
             // }
@@ -166,67 +339,57 @@ namespace VerifyTAPN {
                 _dates_sampled[transi->getIndex()] = std::numeric_limits<clockValue>::max();
                 auto child = fire(transi);
                 child->setGeneratedBy(transi);
-                if(recordTrace) {
-                    _trace.push_back(child);
-                } else {
-                    delete _parent;
-                }
+                child->_firings = _totalSteps;
+                delete _spare;
+                _spare = _parent;
                 _parent = child;
+            } else {
+                // Time only passed, the marking no longer comes from the last firing
+                _parent->setGeneratedBy(nullptr);
             }
 
-            for(int i = 0 ; i < _transitionIntervals.size() ; i++) {
-                clockValue date = _dates_sampled[i];
-                _dates_sampled[i] = (date == std::numeric_limits<clockValue>::max()) ?
-                    std::numeric_limits<clockValue>::max() : date - delay;
-            }
-
-            refreshTransitionsIntervals();
+            updateTransitionsIntervals(transi);
 
             return _parent;
         }
 
         std::pair<TimedTransition*, clockValue> SMCRunGenerator::getWinnerTransitionAndDelay() {
-            std::vector<size_t> winner_indexs;
-            clockValue date_min = std::numeric_limits<clockValue>::max();
-            for(int i = 0 ; i < _transitionIntervals.size() ; i++) {
-                auto* intervals = &_transitionIntervals[i];
-                if(intervals->empty()) continue;
-                clockValue date = std::numeric_limits<clockValue>::max();
-                for(auto& interv : *intervals) {
-                    if(interv.lower() > 0) {
-                        date = interv.lower();
-                        break;
-                    }
-                    if(interv.upper() > 0) {
-                        date = interv.upper();
-                        break;
-                    }
-                }
-                date = std::min(_dates_sampled[i], date);
-                if(date < date_min) {
-                    date_min = date;
-                    winner_indexs.clear();
-                }
-                if(_dates_sampled[i] == date_min) {
-                    winner_indexs.push_back(i);
-                }
-            }
+            std::vector<size_t>& winner_indexs = _winners;
+            winner_indexs.clear();
+            clockValue date_min = nextEventDate();
+            if(date_min == std::numeric_limits<clockValue>::max()) {
+                return std::make_pair(nullptr, date_min);
+            }
+            // Events due at date_min are either firings or interval bounds, only the former compete
+            _events.collect(date_min, winner_indexs);
+            winner_indexs.erase(
+                std::remove_if(winner_indexs.begin(), winner_indexs.end(),
+                    [this, date_min](size_t i) { return _dates_sampled[i] != date_min; }),
+                winner_indexs.end()
+            );
+            std::sort(winner_indexs.begin(), winner_indexs.end());
             TimedTransition *winner;
             if(winner_indexs.empty()) { 
                 winner = nullptr;
             } else if(winner_indexs.size() == 1) {
                 winner = _tapn.getTransitions()[winner_indexs[0]];
+            } else if(!_bias.weights.empty()) {
+                winner = chooseBiasedWinner(winner_indexs);
             } else {
                 winner = chooseWeightedWinner(winner_indexs);
             }
-            return std::make_pair(winner, date_min);
+            return std::make_pair(winner, date_min - _totalTime);
         }
 
         TimedTransition* SMCRunGenerator::chooseWeightedWinner(const std::vector<size_t>& winner_indexs) {
+            return _tapn.getTransitions()[weightedChoice(_tapn, winner_indexs, _rng, _inftyWinners)];
+        }
+
+        size_t SMCRunGenerator::weightedChoice(const TimedArcPetriNet& tapn, const std::vector<size_t>& winner_indexs, RandomEngine& rng, std::vector<size_t>& infty_weights) {
             clockValue total_weight = 0;
-            std::vector<size_t> infty_weights;
+            infty_weights.clear();
             for(auto& candidate : winner_indexs) {
-                double priority = _tapn.getTransitions()[candidate]->getWeight();
+                double priority = tapn.getTransitions()[candidate]->getWeight();
                 if(priority == std::numeric_limits<double>::infinity()) {
                     infty_weights.push_back(candidate);
                 } else {
@@ -234,87 +397,148 @@ namespace VerifyTAPN {
                 }
             }
             if(!infty_weights.empty()) {
-                int winner_index = std::uniform_int_distribution<>(0, infty_weights.size() - 1)(_rng);
-                return _tapn.getTransitions()[infty_weights[winner_index]];
+                int winner_index = std::uniform_int_distribution<>(0, infty_weights.size() - 1)(rng);
+                return infty_weights[winner_index];
             }
             if(total_weight == 0) {
-                int winner_index = std::uniform_int_distribution<>(0, winner_indexs.size() - 1)(_rng);
-                return _tapn.getTransitions()[winner_indexs[winner_index]];
+                int winner_index = std::uniform_int_distribution<>(0, winner_indexs.size() - 1)(rng);
+                return winner_indexs[winner_index];
             }
-            double winning_weight = std::uniform_real_distribution<>(0.0, total_weight)(_rng);
+            double winning_weight = std::uniform_real_distribution<>(0.0, total_weight)(rng);
             for(auto& candidate : winner_indexs) {
-                TimedTransition* transi = _tapn.getTransitions()[candidate];
-                winning_weight -= transi->getWeight();
+                winning_weight -= tapn.getTransitions()[candidate]->getWeight();
                 if(winning_weight <= 0) {
-                    return transi;
+                    return candidate;
                 }
             }
-            return _tapn.getTransitions()[winner_indexs[0]];
+            return winner_indexs[0];
+        }
+
+        // A sample of a biased exponential distribution weighs the run by the ratio of the densities
+        void SMCRunGenerator::weighSample(size_t i, double sample) {
+            const SMC::Distribution& distribution = _tapn.getTransitions()[i]->getDistribution();
+            if(distribution.type != SMC::Exponential) return;
+            double rate = distribution.parameters.exp.rate;
+            double biased = rate * _bias.rates[i];
+            _logLikelihood += std::log(rate / biased) - (rate - biased) * sample;
+            if(recordImportance) {
+                _importance.samples[i] += 1;
+                _importance.sampleSums[i] += sample;
+            }
         }
 
-        std::vector<interval<clockValue>> SMCRunGenerator::transitionFiringDates(TimedTransition* transi) {
-            RealPlaceList &places = _parent->getPlaceList();
-            std::vector<interval<clockValue>> firingInterval = { interval<clockValue>(0, std::numeric_limits<clockValue>::max()) };
-            std::vector<interval<clockValue>> disabled;
+        // Same race as chooseWeightedWinner, with the weights scaled by the bias
+        TimedTransition* SMCRunGenerator::chooseBiasedWinner(const std::vector<size_t>& winner_indexs) {
+            double total_weight = 0;
+            double biased_weight = 0;
+            for(auto& candidate : winner_indexs) {
+                double weight = _tapn.getTransitions()[candidate]->getWeight();
+                total_weight += weight;
+                biased_weight += weight * _bias.weights[candidate];
+            }
+            if(!std::isfinite(total_weight) || total_weight == 0 || biased_weight == 0) {
+                return chooseWeightedWinner(winner_indexs);
+            }
+            double winning_weight = std::uniform_real_distribution<>(0.0, biased_weight)(_rng);
+            size_t winner = winner_indexs.back();
+            for(auto& candidate : winner_indexs) {
+                winning_weight -= _tapn.getTransitions()[candidate]->getWeight() * _bias.weights[candidate];
+                if(winning_weight <= 0) {
+                    winner = candidate;
+                    break;
+                }
+            }
+            double weight = _tapn.getTransitions()[winner]->getWeight();
+            _logLikelihood += std::log(weight / total_weight) - std::log(weight * _bias.weights[winner] / biased_weight);
+            if(recordImportance) {
+                _importance.chosen[winner] += 1;
+                for(auto& candidate : winner_indexs) {
+                    _importance.expected[candidate] += _tapn.getTransitions()[candidate]->getWeight() / total_weight;
+                }
+            }
+            return _tapn.getTransitions()[winner];
+        }
+
+        void SMCRunGenerator::transitionFiringDates(TimedTransition* transi, std::vector<interval<clockValue>>& firingInterval) {
+            firingInterval.assign(1, interval<clockValue>(0, std::numeric_limits<clockValue>::max()));
             for(InhibitorArc* inhib : transi->getInhibitorArcs()) {
                 if(_parent->numberOfTokensInPlace(inhib->getInputPlace().getIndex()) >= inhib->getWeight()) {
-                    return disabled;
+                    firingInterval.clear();
+                    return;
                 } 
             }
             for(TimedInputArc* arc : transi->getPreset()) {
                 auto &place = _parent->getPlaceList()[arc->getInputPlace().getIndex()];
-                if(place.isEmpty()) return disabled;
-                firingInterval = Util::setIntersection<clockValue>(firingInterval, arcFiringDates(arc->getInterval(), arc->getWeight(), place.tokens));
-                if(firingInterval.empty()) return firingInterval;
+                if(place.isEmpty()) {
+                    firingInterval.clear();
+                    return;
+                }
+                arcFiringDates(arc->getInterval(), arc->getWeight(), place.tokens, _parent->getGlobalClock(), _arcDates);
+                Util::setIntersection<clockValue>(firingInterval, _arcDates, _scratchDates);
+                firingInterval = _scratchDates;
+                if(firingInterval.empty()) return;
             }
             for(TransportArc* arc : transi->getTransportArcs()) {
                 auto &place = _parent->getPlaceList()[arc->getSource().getIndex()];
-                if(place.isEmpty()) return disabled;
+                if(place.isEmpty()) {
+                    firingInterval.clear();
+                    return;
+                }
                 TimeInvariant targetInvariant = arc->getDestination().getInvariant();
                 TimeInterval arcInterval = arc->getInterval();
                 if(targetInvariant.getBound() < arcInterval.getUpperBound()) {
                     arcInterval.setUpperBound(targetInvariant.getBound(), targetInvariant.isBoundStrict());
                 } 
-                firingInterval = Util::setIntersection<clockValue>(firingInterval, arcFiringDates(arcInterval, arc->getWeight(), place.tokens));
-                if(firingInterval.empty()) return firingInterval;
+                arcFiringDates(arcInterval, arc->getWeight(), place.tokens, _parent->getGlobalClock(), _arcDates);
+                Util::setIntersection<clockValue>(firingInterval, _arcDates, _scratchDates);
+                firingInterval = _scratchDates;
+                if(firingInterval.empty()) return;
             }
-            return firingInterval;
         }
 
-        std::vector<interval<clockValue>> SMCRunGenerator::arcFiringDates(TimeInterval time_interval, uint32_t weight, RealTokenList& tokens) {
+        void SMCRunGenerator::arcFiringDates(TimeInterval time_interval, uint32_t weight, RealTokenList& tokens, clockValue now, std::vector<interval<clockValue>>& firingDates) {
             // We assume tokens is SORTED !
             clockValue lower = toClock(time_interval.getLowerBound(), _numericPrecision);
             clockValue upper = toClock(time_interval.getUpperBound(), _numericPrecision);
             Util::interval<clockValue> arcInterval(lower, upper);
+            firingDates.clear();
             size_t total_tokens = 0;
             for(auto &t : tokens) {
                 total_tokens += t.getCount();
             }
-            if(total_tokens < weight) return std::vector<interval<clockValue>>();
-            std::vector<interval<clockValue>> firingDates;
-            std::deque<clockValue> selected;
+            if(total_tokens < weight) return;
+            if(weight == 0) {
+                firingDates.assign(1, interval<clockValue>(0, std::numeric_limits<clockValue>::max()));
+                return;
+            }
+            // Slides a window over weight consecutive tokens, since ages are sorted only
+            // the youngest (front) and oldest (back) tokens of the window constrain the dates
+            size_t front = 0;
+            int frontUsed = 0;
+            size_t selected = 0;
             for(auto& tokenPckt : tokens) {
                 for(int i = 0 ; i < tokenPckt.getCount() ; i++) {
-                    selected.push_back(tokenPckt.getAge());
-                    if(selected.size() > weight) {
-                        selected.pop_front();
-                    }
-                    if(selected.size() == weight) {
-                        interval<clockValue> tokenSetInterval = interval<clockValue>(0, std::numeric_limits<clockValue>::max());
-                        for(auto age : selected) {
-                            interval<clockValue> shifted = arcInterval;
-                            shifted.delta_neg(age);
-                            tokenSetInterval = Util::intersect(tokenSetInterval, shifted);
+                    selected++;
+                    if(selected > weight) {
+                        frontUsed++;
+                        if(frontUsed == tokens[front].getCount()) {
+                            front++;
+                            frontUsed = 0;
                         }
-                        Util::setAdd(firingDates, tokenSetInterval);
+                        selected--;
+                    }
+                    if(selected == weight) {
+                        interval<clockValue> youngest = arcInterval;
+                        youngest.delta_neg(tokens[front].getAge(now));
+                        interval<clockValue> oldest = arcInterval;
+                        oldest.delta_neg(tokenPckt.getAge(now));
+                        Util::setAdd(firingDates, Util::intersect(youngest, oldest));
                     }
                 }
             }
-            return firingDates;
         }
         
-        std::vector<RealToken> SMCRunGenerator::removeRandom(RealTokenList& tokenList, const TimeInterval& interval, const int weight) {
-            std::vector<RealToken> res;
+        void SMCRunGenerator::removeRandom(RealTokenList& tokenList, const TimeInterval& interval, const int weight, clockValue now, std::vector<RealToken>& consumed) {
             int remaining = weight;
             std::uniform_int_distribution<> randomTokenIndex(0, tokenList.size() - 1);
             size_t tok_index = randomTokenIndex(_rng);
@@ -323,9 +547,9 @@ namespace VerifyTAPN {
             clockValue upper = toClock(interval.getUpperBound(), _numericPrecision);
             while(remaining > 0 && tested < tokenList.size()) {
                 RealToken& token = tokenList[tok_index];
-                clockValue age = token.getAge();
+                clockValue age = token.getAge(now);
                 if(lower <= age && upper >= age) {
-                    res.push_back(RealToken(age, 1));
+                    consumed.push_back(RealToken(token.getBirth(), 1));
                     remaining--;
                     tokenList[tok_index].remove(1);
                     if(tokenList[tok_index].getCount() == 0) {
@@ -342,65 +566,60 @@ namespace VerifyTAPN {
                 }
             }
             assert(remaining == 0);
-            return res;
         }
 
-        std::vector<RealToken> SMCRunGenerator::removeYoungest(RealTokenList& tokenList, const TimeInterval& interval, const int weight) {
-            std::vector<RealToken> res;
+        void SMCRunGenerator::removeYoungest(RealTokenList& tokenList, const TimeInterval& interval, const int weight, clockValue now, std::vector<RealToken>& consumed) {
             int remaining = weight;
             auto iter = tokenList.begin();
             clockValue lower = toClock(interval.getLowerBound(), _numericPrecision);
             clockValue upper = toClock(interval.getUpperBound(), _numericPrecision);
             while(iter != tokenList.end()) {
-                clockValue age = iter->getAge();
+                clockValue age = iter->getAge(now);
                 if(lower > age || upper < age) {
                     iter++;
                     continue;
                 }
                 int count = iter->getCount();
                 if(count >= remaining) {
-                    res.push_back(RealToken(age, remaining));
+                    consumed.push_back(RealToken(iter->getBirth(), remaining));
                     iter->remove(remaining);
                     if(iter->getCount() == 0) tokenList.erase(iter);
                     remaining = 0;
                     break;
                 } else {
-                    res.push_back(RealToken(age, count));
+                    consumed.push_back(RealToken(iter->getBirth(), count));
                     remaining -= count;
                     iter = tokenList.erase(iter);
                 }
             }
             assert(remaining == 0);
-            return res;
         }
 
-        std::vector<RealToken> SMCRunGenerator::removeOldest(RealTokenList& tokenList, const TimeInterval& interval, const int weight) {
-            std::vector<RealToken> res;
+        void SMCRunGenerator::removeOldest(RealTokenList& tokenList, const TimeInterval& interval, const int weight, clockValue now, std::vector<RealToken>& consumed) {
             int remaining = weight;
             auto iter = tokenList.rbegin();
             clockValue lower = toClock(interval.getLowerBound(), _numericPrecision);
             clockValue upper = toClock(interval.getUpperBound(), _numericPrecision);
             while(iter != tokenList.rend()) {
-                clockValue age = iter->getAge();
+                clockValue age = iter->getAge(now);
                 if(lower > age || upper < age) {
                     iter++;
                     continue;
                 }
                 int count = iter->getCount();
                 if(count >= remaining) {
-                    res.push_back(RealToken(age, remaining));
+                    consumed.push_back(RealToken(iter->getBirth(), remaining));
                     iter->remove(remaining);
                     if(iter->getCount() == 0) tokenList.erase(std::next(iter).base());
                     remaining = 0;
                     break;
                 } else {
-                    res.push_back(RealToken(age, count));
+                    consumed.push_back(RealToken(iter->getBirth(), count));
                     remaining -= count;
                     iter = decltype(iter)(tokenList.erase(std::next(iter).base()));
                 }
             }
             assert(remaining == 0);
-            return res;
         }
 
         RealMarking* SMCRunGenerator::fire(TimedTransition* transi) {
@@ -408,72 +627,101 @@ namespace VerifyTAPN {
                 assert(false);
                 return nullptr;
             }
-            auto *child = new RealMarking(*_parent);
-            RealPlaceList &placelist = child->getPlaceList();
+            RealMarking* child;
+            if(_spare == nullptr) {
+                child = new RealMarking(*_parent);
+            } else {
+                child = _spare;
+                _spare = nullptr;
+                *child = *_parent;
+            }
+            applyFiring(transi, *child);
+            return child;
+        }
 
+        void SMCRunGenerator::applyFiring(TimedTransition* transi, RealMarking& child) {
+            RealPlaceList &placelist = child.getPlaceList();
+            clockValue now = child.getGlobalClock();
+
+            _consumed.clear();
             for (auto &input : transi->getPreset()) {
                 RealPlace& place = placelist[input->getInputPlace().getIndex()];
-                RealTokenList& tokenList = place.tokens;
-                switch(transi->getFiringMode()) {
-                    case SMC::Random:
-                        removeRandom(tokenList, input->getInterval(), input->getWeight());
-                        break;
-                    case SMC::Oldest:
-                        removeOldest(tokenList, input->getInterval(), input->getWeight());
-                        break;
-                    case SMC::Youngest:
-                        removeYoungest(tokenList, input->getInterval(), input->getWeight());
-                        break;
-                    default:
-                        removeOldest(tokenList, input->getInterval(), input->getWeight());
-                        break;
-                }
+                removeTokens(transi, place.tokens, input->getInterval(), input->getWeight(), now);
             }
 
-            std::vector<std::tuple<TimedPlace&, RealToken>> toCreate;
+            _toCreate.clear();
             for (auto &transport : transi->getTransportArcs()) {
                 int destInv = transport->getDestination().getInvariant().getBound();
                 RealPlace& place = placelist[transport->getSource().getIndex()];
-                RealTokenList& tokenList = place.tokens;
-                std::vector<RealToken> consumed;
                 TimeInterval interval = transport->getInterval();
                 if(destInv < interval.getUpperBound()) interval.setUpperBound(destInv, false);
-                switch(transi->getFiringMode()) {
-                    case SMC::Random:
-                        consumed = removeRandom(tokenList, interval, transport->getWeight());
-                        break;
-                    case SMC::Oldest:
-                        consumed = removeOldest(tokenList, interval, transport->getWeight());
-                        break;
-                    case SMC::Youngest:
-                        consumed = removeYoungest(tokenList, interval, transport->getWeight());
-                        break;
-                    default:
-                        consumed = removeOldest(tokenList, interval, transport->getWeight());
-                        break;
-                }
-                for(RealToken token : consumed) {
-                    toCreate.push_back({transport->getDestination(), token});
+                _consumed.clear();
+                removeTokens(transi, place.tokens, interval, transport->getWeight(), now);
+                for(RealToken token : _consumed) {
+                    _toCreate.push_back({&transport->getDestination(), token});
                 }
             }
 
+            // A replayed firing was already counted in the statistics when it was recorded
+            bool countTokens = _replaying == nullptr;
             for (auto* output : transi->getPostset()) {
                 TimedPlace &place = output->getOutputPlace();
-                RealToken token = RealToken(0, output->getWeight());
-                child->addTokenInPlace(place, token);
+                RealToken token = RealToken(now, output->getWeight());
+                child.addTokenInPlace(place, token);
                 int place_i = place.getIndex();
-                if(child->numberOfTokensInPlace(place_i) > _currentPlacesStatistics[place_i]) {
-                    _currentPlacesStatistics[place_i] = child->numberOfTokensInPlace(place_i);
+                if(countTokens && child.numberOfTokensInPlace(place_i) > _currentPlacesStatistics[place_i]) {
+                    _currentPlacesStatistics[place_i] = child.numberOfTokensInPlace(place_i);
                 }
             }
-            for (auto [dest, token] : toCreate) {
-                child->addTokenInPlace(dest, token);
-                int place_i = dest.getIndex();
-                if(child->numberOfTokensInPlace(place_i) > _currentPlacesStatistics[place_i]) {
-                    _currentPlacesStatistics[place_i] = child->numberOfTokensInPlace(place_i);
+            for (auto& [dest, token] : _toCreate) {
+                child.addTokenInPlace(*dest, token);
+                int place_i = dest->getIndex();
+                if(countTokens && child.numberOfTokensInPlace(place_i) > _currentPlacesStatistics[place_i]) {
+                    _currentPlacesStatistics[place_i] = child.numberOfTokensInPlace(place_i);
                 }
             }
-            return child;
+        }
+
+        // Appends the tokens taken from tokenList to _consumed, those chosen at random are
+        // logged in the trace, or taken from the trace when replaying it
+        void SMCRunGenerator::removeTokens(TimedTransition* transi, RealTokenList& tokenList, const TimeInterval& interval, const int weight, clockValue now) {
+            switch(transi->getFiringMode()) {
+                case SMC::Random:
+                    if(_replaying != nullptr) {
+                        removeChosen(tokenList, weight, _consumed);
+                    } else {
+                        size_t first = _consumed.size();
+                        removeRandom(tokenList, interval, weight, now, _consumed);
+                        if(recordTrace) {
+                            _trace.chosenTokens.insert(_trace.chosenTokens.end(), _consumed.begin() + first, _consumed.end());
+                        }
+                    }
+                    break;
+                case SMC::Oldest:
+                    removeOldest(tokenList, interval, weight, now, _consumed);
+                    break;
+                case SMC::Youngest:
+                    removeYoungest(tokenList, interval, weight, now, _consumed);
+                    break;
+                default:
+                    removeOldest(tokenList, interval, weight, now, _consumed);
+                    break;
+            }
+        }
+
+        void SMCRunGenerator::removeChosen(RealTokenList& tokenList, const int weight, std::vector<RealToken>& consumed) {
+            int remaining = weight;
+            while(remaining > 0) {
+                const RealToken& chosen = _replaying->chosenTokens[_replayToken++];
+                auto iter = std::find_if(tokenList.begin(), tokenList.end(), [&chosen](const RealToken& token) {
+                    return token.getBirth() == chosen.getBirth();
+                });
+                assert(iter != tokenList.end() && iter->getCount() >= chosen.getCount());
+                iter->remove(chosen.getCount());
+                if(iter->getCount() == 0) tokenList.erase(iter);
+                consumed.push_back(chosen);
+                remaining -= chosen.getCount();
+            }
         }
 
         bool SMCRunGenerator::reachedEnd() const {
@@ -517,12 +765,7 @@ namespace VerifyTAPN {
         }
 
         void SMCRunGenerator::mergeStatistics(const SMCRunGenerator& other) {
-            for(int i = 0 ; i < _transitionsStatistics.size() ; i++) {
-                _transitionsStatistics[i] += other._transitionsStatistics[i];
-            }
-            for(int i = 0 ; i < _placesStatistics.size() ; i++) {
-                _placesStatistics[i] += other._placesStatistics[i];
-            }
+            mergeStatistics(other._transitionsStatistics, other._placesStatistics);
             // for(int i = 0 ; i < _placesStatistics.size() ; i++) {
             //     if(_placesStatistics[i] < other._placesStatistics[i]) {
             //         _placesStatistics[i] = other._placesStatistics[i];
@@ -530,20 +773,50 @@ namespace VerifyTAPN {
             // }   
         }
 
-        std::stack<RealMarking*> SMCRunGenerator::getTrace() const {
-            std::stack<RealMarking*> trace;
-            for(int i = 0 ; i < _trace.size() ; i++) {
-                RealMarking* marking = _trace[_trace.size() - 1 - i];
-                if(marking == nullptr) trace.push(nullptr);
-                else {
-                    RealMarking* toSave = new RealMarking(*marking);
-                    toSave->setGeneratedBy(marking->getGeneratedBy());
-                    toSave->setPreviousDelay(marking->getPreviousDelay());
-                    toSave->setDeadlocked(marking->canDeadlock(_tapn, 0));
-                    trace.push(toSave);
+        void SMCRunGenerator::mergeStatistics(const std::vector<uint32_t>& transitions, const std::vector<uint32_t>& places) {
+            for(int i = 0 ; i < _transitionsStatistics.size() ; i++) {
+                _transitionsStatistics[i] += transitions[i];
+            }
+            for(int i = 0 ; i < _placesStatistics.size() ; i++) {
+                _placesStatistics[i] += places[i];
+            }
+        }
+
+        void SMCRunGenerator::resetStatistics() {
+            std::fill(_transitionsStatistics.begin(), _transitionsStatistics.end(), 0);
+            std::fill(_placesStatistics.begin(), _placesStatistics.end(), 0);
+        }
+
+        // Takes the same steps as next() did when recording, the trace starts with the origin,
+        // then the markings reached by each delay and by each firing
+        std::stack<RealMarking*> SMCRunGenerator::replay(const SMCTrace& trace) {
+            std::vector<RealMarking*> markings = { new RealMarking(*_origin), new RealMarking(*_origin) };
+            RealMarking* current = markings.back();
+            _replaying = &trace;
+            _replayToken = 0;
+            for(const auto& step : trace.steps) {
+                if(current->getGeneratedBy() != nullptr) {
+                    current = new RealMarking(*current);
+                    markings.push_back(current);
+                }
+                current->deltaAge(step.delay);
+                current->setPreviousDelay(step.delay + current->getPreviousDelay());
+                if(step.transition >= 0) {
+                    TimedTransition* transi = _tapn.getTransitions()[step.transition];
+                    RealMarking* child = new RealMarking(*current);
+                    applyFiring(transi, *child);
+                    child->setGeneratedBy(transi);
+                    markings.push_back(child);
+                    current = child;
                 }
             }
-            return trace;
+            _replaying = nullptr;
+            std::stack<RealMarking*> stack;
+            for(auto it = markings.rbegin() ; it != markings.rend() ; it++) {
+                (*it)->setDeadlocked((*it)->canDeadlock(_tapn, 0));
+                stack.push(*it);
+            }
+            return stack;
         }
 
     }
@@ -0,0 +1,131 @@
+#include "DiscreteVerification/IncrementalQuery.hpp"
+#include "DiscreteVerification/DataStructures/RealMarking.hpp"
+
+#include <algorithm>
+
+namespace VerifyTAPN { namespace DiscreteVerification {
+
+    using AST::QueryProgram;
+
+    IncrementalQuery::IncrementalQuery(AST::Query &query, const TAPN::TimedArcPetriNet &tapn) : tapn(tapn) {
+        build(*query.getChild(), NO_PARENT);
+        negated = query.getQuantifier() == AST::AG || query.getQuantifier() == AST::AF || query.getQuantifier() == AST::PG;
+
+        placePropositions.resize(tapn.getNumberOfPlaces());
+        for (uint32_t i = 0; i < programs.size(); i++) {
+            bool timed = false;
+            for (const auto &ins : programs[i].getCode()) {
+                switch (ins.op) {
+                    case QueryProgram::TOKENS:
+                    case QueryProgram::TOKENS_LT:
+                    case QueryProgram::TOKENS_LE:
+                    case QueryProgram::TOKENS_GT:
+                    case QueryProgram::TOKENS_GE:
+                    case QueryProgram::TOKENS_EQ:
+                    case QueryProgram::TOKENS_NE: {
+                        auto &dependents = placePropositions[ins.a];
+                        if (dependents.empty() || dependents.back() != i) dependents.push_back(i);
+                        break;
+                    }
+                    case QueryProgram::DEADLOCK:
+                        timed = true;
+                        break;
+                    default:
+                        break;
+                }
+            }
+            if (timed) timedPropositions.push_back(i);
+        }
+
+        transitionPropositions.resize(tapn.getTransitions().size());
+        for (const auto *transition : tapn.getTransitions()) {
+            auto &changed = transitionPropositions[transition->getIndex()];
+            auto touch = [&](const TAPN::TimedPlace &place) {
+                const auto &dependents = placePropositions[place.getIndex()];
+                changed.insert(changed.end(), dependents.begin(), dependents.end());
+            };
+            for (const auto *arc : transition->getPreset()) touch(arc->getInputPlace());
+            for (const auto *arc : transition->getPostset()) touch(arc->getOutputPlace());
+            for (const auto *arc : transition->getTransportArcs()) {
+                if (&arc->getSource() == &arc->getDestination()) continue;
+                touch(arc->getSource());
+                touch(arc->getDestination());
+            }
+            std::sort(changed.begin(), changed.end());
+            changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+        }
+    }
+
+    // Nested and / or of the same kind are flattened into a single node
+    uint32_t IncrementalQuery::build(AST::Expression &expr, uint32_t parent) {
+        auto node = (uint32_t) nodes.size();
+        if (auto *conjunction = dynamic_cast<AST::AndExpression *>(&expr)) {
+            nodes.push_back({AND, parent});
+            addChildren(AND, conjunction->getLeft(), node);
+            addChildren(AND, conjunction->getRight(), node);
+        } else if (auto *disjunction = dynamic_cast<AST::OrExpression *>(&expr)) {
+            nodes.push_back({OR, parent});
+            addChildren(OR, disjunction->getLeft(), node);
+            addChildren(OR, disjunction->getRight(), node);
+        } else if (auto *negation = dynamic_cast<AST::NotExpression *>(&expr)) {
+            nodes.push_back({NOT, parent, 1});
+            build(negation->getChild(), node);
+        } else {
+            nodes.push_back({PROPOSITION, parent});
+            propositions.push_back(node);
+            programs.emplace_back(expr);
+        }
+        return node;
+    }
+
+    void IncrementalQuery::addChildren(NodeKind kind, AST::Expression &expr, uint32_t node) {
+        if (kind == AND && dynamic_cast<AST::AndExpression *>(&expr) != nullptr) {
+            auto &conjunction = static_cast<AST::AndExpression &>(expr);
+            addChildren(kind, conjunction.getLeft(), node);
+            addChildren(kind, conjunction.getRight(), node);
+        } else if (kind == OR && dynamic_cast<AST::OrExpression *>(&expr) != nullptr) {
+            auto &disjunction = static_cast<AST::OrExpression &>(expr);
+            addChildren(kind, disjunction.getLeft(), node);
+            addChildren(kind, disjunction.getRight(), node);
+        } else {
+            build(expr, node);
+            nodes[node].children++;
+        }
+    }
+
+    // Goes up as long as the value of the parent flips
+    void IncrementalQuery::propagate(State &state, uint32_t node) const {
+        while (nodes[node].parent != NO_PARENT) {
+            uint32_t parent = nodes[node].parent;
+            if (state.values[node]) {
+                state.trueChildren[parent]++;
+            } else {
+                state.trueChildren[parent]--;
+            }
+            uint8_t value = nodeValue(state, parent);
+            if (value == state.values[parent]) return;
+            state.values[parent] = value;
+            node = parent;
+        }
+    }
+
+    // The run generator stamps its markings with the run and the number of transitions fired,
+    // a marking then follows the last one evaluated when it is in the same run and at most one
+    // transition, the one that generated it, was fired in between
+    bool IncrementalQuery::holds(State &state, const RealMarking &marking) const {
+        const TAPN::TimedTransition *fired = marking.getGeneratedBy();
+        bool follows = marking._run_stamp != 0 && marking._run_stamp == state.run && !state.values.empty();
+        if (follows && marking._firings == state.firings) {
+            update(state, marking, timedPropositions);
+        } else if (follows && fired != nullptr && marking._firings == state.firings + 1) {
+            update(state, marking, transitionPropositions[fired->getIndex()]);
+            update(state, marking, timedPropositions);
+        } else {
+            evaluate(state, marking);
+        }
+        state.run = marking._run_stamp;
+        state.firings = marking._firings;
+        return result(state);
+    }
+
+} }
@@ -0,0 +1,35 @@
+#include "DiscreteVerification/Util/AllocationCounter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+// Per thread counter, so that counting does not make the workers share a cache line
+static thread_local uint64_t allocations = 0;
+
+void* operator new(std::size_t size) {
+    allocations++;
+    if(size == 0) size = 1;
+    while(true) {
+        void* ptr = std::malloc(size);
+        if(ptr != nullptr) return ptr;
+        std::new_handler handler = std::get_new_handler();
+        if(handler == nullptr) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    uint64_t threadAllocations() {
+        return allocations;
+    }
+
+}
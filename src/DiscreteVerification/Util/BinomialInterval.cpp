@@ -0,0 +1,89 @@
+#include "DiscreteVerification/Util/BinomialInterval.hpp"
+
+#include <cmath>
+#include <limits>
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    // Continued fraction of the incomplete beta function (modified Lentz's method)
+    static double betaContinuedFraction(double a, double b, double x) {
+        const double tiny = std::numeric_limits<double>::min() / std::numeric_limits<double>::epsilon();
+        const double eps = std::numeric_limits<double>::epsilon();
+        double c = 1.0;
+        double d = 1.0 - (a + b) * x / (a + 1.0);
+        if(std::fabs(d) < tiny) d = tiny;
+        d = 1.0 / d;
+        double h = d;
+        for(int m = 1 ; m <= 10000 ; m++) {
+            double m2 = 2.0 * m;
+            double aa = m * (b - m) * x / ((a + m2 - 1.0) * (a + m2));
+            d = 1.0 + aa * d;
+            if(std::fabs(d) < tiny) d = tiny;
+            c = 1.0 + aa / c;
+            if(std::fabs(c) < tiny) c = tiny;
+            d = 1.0 / d;
+            h *= d * c;
+            aa = -(a + m) * (a + b + m) * x / ((a + m2) * (a + m2 + 1.0));
+            d = 1.0 + aa * d;
+            if(std::fabs(d) < tiny) d = tiny;
+            c = 1.0 + aa / c;
+            if(std::fabs(c) < tiny) c = tiny;
+            d = 1.0 / d;
+            double delta = d * c;
+            h *= delta;
+            if(std::fabs(delta - 1.0) < eps) break;
+        }
+        return h;
+    }
+
+    double regularizedBeta(double a, double b, double x) {
+        if(x <= 0) return 0;
+        if(x >= 1) return 1;
+        double logFront = std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b)
+                        + a * std::log(x) + b * std::log1p(-x);
+        double front = std::exp(logFront);
+        // The continued fraction converges quickly on this side only, use the symmetry otherwise
+        if(x < (a + 1.0) / (a + b + 2.0)) {
+            return front * betaContinuedFraction(a, b, x) / a;
+        }
+        return 1.0 - front * betaContinuedFraction(b, a, 1.0 - x) / b;
+    }
+
+    // Smallest x such that I_x(a, b) >= q, by bisection
+    static double betaQuantile(double a, double b, double q) {
+        double low = 0;
+        double high = 1;
+        for(int i = 0 ; i < 64 ; i++) {
+            double mid = (low + high) / 2;
+            if(regularizedBeta(a, b, mid) < q) {
+                low = mid;
+            } else {
+                high = mid;
+            }
+        }
+        return high;
+    }
+
+    double normalQuantile(double q) {
+        double low = -40;
+        double high = 40;
+        for(int i = 0 ; i < 64 ; i++) {
+            double mid = (low + high) / 2;
+            if(0.5 * std::erfc(-mid / std::sqrt(2.0)) < q) {
+                low = mid;
+            } else {
+                high = mid;
+            }
+        }
+        return high;
+    }
+
+    std::pair<double, double> clopperPearson(uint64_t successes, uint64_t n, double alpha) {
+        if(n == 0) return std::make_pair(0.0, 1.0);
+        double x = successes;
+        double lower = successes == 0 ? 0.0 : betaQuantile(x, n - x + 1, alpha / 2);
+        double upper = successes == n ? 1.0 : betaQuantile(x + 1, n - x, 1 - alpha / 2);
+        return std::make_pair(lower, upper);
+    }
+
+}
@@ -0,0 +1,151 @@
+#include "DiscreteVerification/Util/DistributionSampler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    using namespace SMC;
+
+    DistributionSampler::DistributionSampler(const Distribution& distribution)
+    : _distribution(distribution) {
+        switch(distribution.type) {
+            case Uniform:
+            case Exponential:
+            case Normal:
+            case LogNormal:
+            case Triangular:
+                _batched = true;
+                _buffer.resize(SMC_SAMPLER_BATCH);
+                break;
+            default:
+                _batched = false;
+                break;
+        }
+        switch(distribution.type) {
+            case Gamma:
+            case Erlang:
+                _gamma = std::gamma_distribution<double>(distribution.parameters.gamma.shape, distribution.parameters.gamma.scale);
+                break;
+            case DiscreteUniform:
+                _discreteUniform = std::uniform_int_distribution<int>(distribution.parameters.discreteUniform.a, distribution.parameters.discreteUniform.b);
+                break;
+            case Geometric:
+                _geometric = std::geometric_distribution<int>(distribution.parameters.geometric.p);
+                break;
+            default:
+                break;
+        }
+    }
+
+    void DistributionSampler::reset() {
+        _next = 0;
+        _filled = 0;
+        _batch = 1;
+        _gamma.reset();
+        _discreteUniform.reset();
+        _geometric.reset();
+    }
+
+    double DistributionSampler::draw(RandomEngine& engine, int& index) {
+        if(_batched) {
+            refill(engine);
+            return _buffer[_next++];
+        }
+        double date = 0;
+        switch(_distribution.type) {
+            case Constant:
+                date = _distribution.parameters.constant.value;
+                break;
+            case Gamma:
+            case Erlang:
+                date = _gamma(engine);
+                break;
+            case DiscreteUniform:
+                date = _discreteUniform(engine);
+                break;
+            case Geometric:
+                date = _geometric(engine);
+                break;
+            case Custom:
+                date = _distribution.parameters.custom.values[index];
+                index = (index + 1) % _distribution.parameters.custom.len;
+                break;
+            default:
+                break;
+        }
+        return std::max(date, 0.0);
+    }
+
+    void DistributionSampler::refill(RandomEngine& engine) {
+        size_t n = _batch;
+        _batch = std::min<size_t>(2 * _batch, SMC_SAMPLER_BATCH);
+        double* out = _buffer.data();
+        for(size_t i = 0 ; i < n ; i++) {
+            out[i] = uniform(engine);
+        }
+        const DistributionParameters& params = _distribution.parameters;
+        switch(_distribution.type) {
+            case Uniform: {
+                    const double a = params.uniform.a;
+                    const double width = params.uniform.b - params.uniform.a;
+                    for(size_t i = 0 ; i < n ; i++) {
+                        out[i] = a + width * out[i];
+                    }
+                }
+                break;
+            case Exponential: {
+                    const double scale = -1.0 / params.exp.rate;
+                    for(size_t i = 0 ; i < n ; i++) {
+                        out[i] = scale * std::log1p(-out[i]);
+                    }
+                }
+                break;
+            case Normal:
+            case LogNormal: {
+                    // Box-Muller, both values of a pair are kept
+                    const bool log = _distribution.type == LogNormal;
+                    const double mean = log ? params.logNormal.logMean : params.normal.mean;
+                    const double stddev = log ? params.logNormal.logStddev : params.normal.stddev;
+                    if(n % 2 == 1) {
+                        out[n] = uniform(engine);
+                        n++;
+                    }
+                    for(size_t i = 0 ; i < n ; i += 2) {
+                        const double radius = std::sqrt(-2.0 * std::log1p(-out[i]));
+                        const double angle = 6.283185307179586 * out[i + 1];
+                        out[i] = mean + stddev * radius * std::cos(angle);
+                        out[i + 1] = mean + stddev * radius * std::sin(angle);
+                    }
+                    if(log) {
+                        for(size_t i = 0 ; i < n ; i++) {
+                            out[i] = std::exp(out[i]);
+                        }
+                    }
+                }
+                break;
+            case Triangular: {
+                    // Inverse CDF, a and b are the bounds and c the mode
+                    const double a = params.triangular.a;
+                    const double b = params.triangular.b;
+                    const double c = params.triangular.c;
+                    const double split = (b > a) ? (c - a) / (b - a) : 0;
+                    for(size_t i = 0 ; i < n ; i++) {
+                        const double u = out[i];
+                        out[i] = u < split ?
+                            a + std::sqrt(u * (b - a) * (c - a)) :
+                            b - std::sqrt((1 - u) * (b - a) * (b - c));
+                    }
+                }
+                break;
+            default:
+                break;
+        }
+        for(size_t i = 0 ; i < n ; i++) {
+            out[i] = std::max(out[i], 0.0);
+        }
+        _next = 0;
+        _filled = n;
+    }
+
+}
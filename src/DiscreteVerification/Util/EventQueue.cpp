@@ -0,0 +1,71 @@
+#include "DiscreteVerification/Util/EventQueue.hpp"
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    void EventQueue::reset(size_t n) {
+        _heap.resize(n);
+        _position.resize(n);
+        for(size_t i = 0 ; i < n ; i++) {
+            _heap[i] = { std::numeric_limits<clockValue>::max(), i };
+            _position[i] = i;
+        }
+    }
+
+    void EventQueue::update(size_t id, clockValue date) {
+        size_t slot = _position[id];
+        clockValue old = _heap[slot].date;
+        _heap[slot].date = date;
+        if(date < old) {
+            siftUp(slot);
+        } else if(date > old) {
+            siftDown(slot);
+        }
+    }
+
+    void EventQueue::collect(clockValue bound, std::vector<size_t>& ids) const {
+        if(_heap.empty() || _heap.front().date > bound) return;
+        // Children are never earlier than their parent, so the matching
+        // events form a subtree rooted at the top, walked breadth first
+        size_t first = ids.size();
+        ids.push_back(0);
+        for(size_t k = first ; k < ids.size() ; k++) {
+            size_t slot = ids[k];
+            for(size_t child = 2 * slot + 1 ; child <= 2 * slot + 2 && child < _heap.size() ; child++) {
+                if(_heap[child].date <= bound) ids.push_back(child);
+            }
+        }
+        for(size_t k = first ; k < ids.size() ; k++) {
+            ids[k] = _heap[ids[k]].id;
+        }
+    }
+
+    void EventQueue::place(size_t slot, const Event& event) {
+        _heap[slot] = event;
+        _position[event.id] = slot;
+    }
+
+    void EventQueue::siftUp(size_t slot) {
+        Event event = _heap[slot];
+        while(slot > 0) {
+            size_t parent = (slot - 1) / 2;
+            if(_heap[parent].date <= event.date) break;
+            place(slot, _heap[parent]);
+            slot = parent;
+        }
+        place(slot, event);
+    }
+
+    void EventQueue::siftDown(size_t slot) {
+        Event event = _heap[slot];
+        while(true) {
+            size_t child = 2 * slot + 1;
+            if(child >= _heap.size()) break;
+            if(child + 1 < _heap.size() && _heap[child + 1].date < _heap[child].date) child++;
+            if(_heap[child].date >= event.date) break;
+            place(slot, _heap[child]);
+            slot = child;
+        }
+        place(slot, event);
+    }
+
+}
@@ -0,0 +1,133 @@
+#include "DiscreteVerification/Util/LogHistogram.hpp"
+#include "DiscreteVerification/Util/PartialResults.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    int32_t LogHistogram::bucketKey(double value) {
+        int exponent;
+        double mantissa = std::frexp(value, &exponent);
+        int32_t sub = std::min((int32_t) ((mantissa - 0.5) * 2 * LOG_HISTOGRAM_SUB_BUCKETS), LOG_HISTOGRAM_SUB_BUCKETS - 1);
+        return exponent * LOG_HISTOGRAM_SUB_BUCKETS + sub;
+    }
+
+    double LogHistogram::bucketValue(int32_t key) const {
+        int32_t exponent = key / LOG_HISTOGRAM_SUB_BUCKETS;
+        int32_t sub = key % LOG_HISTOGRAM_SUB_BUCKETS;
+        if(sub < 0) {
+            sub += LOG_HISTOGRAM_SUB_BUCKETS;
+            exponent--;
+        }
+        double mantissa = 0.5 + (sub + 0.5) / (2.0 * LOG_HISTOGRAM_SUB_BUCKETS);
+        return std::clamp(std::ldexp(mantissa, exponent), _min, _max);
+    }
+
+    void LogHistogram::add(double value, uint64_t count) {
+        if(count == 0) return;
+        if(_count == 0 || value < _min) _min = value;
+        if(_count == 0 || value > _max) _max = value;
+        _count += count;
+        if(value <= 0) {
+            _zeros += count;
+            return;
+        }
+        int32_t key = bucketKey(value);
+        if(_counts.empty()) {
+            _firstKey = key;
+        } else if(key < _firstKey) {
+            _counts.insert(_counts.begin(), _firstKey - key, 0);
+            _firstKey = key;
+        }
+        size_t index = key - _firstKey;
+        if(index >= _counts.size()) {
+            _counts.resize(index + 1, 0);
+        }
+        _counts[index] += count;
+    }
+
+    void LogHistogram::merge(const LogHistogram& other) {
+        if(other._count == 0) return;
+        if(_count == 0 || other._min < _min) _min = other._min;
+        if(_count == 0 || other._max > _max) _max = other._max;
+        _count += other._count;
+        _zeros += other._zeros;
+        if(other._counts.empty()) return;
+        if(_counts.empty()) {
+            _counts = other._counts;
+            _firstKey = other._firstKey;
+            return;
+        }
+        if(other._firstKey < _firstKey) {
+            _counts.insert(_counts.begin(), _firstKey - other._firstKey, 0);
+            _firstKey = other._firstKey;
+        }
+        size_t offset = other._firstKey - _firstKey;
+        if(offset + other._counts.size() > _counts.size()) {
+            _counts.resize(offset + other._counts.size(), 0);
+        }
+        for(size_t i = 0 ; i < other._counts.size() ; i++) {
+            _counts[offset + i] += other._counts[i];
+        }
+    }
+
+    void LogHistogram::clear() {
+        _counts.clear();
+        _firstKey = 0;
+        _zeros = 0;
+        _count = 0;
+        _min = std::numeric_limits<double>::quiet_NaN();
+        _max = std::numeric_limits<double>::quiet_NaN();
+    }
+
+    // Buckets as pairs of their offset from the first one and their count
+    void LogHistogram::write(PartialWriter& out) const {
+        out.putSigned(_firstKey);
+        out.putUnsigned(_zeros);
+        out.putUnsigned(_count);
+        out.putDouble(_min);
+        out.putDouble(_max);
+        size_t buckets = std::count_if(_counts.begin(), _counts.end(), [](uint64_t count) { return count > 0; });
+        out.putUnsigned(buckets);
+        for(size_t i = 0 ; i < _counts.size() ; i++) {
+            if(_counts[i] == 0) continue;
+            out.putUnsigned(i);
+            out.putUnsigned(_counts[i]);
+        }
+    }
+
+    void LogHistogram::read(PartialReader& in) {
+        _firstKey = (int32_t) in.getSigned();
+        _zeros = in.getUnsigned();
+        _count = in.getUnsigned();
+        _min = in.getDouble();
+        _max = in.getDouble();
+        _counts.clear();
+        size_t buckets = in.getSize();
+        for(size_t b = 0 ; b < buckets && in.good() ; b++) {
+            uint64_t index = in.getUnsigned();
+            uint64_t count = in.getUnsigned();
+            // Offsets are increasing, and the exponents of doubles span less than 2100 powers of two
+            if(index < _counts.size() || index >= (uint64_t) 2100 * LOG_HISTOGRAM_SUB_BUCKETS) {
+                in.fail();
+                break;
+            }
+            _counts.resize(index + 1, 0);
+            _counts[index] = count;
+        }
+    }
+
+    double LogHistogram::quantile(double q) const {
+        if(_count == 0) return std::numeric_limits<double>::quiet_NaN();
+        uint64_t rank = std::max((uint64_t) 1, (uint64_t) std::ceil(q * _count));
+        uint64_t seen = _zeros;
+        if(seen >= rank) return 0.0;
+        for(size_t i = 0 ; i < _counts.size() ; i++) {
+            seen += _counts[i];
+            if(seen >= rank) return bucketValue(_firstKey + (int32_t) i);
+        }
+        return _max;
+    }
+
+}
@@ -0,0 +1,83 @@
+#include "DiscreteVerification/Util/PartialResults.hpp"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    void PartialWriter::putUnsigned(uint64_t value) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), " %" PRIu64, value);
+        _line += buffer;
+    }
+
+    void PartialWriter::putSigned(int64_t value) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), " %" PRId64, value);
+        _line += buffer;
+    }
+
+    void PartialWriter::putDouble(double value) {
+        char buffer[48];
+        snprintf(buffer, sizeof(buffer), " %a", value);
+        _line += buffer;
+    }
+
+    PartialReader::PartialReader(const std::string& line) : _line(line) {
+        size_t end = _line.find(' ');
+        _kind = _line.substr(0, end);
+        _position = end == std::string::npos ? _line.size() : end;
+    }
+
+    // Start of the next value, nullptr when the record has no more
+    const char* PartialReader::next() {
+        while(_position < _line.size() && _line[_position] == ' ') _position++;
+        if(_position >= _line.size()) {
+            _good = false;
+            return nullptr;
+        }
+        return _line.c_str() + _position;
+    }
+
+    uint64_t PartialReader::getUnsigned() {
+        const char* start = next();
+        if(start == nullptr) return 0;
+        char* end;
+        uint64_t value = strtoull(start, &end, 10);
+        if(end == start || *start == '-') _good = false;
+        _position += end - start;
+        return value;
+    }
+
+    int64_t PartialReader::getSigned() {
+        const char* start = next();
+        if(start == nullptr) return 0;
+        char* end;
+        int64_t value = strtoll(start, &end, 10);
+        if(end == start) _good = false;
+        _position += end - start;
+        return value;
+    }
+
+    double PartialReader::getDouble() {
+        const char* start = next();
+        if(start == nullptr) return 0;
+        char* end;
+        double value = strtod(start, &end);
+        if(end == start) _good = false;
+        _position += end - start;
+        return value;
+    }
+
+    // Every value takes at least two characters
+    size_t PartialReader::getSize() {
+        uint64_t size = getUnsigned();
+        if(size > (_line.size() - _position) / 2) {
+            _good = false;
+            return 0;
+        }
+        return size;
+    }
+
+}
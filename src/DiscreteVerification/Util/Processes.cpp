@@ -0,0 +1,240 @@
+#include "DiscreteVerification/Util/Processes.hpp"
+#include "DiscreteVerification/Util/PartialResults.hpp"
+
+#include <cstdio>
+#include <iostream>
+
+#ifndef _WIN32
+#include <csignal>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// How often the stop listener checks whether it must end
+#define STOP_LISTENER_POLL_MS 10
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+#ifdef _WIN32
+
+    bool processesSupported() { return false; }
+    bool forkProcess(const std::function<void(int, int)>&, const std::vector<ChildProcess>&, ChildProcess&) { return false; }
+    bool spawnCommand(const std::string&, ChildProcess&) { return false; }
+    bool waitProcess(ChildProcess&) { return false; }
+    void ignoreBrokenPipes() { }
+    int detachStandardOutput() { return -1; }
+    bool writeAll(int, const std::string&) { return false; }
+    bool readLine(int, std::string&) { return false; }
+    std::vector<size_t> waitReadable(const std::vector<int>&, int) { return { }; }
+    bool LineReader::read(std::vector<std::string>&) { return false; }
+    StopListener::StopListener(int fd, std::atomic<bool>& stop, std::atomic<uint64_t>& committed)
+        : _fd(fd), _stop(stop), _committed(committed) { }
+    StopListener::~StopListener() { }
+    void StopListener::listen() { }
+
+#else
+
+    bool processesSupported() {
+        return true;
+    }
+
+    // Our ends are not inherited by the commands we start later
+    static bool makePipes(int toChild[2], int fromChild[2]) {
+        if(pipe(toChild) != 0) return false;
+        if(pipe(fromChild) != 0) {
+            close(toChild[0]);
+            close(toChild[1]);
+            return false;
+        }
+        fcntl(toChild[1], F_SETFD, FD_CLOEXEC);
+        fcntl(fromChild[0], F_SETFD, FD_CLOEXEC);
+        return true;
+    }
+
+    static void closePipes(int toChild[2], int fromChild[2]) {
+        close(toChild[0]);
+        close(toChild[1]);
+        close(fromChild[0]);
+        close(fromChild[1]);
+    }
+
+    bool forkProcess(const std::function<void(int input, int output)>& body, const std::vector<ChildProcess>& siblings, ChildProcess& child) {
+        int toChild[2], fromChild[2];
+        if(!makePipes(toChild, fromChild)) return false;
+        // Whatever is buffered would otherwise be written twice
+        std::cout.flush();
+        fflush(stdout);
+        pid_t pid = fork();
+        if(pid < 0) {
+            closePipes(toChild, fromChild);
+            return false;
+        }
+        if(pid == 0) {
+            close(toChild[1]);
+            close(fromChild[0]);
+            for(const ChildProcess& sibling : siblings) {
+                close(sibling.input);
+                close(sibling.output);
+            }
+            int null = open("/dev/null", O_WRONLY);
+            if(null >= 0) dup2(null, STDOUT_FILENO);
+            body(toChild[0], fromChild[1]);
+            std::cout.flush();
+            fflush(stdout);
+            _exit(0);
+        }
+        close(toChild[0]);
+        close(fromChild[1]);
+        child.pid = pid;
+        child.input = toChild[1];
+        child.output = fromChild[0];
+        return true;
+    }
+
+    bool spawnCommand(const std::string& command, ChildProcess& child) {
+        int toChild[2], fromChild[2];
+        if(!makePipes(toChild, fromChild)) return false;
+        std::cout.flush();
+        fflush(stdout);
+        pid_t pid = fork();
+        if(pid < 0) {
+            closePipes(toChild, fromChild);
+            return false;
+        }
+        if(pid == 0) {
+            dup2(toChild[0], STDIN_FILENO);
+            dup2(fromChild[1], STDOUT_FILENO);
+            close(toChild[0]);
+            close(fromChild[1]);
+            execl("/bin/sh", "sh", "-c", command.c_str(), (char*) nullptr);
+            _exit(127);
+        }
+        close(toChild[0]);
+        close(fromChild[1]);
+        child.pid = pid;
+        child.input = toChild[1];
+        child.output = fromChild[0];
+        return true;
+    }
+
+    bool waitProcess(ChildProcess& child) {
+        if(child.input >= 0) close(child.input);
+        if(child.output >= 0) close(child.output);
+        child.input = -1;
+        child.output = -1;
+        if(child.pid < 0) return false;
+        int status;
+        pid_t result;
+        do {
+            result = waitpid(child.pid, &status, 0);
+        } while(result < 0 && errno == EINTR);
+        child.pid = -1;
+        return result > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+    void ignoreBrokenPipes() {
+        std::signal(SIGPIPE, SIG_IGN);
+    }
+
+    int detachStandardOutput() {
+        std::cout.flush();
+        fflush(stdout);
+        int output = dup(STDOUT_FILENO);
+        if(output >= 0) dup2(STDERR_FILENO, STDOUT_FILENO);
+        return output;
+    }
+
+    bool writeAll(int fd, const std::string& data) {
+        size_t written = 0;
+        while(written < data.size()) {
+            ssize_t n = write(fd, data.data() + written, data.size() - written);
+            if(n < 0 && errno == EINTR) continue;
+            if(n <= 0) return false;
+            written += n;
+        }
+        return true;
+    }
+
+    bool readLine(int fd, std::string& line) {
+        line.clear();
+        char c;
+        while(true) {
+            ssize_t n = read(fd, &c, 1);
+            if(n < 0 && errno == EINTR) continue;
+            if(n <= 0) return false;
+            if(c == '\n') return true;
+            line += c;
+        }
+    }
+
+    std::vector<size_t> waitReadable(const std::vector<int>& fds, int timeoutMs) {
+        std::vector<pollfd> polled;
+        std::vector<size_t> indexes;
+        for(size_t i = 0 ; i < fds.size() ; i++) {
+            if(fds[i] < 0) continue;
+            polled.push_back({ fds[i], POLLIN, 0 });
+            indexes.push_back(i);
+        }
+        std::vector<size_t> ready;
+        if(poll(polled.data(), polled.size(), timeoutMs) <= 0) return ready;
+        for(size_t i = 0 ; i < polled.size() ; i++) {
+            if(polled[i].revents != 0) ready.push_back(indexes[i]);
+        }
+        return ready;
+    }
+
+    bool LineReader::read(std::vector<std::string>& lines) {
+        char buffer[65536];
+        ssize_t n = ::read(_fd, buffer, sizeof(buffer));
+        if(n < 0) return errno == EINTR || errno == EAGAIN;
+        // A line without its new line was cut short by the end of the writer, it is dropped
+        if(n == 0) return false;
+        _pending.append(buffer, n);
+        size_t start = 0;
+        size_t end;
+        while((end = _pending.find('\n', start)) != std::string::npos) {
+            lines.push_back(_pending.substr(start, end - start));
+            start = end + 1;
+        }
+        _pending.erase(0, start);
+        return true;
+    }
+
+    StopListener::StopListener(int fd, std::atomic<bool>& stop, std::atomic<uint64_t>& committed)
+        : _fd(fd), _stop(stop), _committed(committed) {
+        _listener = std::thread(&StopListener::listen, this);
+    }
+
+    StopListener::~StopListener() {
+        _done = true;
+        _listener.join();
+    }
+
+    void StopListener::listen() {
+        LineReader reader(_fd);
+        std::vector<std::string> lines;
+        while(!_done) {
+            if(waitReadable({ _fd }, STOP_LISTENER_POLL_MS).empty()) continue;
+            bool open = reader.read(lines);
+            for(const std::string& line : lines) {
+                if(line == "smc-stop") open = false;
+                PartialReader record(line);
+                if(record.kind() != "smc-committed") continue;
+                uint64_t committed = record.getUnsigned();
+                // The updates only ever raise it, whatever the order they come in
+                if(record.good() && committed > _committed) _committed = committed;
+            }
+            lines.clear();
+            if(!open) {
+                _stop = true;
+                return;
+            }
+        }
+    }
+
+#endif
+
+}
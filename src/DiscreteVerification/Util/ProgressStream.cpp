@@ -0,0 +1,108 @@
+#include "DiscreteVerification/Util/ProgressStream.hpp"
+
+#include <cmath>
+#include <cstdlib>
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    FILE* openOutput(const std::string& destination, bool& owned) {
+        FILE* out;
+        if(destination == "_") {
+            out = stdout;
+            owned = false;
+        } else if(destination.size() > 1 && destination[0] == '&') {
+            out = fdopen(atoi(destination.c_str() + 1), "w");
+            owned = out != nullptr;
+        } else {
+            out = fopen(destination.c_str(), "w");
+            owned = out != nullptr;
+        }
+        return out;
+    }
+
+    ProgressStream::ProgressStream(const std::string& destination) {
+        _out = openOutput(destination, _owned);
+    }
+
+    ProgressStream::~ProgressStream() {
+        if(_owned) fclose(_out);
+    }
+
+    // Keys are plain identifiers, they need no escaping
+    void ProgressStream::key(const std::string& key) {
+        _line << (_empty ? "{\"" : ",\"") << key << "\":";
+        _empty = false;
+    }
+
+    void ProgressStream::number(double value) {
+        if(std::isfinite(value)) {
+            _line << value;
+        } else {
+            _line << "null";
+        }
+    }
+
+    ProgressStream& ProgressStream::field(const std::string& key, double value) {
+        this->key(key);
+        number(value);
+        return *this;
+    }
+
+    ProgressStream& ProgressStream::field(const std::string& key, uint64_t value) {
+        this->key(key);
+        _line << value;
+        return *this;
+    }
+
+    ProgressStream& ProgressStream::field(const std::string& key, bool value) {
+        this->key(key);
+        _line << (value ? "true" : "false");
+        return *this;
+    }
+
+    ProgressStream& ProgressStream::field(const std::string& key, const std::string& value) {
+        this->key(key);
+        _line << '"';
+        for(char c : value) {
+            if(c == '"' || c == '\\') {
+                _line << '\\' << c;
+            } else if((unsigned char) c < 0x20) {
+                _line << ' ';
+            } else {
+                _line << c;
+            }
+        }
+        _line << '"';
+        return *this;
+    }
+
+    ProgressStream& ProgressStream::field(const std::string& key, const std::vector<double>& values) {
+        this->key(key);
+        _line << "[";
+        for(size_t i = 0 ; i < values.size() ; i++) {
+            if(i > 0) _line << ",";
+            number(values[i]);
+        }
+        _line << "]";
+        return *this;
+    }
+
+    ProgressStream& ProgressStream::nullField(const std::string& key) {
+        this->key(key);
+        _line << "null";
+        return *this;
+    }
+
+    void ProgressStream::endLine() {
+        if(_empty) _line << "{";
+        _line << "}\n";
+        if(_out != nullptr) {
+            std::string line = _line.str();
+            fwrite(line.data(), 1, line.size(), _out);
+            fflush(_out);
+        }
+        _line.str("");
+        _empty = true;
+    }
+
+}
@@ -0,0 +1,56 @@
+#include "DiscreteVerification/Util/RunningStats.hpp"
+#include "DiscreteVerification/Util/PartialResults.hpp"
+
+#include <cmath>
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    void RunningStats::add(double value) {
+        _count++;
+        double delta = value - _mean;
+        _mean += delta / _count;
+        _m2 += delta * (value - _mean);
+        if(_count == 1 || value < _min) _min = value;
+        if(_count == 1 || value > _max) _max = value;
+    }
+
+    void RunningStats::merge(const RunningStats& other) {
+        if(other._count == 0) return;
+        if(_count == 0) {
+            *this = other;
+            return;
+        }
+        uint64_t count = _count + other._count;
+        double delta = other._mean - _mean;
+        _mean += delta * other._count / count;
+        _m2 += other._m2 + delta * delta * ((double) _count * other._count / count);
+        _count = count;
+        if(other._min < _min) _min = other._min;
+        if(other._max > _max) _max = other._max;
+    }
+
+    void RunningStats::write(PartialWriter& out) const {
+        out.putUnsigned(_count);
+        out.putDouble(_mean);
+        out.putDouble(_m2);
+        out.putDouble(_min);
+        out.putDouble(_max);
+    }
+
+    void RunningStats::read(PartialReader& in) {
+        _count = in.getUnsigned();
+        _mean = in.getDouble();
+        _m2 = in.getDouble();
+        _min = in.getDouble();
+        _max = in.getDouble();
+    }
+
+    double RunningStats::variance() const {
+        return _count == 0 ? 0 : _m2 / _count;
+    }
+
+    double RunningStats::stdDev() const {
+        return std::sqrt(variance());
+    }
+
+}
@@ -0,0 +1,68 @@
+#include "DiscreteVerification/Util/TimeBudget.hpp"
+
+#include <csignal>
+
+// A signal handler may only set a lock-free flag, the watcher polls it this often
+#define SMC_BUDGET_POLL_MS 10
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    static std::atomic<bool> signaled { false };
+    static void (*previousTerm)(int) = SIG_DFL;
+#ifdef SIGUSR1
+    static void (*previousUsr1)(int) = SIG_DFL;
+#endif
+
+    static void onSignal(int) {
+        signaled.store(true);
+    }
+
+    TimeBudget::TimeBudget(double seconds, std::atomic<bool>& stop)
+    : _stop(stop), _hasDeadline(seconds > 0)
+    {
+        auto now = std::chrono::steady_clock::now();
+        // A budget beyond the range of the clock would overflow, it never runs out. Half of the
+        // range left leaves room for the rounding of the conversion.
+        std::chrono::duration<double> left = std::chrono::steady_clock::time_point::max() - now;
+        if(seconds < left.count() / 2) {
+            _deadline = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+        } else {
+            _deadline = std::chrono::steady_clock::time_point::max();
+        }
+        signaled = false;
+        previousTerm = std::signal(SIGTERM, onSignal);
+#ifdef SIGUSR1
+        previousUsr1 = std::signal(SIGUSR1, onSignal);
+#endif
+        _watcher = std::thread(&TimeBudget::watch, this);
+    }
+
+    TimeBudget::~TimeBudget() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _done = true;
+        }
+        _wake.notify_one();
+        _watcher.join();
+        std::signal(SIGTERM, previousTerm == SIG_ERR ? SIG_DFL : previousTerm);
+#ifdef SIGUSR1
+        std::signal(SIGUSR1, previousUsr1 == SIG_ERR ? SIG_DFL : previousUsr1);
+#endif
+    }
+
+    void TimeBudget::watch() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while(!_done) {
+            auto wakeUp = std::chrono::steady_clock::now() + std::chrono::milliseconds(SMC_BUDGET_POLL_MS);
+            if(_hasDeadline && _deadline < wakeUp) wakeUp = _deadline;
+            _wake.wait_until(lock, wakeUp);
+            if(_done) return;
+            if(signaled.load() || (_hasDeadline && std::chrono::steady_clock::now() >= _deadline)) {
+                _expired = true;
+                _stop = true;
+                return;
+            }
+        }
+    }
+
+}
@@ -0,0 +1,101 @@
+#include "DiscreteVerification/Util/WorkerPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <string>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace VerifyTAPN::DiscreteVerification::Util {
+
+    // CPU quota of the cgroup we run in (0 if unlimited), cgroup v2 stores
+    // "<quota> <period>" in cpu.max, v1 splits it over two files
+    static unsigned int cgroupCores() {
+        double quota = -1;
+        double period = 0;
+        std::ifstream v2("/sys/fs/cgroup/cpu.max");
+        if(v2) {
+            std::string rawQuota;
+            v2 >> rawQuota >> period;
+            if(rawQuota != "max") {
+                quota = std::strtod(rawQuota.c_str(), nullptr);
+            }
+        } else {
+            std::ifstream v1Quota("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+            std::ifstream v1Period("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+            if(v1Quota && v1Period) {
+                v1Quota >> quota;
+                v1Period >> period;
+            }
+        }
+        if(quota <= 0 || period <= 0) return 0;
+        return std::max(1u, (unsigned int) std::ceil(quota / period));
+    }
+
+    unsigned int availableCores() {
+        unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+#ifdef __linux__
+        cpu_set_t set;
+        if(sched_getaffinity(0, sizeof(set), &set) == 0) {
+            cores = std::min(cores, (unsigned int) std::max(1, CPU_COUNT(&set)));
+        }
+        unsigned int quota = cgroupCores();
+        if(quota > 0) {
+            cores = std::min(cores, quota);
+        }
+#endif
+        return cores;
+    }
+
+    WorkerPool::WorkerPool(unsigned int n_threads) {
+        n_threads = std::max(1u, n_threads);
+        for(unsigned int i = 0 ; i < n_threads ; i++) {
+            _threads.emplace_back(&WorkerPool::work, this, i);
+        }
+    }
+
+    WorkerPool::~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _start.notify_all();
+        for(auto& thread : _threads) {
+            thread.join();
+        }
+    }
+
+    void WorkerPool::run(const std::function<void(unsigned int)>& task) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _task = &task;
+        _running = _threads.size();
+        _generation++;
+        _start.notify_all();
+        _done.wait(lock, [this]() { return _running == 0; });
+        _task = nullptr;
+    }
+
+    void WorkerPool::work(unsigned int thread_id) {
+        uint64_t seen = 0;
+        while(true) {
+            const std::function<void(unsigned int)>* task;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _start.wait(lock, [this, seen]() { return _stop || _generation != seen; });
+                if(_stop) return;
+                seen = _generation;
+                task = _task;
+            }
+            (*task)(thread_id);
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _running--;
+                if(_running == 0) _done.notify_one();
+            }
+        }
+    }
+
+}
@@ -105,10 +105,7 @@ namespace VerifyTAPN { namespace DiscreteVerification {
             return false;
         }
 
-        QueryVisitor<NonStrictMarking> checker(*marking, tapn);
-        AST::BoolResult context;
-        query->accept(checker, context);
-        if (!context.value) {
+        if (!queryProgram.holds(*marking, tapn)) {
             delete marking;
             return false;
         }
@@ -1,50 +1,173 @@
 #include "DiscreteVerification/VerificationTypes/ProbabilityComparison.hpp"
-#include "DiscreteVerification/QueryVisitor.hpp"
 
 #include <iostream>
+#include <algorithm>
+#include <math.h>
 
 namespace VerifyTAPN::DiscreteVerification {
 
+using Util::clockToDouble;
+
 ProbabilityComparison::ProbabilityComparison(
     TAPN::TimedArcPetriNet &tapn, RealMarking &initialMarking, AST::SMCQuery *query_1, AST::SMCQuery *query_2, VerificationOptions options
-) : Verification(tapn, initialMarking, query_1, options), maxTokensSeen(0), numberOfRuns(0), result(0), mayBeIndifferent(true),
-    acceptingRuns(0), ratio_indifferent(0), finished(false),
-    runGenerator(tapn, options.getSMCNumericPrecision())
+) : SMCVerification(tapn, initialMarking, query_1, options), query_1(query_1), query_2(query_2),
+    program_2(*query_2), incrementalQuery_2(*query_2, tapn), queryStates_2(queryStates.size())
 {
-    this->query_1 = query_1;
-    this->query_2 = query_2;
+    maxTimeBound = std::max(query_1->getSmcSettings().timeBound, query_2->getSmcSettings().timeBound);
+    maxStepBound = std::max(query_1->getSmcSettings().stepBound, query_2->getSmcSettings().stepBound);
+    float up = smcSettings.indifferenceRegionUp;
+    float down = smcSettings.indifferenceRegionDown;
+    computeIndifferenceRegion(1 - up - down, up, down);
+    initRunsResults();
+}
+
+void ProbabilityComparison::prepare() {
+    // A pair is made of two runs, there is no single trace to show for it
+    options.setSmcTraces(0);
 }
 
-bool ProbabilityComparison::run() {
-    runGenerator.prepare(&initialMarking);
-    while(mustDoAnotherRun()) {
-        bool runResQ1 = executeRunFor(query_1);
-        bool runResQ2 = executeRunFor(query_2);
-        handleRunsResults(runResQ1, runResQ2);
-        numberOfRuns += 2;
+bool ProbabilityComparison::executeRun(SMCRunGenerator* generator) {
+    if(generator == nullptr) generator = &runGenerator;
+    PairOutcome& current = threadCurrent[generator->_thread_id];
+    current.steps = 0;
+    current.delay = 0;
+    if(options.isSmcCommonRuns()) {
+        executeCommonRun(generator);
+        recordRunLength(generator, maxTimeBound, maxStepBound);
+        return current.resQ1;
     }
-    return true;
+    const SMCSettings& settingsQ1 = query_1->getSmcSettings();
+    const SMCSettings& settingsQ2 = query_2->getSmcSettings();
+    current.resQ1 = executeRunFor(query_1, generator);
+    recordRunLength(generator, settingsQ1.timeBound, settingsQ1.stepBound);
+    generator->reset(generator->getRunIndex(), 1);
+    current.resQ2 = executeRunFor(query_2, generator);
+    recordRunLength(generator, settingsQ2.timeBound, settingsQ2.stepBound);
+    return current.resQ1;
 }
 
-bool ProbabilityComparison::executeRunFor(AST::SMCQuery* query) {
+bool ProbabilityComparison::executeRunFor(AST::SMCQuery* query, SMCRunGenerator* generator) {
     bool runRes = false;
-    RealMarking* newMarking = runGenerator.getMarking();
-    while(!runGenerator.reachedEnd() && !reachedRunBound(query)) {
-        RealMarking* child = new RealMarking(*newMarking);
-        setMaxTokensIfGreater(child->size());
-        runRes = handleSuccessor(query, child);
+    RealMarking* marking = generator->getMarking();
+    clockValue timeBound = toClock(query->getSmcSettings().timeBound, options.getSMCNumericPrecision());
+    int stepBound = query->getSmcSettings().stepBound;
+    while(!generator->reachedEnd() && !reachedRunBound(timeBound, stepBound, generator)) {
+        if(stopRequested.load(std::memory_order_relaxed)) break;
+        runRes = evaluate(query, *marking);
         if(runRes) break;
-        newMarking = runGenerator.next();
+        marking = generator->next();
     }
-    totalTime += runGenerator.getRunDelay();
-    totalSteps += runGenerator.getRunSteps();
-    runGenerator.reset();
     return runRes;
 }
 
+// Both queries are checked on every marking of the run, each until it holds or its own bounds
+// are exceeded, so that each outcome is the one executeRunFor would give on this same run
+void ProbabilityComparison::executeCommonRun(SMCRunGenerator* generator) {
+    PairOutcome& current = threadCurrent[generator->_thread_id];
+    unsigned int precision = options.getSMCNumericPrecision();
+    clockValue timeBoundQ1 = toClock(query_1->getSmcSettings().timeBound, precision);
+    clockValue timeBoundQ2 = toClock(query_2->getSmcSettings().timeBound, precision);
+    int stepBoundQ1 = query_1->getSmcSettings().stepBound;
+    int stepBoundQ2 = query_2->getSmcSettings().stepBound;
+    current.resQ1 = false;
+    current.resQ2 = false;
+    bool pendingQ1 = true;
+    bool pendingQ2 = true;
+    RealMarking* marking = generator->getMarking();
+    while(!generator->reachedEnd()) {
+        if(stopRequested.load(std::memory_order_relaxed)) break;
+        if(pendingQ1) {
+            pendingQ1 = !reachedRunBound(timeBoundQ1, stepBoundQ1, generator);
+            if(pendingQ1 && evaluate(query_1, *marking)) {
+                current.resQ1 = true;
+                pendingQ1 = false;
+            }
+        }
+        if(pendingQ2) {
+            pendingQ2 = !reachedRunBound(timeBoundQ2, stepBoundQ2, generator);
+            if(pendingQ2 && evaluate(query_2, *marking)) {
+                current.resQ2 = true;
+                pendingQ2 = false;
+            }
+        }
+        if(!pendingQ1 && !pendingQ2) break;
+        marking = generator->next();
+    }
+}
+
+bool ProbabilityComparison::evaluate(AST::SMCQuery* query, RealMarking& marking) {
+    if(query == query_1) return queryHolds(marking);
+    if(marking._thread_id >= queryStates_2.size()) return program_2.holds(marking, tapn);
+    return incrementalQuery_2.holds(queryStates_2[marking._thread_id], marking);
+}
+
+void ProbabilityComparison::recordRunLength(SMCRunGenerator* generator, double timeBound, int stepBound) {
+    PairOutcome& current = threadCurrent[generator->_thread_id];
+    unsigned int precision = options.getSMCNumericPrecision();
+    current.steps += std::min(generator->getRunSteps(), stepBound);
+    current.delay += clockToDouble(std::min(generator->getRunDelay(), toClock(timeBound, precision)), precision);
+}
+
+bool ProbabilityComparison::handleMarking(RealMarking& marking) {
+    return evaluate(query_1, marking);
+}
+
+// The length of the runs of the pair is recorded by executeRun, against the bounds of each query
+void ProbabilityComparison::handleRunResult(const bool res, int steps, double delay, uint64_t run, unsigned int thread_id) {
+    threadOutcomes[thread_id].emplace_back(run, threadCurrent[thread_id]);
+}
+
+void ProbabilityComparison::initRunsResults(unsigned int n_threads) {
+    threadCurrent = std::vector<PairOutcome>(n_threads);
+    threadOutcomes = std::vector<std::vector<std::pair<uint64_t, PairOutcome>>>(n_threads);
+    pendingOutcomes.clear();
+    runsCommitted = 0;
+    committedPairs = 0;
+    committedTime = 0;
+    committedSteps = 0;
+    mayBeIndifferent = true;
+    ratio_indifferent = 0;
+    acceptingRuns = 0;
+    validRunsQ1 = 0;
+    validRunsQ2 = 0;
+    result = INDIFFERENT;
+    finished = false;
+    computeAcceptingBounds(smcSettings.falsePositives, smcSettings.falseNegatives);
+}
+
+void ProbabilityComparison::mergeRunResults(unsigned int thread_id) {
+    for(auto& [run, outcome] : threadOutcomes[thread_id]) {
+        pendingOutcomes.push(run, outcome);
+    }
+    threadOutcomes[thread_id].clear();
+    PairOutcome outcome;
+    while(!finished && pendingOutcomes.pop(outcome)) {
+        committedPairs++;
+        committedTime += outcome.delay;
+        committedSteps += outcome.steps;
+        handleRunsResults(outcome.resQ1, outcome.resQ2);
+    }
+    runsCommitted = pendingOutcomes.next();
+}
+
+void ProbabilityComparison::discardRunResults(unsigned int thread_id) {
+    threadOutcomes[thread_id].clear();
+}
+
+// Only the runs that took part in the decision are reported, one or two per pair
+void ProbabilityComparison::finalizeRunsResults() {
+    SMCVerification::finalizeRunsResults();
+    numberOfRuns = options.isSmcCommonRuns() ? committedPairs : 2 * committedPairs;
+    totalTime = committedTime;
+    totalSteps = committedSteps;
+    pendingOutcomes.clear();
+}
+
 void ProbabilityComparison::handleRunsResults(bool resQ1, bool resQ2) {
     if(query_1->getQuantifier() == PG) resQ1 = !resQ1;
     if(query_2->getQuantifier() == PG) resQ2 = !resQ2;
+    validRunsQ1 += (int) resQ1;
+    validRunsQ2 += (int) resQ2;
     bool eq = resQ1 == resQ2;
     if(mayBeIndifferent) {
         ratio_indifferent += eq ? log(p1 / p0) : log((1 - p1) / (1 - p0));
@@ -73,17 +196,6 @@ void ProbabilityComparison::handleRunsResults(bool resQ1, bool resQ2) {
     }
 }
 
-bool ProbabilityComparison::handleSuccessor(AST::SMCQuery* current_query, RealMarking* marking) {
-
-    QueryVisitor<RealMarking> checker(*marking, tapn);
-    AST::BoolResult context;
-    current_query->accept(checker, context);
-
-    delete marking;
-
-    return context.value;
-}
-
 bool ProbabilityComparison::mustDoAnotherRun() {
     return !finished;
 }
@@ -92,24 +204,34 @@ int ProbabilityComparison::getResult() {
     return result;
 }
 
+// Among the pairs that disagree, query_2 holds with probability theta = 1 / (1 + r), r being the
+// odds ratio of query_1 over query_2. On common runs r is the ratio of P(Q1 and not Q2) over
+// P(Q2 and not Q1), still above 1 exactly when query_1 is the more likely. Wald's test of theta = 1 / (1 + u1) (accept) against
+// theta = 1 / (1 + u0) (reject) has linear bounds on the number of such pairs where query_2 holds.
 void ProbabilityComparison::computeAcceptingBounds(const float alpha, const float beta) {
     boundIndiffH0 = log(beta / (1 - alpha));
     boundIndiffH1 = log((1 - beta) / alpha);
-
+    float thetaAccept = 1 / (1 + u1);
+    float thetaReject = 1 / (1 + u0);
+    float scale = log(thetaReject * (1 - thetaAccept) / (thetaAccept * (1 - thetaReject)));
+    boundH0 = boundIndiffH0 / scale;
+    boundH1 = boundIndiffH1 / scale;
+    boundIncr = log((1 - thetaAccept) / (1 - thetaReject)) / scale;
 }
 
+// The queries are deemed indifferent if they agree with probability at least p + sigma0, and
+// distinguishable if at most p - sigma1. The odds ratio is tested outside of [1 - sigma1, 1 + sigma0].
 void ProbabilityComparison::computeIndifferenceRegion(const float p, const float sigma0, const float sigma1) {
-
-}
-
-bool ProbabilityComparison::reachedRunBound(AST::SMCQuery* current_query) {
-    return 
-        runGenerator.getRunDelay() >= current_query->getSmcSettings().timeBound ||
-        runGenerator.getRunSteps() >= current_query->getSmcSettings().stepBound;
+    p0 = std::clamp(p + sigma0, 0.0f, 1.0f);
+    p1 = std::clamp(p - sigma1, 0.0f, 1.0f);
+    u0 = std::max(1 - sigma1, 0.0f);
+    u1 = 1 + sigma0;
 }
 
 void ProbabilityComparison::printStats() {
-
+    SMCVerification::printStats();
+    std::cout << "  valid runs (first query):\t" << validRunsQ1 << std::endl;
+    std::cout << "  valid runs (second query):\t" << validRunsQ2 << std::endl;
 }
 
 void ProbabilityComparison::printResult() {
@@ -118,19 +240,15 @@ void ProbabilityComparison::printResult() {
                             result == ACCEPT ? "Accepted" :
                             "Undecided";
     std::cout << "Probability comparison:" << std::endl;
-    std::cout << "\tHypothesis is " << resultStr << std::endl;
-}
-
-unsigned int ProbabilityComparison::maxUsedTokens() {
-    return maxTokensSeen;
-}
-
-void ProbabilityComparison::setMaxTokensIfGreater(unsigned int i) {
-    if(i > maxTokensSeen) {
-        maxTokensSeen = i;
+    std::cout << "\tIndifference region: [" << u0 << "," << u1 << "]" << std::endl;
+    std::cout << "\tFalse positives: " << smcSettings.falsePositives << std::endl;
+    std::cout << "\tFalse negatives: " << smcSettings.falseNegatives << std::endl;
+    if(!finished) {
+        // Stopped by the time budget before the test ended
+        std::cout << "\tHypothesis is undecided after " << committedPairs << " pairs of runs" << std::endl;
+        return;
     }
+    std::cout << "\tHypothesis is " << resultStr << std::endl;
 }
 
-
-
 }
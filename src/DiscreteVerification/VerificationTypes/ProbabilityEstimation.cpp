@@ -1,87 +1,365 @@
 #include "DiscreteVerification/VerificationTypes/ProbabilityEstimation.hpp"
 #include "DiscreteVerification/QueryVisitor.hpp"
+#include "DiscreteVerification/QueryDistanceVisitor.hpp"
+#include "DiscreteVerification/Util/BinomialInterval.hpp"
 
 #include <math.h>
+#include <algorithm>
+#include <iterator>
+#include <tuple>
+
+// Sequential estimation : share of the error probability spent on the interval checks,
+// the rest goes to the Chernoff-Hoeffding bound that caps the number of runs
+#define SMC_SEQUENTIAL_ALPHA_SHARE 0.1
+// Runs before the first check, and growth of the number of runs between two checks
+#define SMC_SEQUENTIAL_FIRST_CHECK 32
+#define SMC_SEQUENTIAL_CHECK_GROWTH 1.2
+// Importance sampling : valid runs before the normal interval on the weighted runs is trusted
+#define SMC_IMPORTANCE_MIN_VALID_RUNS 30
+// Cross-entropy tuning : share of elite runs per iteration, bound on the iterations,
+// and bounds of the factors applied to the rates and weights
+#define SMC_CE_RHO 0.1
+#define SMC_CE_MAX_ITERATIONS 20
+// Iterations in a row without getting closer to the query before giving up
+#define SMC_CE_MAX_STALLS 3
+#define SMC_CE_MIN_FACTOR 1e-3
+#define SMC_CE_MAX_FACTOR 1e3
 
 namespace VerifyTAPN::DiscreteVerification {
 
 ProbabilityEstimation::ProbabilityEstimation(
     TAPN::TimedArcPetriNet &tapn, RealMarking &initialMarking, AST::SMCQuery *query, VerificationOptions options
 )
-: SMCVerification(tapn, initialMarking, query, options), validRuns(0)
+: SMCVerification(tapn, initialMarking, query, options), validRuns(0),
+  importanceRuns(options.getImportanceSamplingRuns())
 {
-    computeChernoffHoeffdingBound(smcSettings.estimationIntervalWidth, smcSettings.confidence);
+    hoeffdingRuns = computeChernoffHoeffdingBound(smcSettings.estimationIntervalWidth, smcSettings.confidence);
+    runsNeeded = hoeffdingRuns;
+    // Under importance sampling it only caps the runs, weighted runs stop on their own interval
+    weightedStopping = importanceRuns > 0;
+    // The exact interval checks only hold for unweighted runs
+    if(options.isSequentialEstimation() && importanceRuns == 0) {
+        sequential = true;
+        float capConfidence = 1 - (1 - smcSettings.confidence) * (1 - SMC_SEQUENTIAL_ALPHA_SHARE);
+        runsNeeded = computeChernoffHoeffdingBound(smcSettings.estimationIntervalWidth, capConfidence);
+    }
 }
 
 bool ProbabilityEstimation::mustDoAnotherRun() {
-    return numberOfRuns < runsNeeded;
+    return !decided;
+}
+
+// Checks are made at geometrically spaced numbers of runs, the k-th one at level
+// alpha_k = alpha * 6 / (pi^2 k^2) so that all of them together fail with probability
+// at most alpha, whenever the estimation stops
+double ProbabilityEstimation::nextCheckLevel(double alpha) {
+    checks++;
+    nextCheck = std::max(committedRuns + 1, (uint64_t) ceil(committedRuns * SMC_SEQUENTIAL_CHECK_GROWTH));
+    return alpha * 6.0 / (M_PI * M_PI * checks * checks);
+}
+
+// The checks spend a share of alpha, the rest goes to the cap of the runs
+bool ProbabilityEstimation::sequentialPrecisionReached() {
+    double alpha = nextCheckLevel((1 - smcSettings.confidence) * SMC_SEQUENTIAL_ALPHA_SHARE);
+    auto [lower, upper] = Util::clopperPearson(committedValidRuns, committedRuns, alpha);
+    double estimation = committedValidRuns / (double) committedRuns;
+    double width = smcSettings.estimationIntervalWidth;
+    return upper - estimation <= width && estimation - lower <= width;
+}
+
+// Normal interval on the mean of the weighted runs : the likelihood ratios are not bounded
+// by 1, so the checks spend all of alpha and the cap of the runs guarantees nothing
+bool ProbabilityEstimation::weightedPrecisionReached() {
+    double alpha = nextCheckLevel(1 - smcSettings.confidence);
+    const Util::RunningStats& weighted = mergedStats.weighted;
+    if(committedValidRuns < SMC_IMPORTANCE_MIN_VALID_RUNS || weighted.count() == 0) return false;
+    double halfWidth = Util::normalQuantile(1 - alpha / 2) * weighted.stdDev() / sqrt(weighted.count());
+    precisionReached = halfWidth <= smcSettings.estimationIntervalWidth;
+    return precisionReached;
 }
 
 void ProbabilityEstimation::prepare()
 {
-    std::cout << "Need to execute " << runsNeeded << " runs to produce estimation" << std::endl;
+    if(sequential || weightedStopping) {
+        std::cout << "Need to execute at most " << runsNeeded << " runs to produce estimation" << std::endl;
+    } else {
+        std::cout << "Need to execute " << runsNeeded << " runs to produce estimation" << std::endl;
+    }
+    if(importanceRuns > 0) tuneImportanceBias();
 }
 
-void ProbabilityEstimation::handleRunResult(const bool decisive, int steps, double delay, unsigned int thread_id)
+// The runs of iteration k are numbered from k * importanceRuns, in a random stream apart from
+// the one of the estimation runs. The elite runs are the ones coming at least as close to the
+// query as the best SMC_CE_RHO of the iteration, weighted by their likelihood ratio. The biased
+// rate of a transition is then the weighted mean of its number of samples over their sum, and
+// its weight factor the weighted ratio of the races it won over the races it would have won
+// unbiased, which is exact for races between two transitions.
+void ProbabilityEstimation::tuneImportanceBias()
 {
-    //bool valid = (query->getQuantifier() == PF && decisive) || (query->getQuantifier() == PG && !decisive);
-    for(int i = 0 ; i < watch_aggrs.size() ; i++) {
-        Watch* w = &watchs[i][thread_id];
-        w->close();
-        watch_aggrs[i].new_watch(w);
-        w->reset();
-    }
-    if(decisive) {
-        validRuns++;
-        validRunsTime += delay;
-        validRunsSteps += steps;
-        if(validPerStep.size() <= steps) {
-            validPerStep.resize(steps + 1, 0);
+    size_t n_transitions = tapn.getTransitions().size();
+    SMCRunGenerator::ImportanceBias bias;
+    bias.rates.assign(n_transitions, 1);
+    bias.weights.assign(n_transitions, 1);
+    SMCRunGenerator tuner(tapn, options.getSMCNumericPrecision());
+    tuner.setSeed(options.getSmcSeed());
+    tuner.setEngine(randomEngine());
+    tuner.recordImportance = true;
+    clockValue timeBound = toClock(smcSettings.timeBound, options.getSMCNumericPrecision());
+    std::vector<int> distances(importanceRuns);
+    std::vector<double> likelihoods(importanceRuns);
+    std::vector<SMCRunGenerator::ImportanceStatistics> statistics(importanceRuns);
+    std::cout << "Tuning importance sampling with " << importanceRuns << " runs per iteration" << std::endl;
+    int bestLevel = std::numeric_limits<int>::max();
+    unsigned int stalls = 0;
+    for(unsigned int iteration = 0 ; iteration < SMC_CE_MAX_ITERATIONS ; iteration++) {
+        tuner.setImportanceBias(bias);
+        tuner.prepare(&initialMarking);
+        for(unsigned int i = 0 ; i < importanceRuns ; i++) {
+            tuner.reset((uint64_t) iteration * importanceRuns + i, 1);
+            RealMarking* marking = tuner.getMarking();
+            int closest = std::numeric_limits<int>::max();
+            while(!tuner.reachedEnd() && !reachedRunBound(timeBound, smcSettings.stepBound, &tuner)) {
+                QueryDistanceVisitor<RealMarking> visitor(*marking, tapn);
+                AST::IntResult distance;
+                query->accept(visitor, distance);
+                closest = std::min(closest, distance.value);
+                if(closest == 0) break;
+                marking = tuner.next();
+            }
+            distances[i] = closest;
+            likelihoods[i] = tuner.getLikelihoodRatio();
+            statistics[i] = tuner.getImportanceStatistics();
+        }
+        tuningRuns += importanceRuns;
+        std::vector<int> sorted = distances;
+        size_t eliteIndex = std::min((size_t) ceil(SMC_CE_RHO * importanceRuns), sorted.size()) - 1;
+        std::nth_element(sorted.begin(), sorted.begin() + eliteIndex, sorted.end());
+        int level = sorted[eliteIndex];
+        std::vector<double> samples(n_transitions, 0), sampleSums(n_transitions, 0);
+        std::vector<double> chosen(n_transitions, 0), expected(n_transitions, 0);
+        for(unsigned int i = 0 ; i < importanceRuns ; i++) {
+            if(distances[i] > level) continue;
+            for(size_t t = 0 ; t < n_transitions ; t++) {
+                samples[t] += likelihoods[i] * statistics[i].samples[t];
+                sampleSums[t] += likelihoods[i] * statistics[i].sampleSums[t];
+                chosen[t] += likelihoods[i] * statistics[i].chosen[t];
+                expected[t] += likelihoods[i] * statistics[i].expected[t];
+            }
         }
-        validPerStep[steps] += 1;
-        validPerDelay.push_back(delay);
-        if(delay > maxValidDuration) {
-            maxValidDuration = delay;
+        for(size_t t = 0 ; t < n_transitions ; t++) {
+            const SMC::Distribution& distribution = tapn.getTransitions()[t]->getDistribution();
+            if(distribution.type == SMC::Exponential && samples[t] > 0 && sampleSums[t] > 0) {
+                double factor = (samples[t] / sampleSums[t]) / distribution.parameters.exp.rate;
+                bias.rates[t] = std::clamp(factor, SMC_CE_MIN_FACTOR, SMC_CE_MAX_FACTOR);
+            }
+            if(expected[t] > 0) {
+                bias.weights[t] = std::clamp(chosen[t] / expected[t], SMC_CE_MIN_FACTOR, SMC_CE_MAX_FACTOR);
+            }
         }
+        std::cout << ". Cross-entropy iteration " << (iteration + 1) << " : elite distance " << level << std::endl;
+        if(level == 0) break;
+        stalls = level < bestLevel ? 0 : stalls + 1;
+        bestLevel = std::min(bestLevel, level);
+        if(stalls >= SMC_CE_MAX_STALLS) break;
+    }
+    runGenerator.setImportanceBias(bias);
+}
+
+void ProbabilityEstimation::initRunsResults(unsigned int n_threads)
+{
+    threadOutcomes = std::vector<std::vector<RunOutcome>>(n_threads);
+    pendingOutcomes.clear();
+    runsCommitted = 0;
+    committedRuns = 0;
+    committedTime = 0;
+    committedSteps = 0;
+    committedValidRuns = 0;
+    decided = runsNeeded == 0;
+    mergedStats = RunsStatistics();
+    precisionReached = false;
+    checks = 0;
+    nextCheck = SMC_SEQUENTIAL_FIRST_CHECK;
+    threadLikelihoods.assign(n_threads, 1);
+}
+
+bool ProbabilityEstimation::executeRun(SMCRunGenerator* generator)
+{
+    if(generator == nullptr) generator = &runGenerator;
+    bool runRes = SMCVerification::executeRun(generator);
+    if(importanceRuns > 0) threadLikelihoods[generator->_thread_id] = generator->getLikelihoodRatio();
+    return runRes;
+}
+
+void ProbabilityEstimation::mergeRunResults(unsigned int thread_id)
+{
+    for(RunOutcome& outcome : threadOutcomes[thread_id]) {
+        pendingOutcomes.push(outcome.run, std::move(outcome));
+    }
+    threadOutcomes[thread_id].clear();
+    RunOutcome outcome;
+    while(!decided && pendingOutcomes.pop(outcome)) {
+        commitRun(outcome);
+    }
+    runsCommitted = pendingOutcomes.next();
+}
+
+void ProbabilityEstimation::discardRunResults(unsigned int thread_id)
+{
+    threadOutcomes[thread_id].clear();
+}
+
+// The precision is checked on the runs committed, so the estimation stops after the same runs
+// whatever the number of threads or processes
+void ProbabilityEstimation::commitRun(const RunOutcome& outcome)
+{
+    committedRuns++;
+    committedTime += outcome.delay;
+    committedSteps += outcome.steps;
+    RunsStatistics& stats = mergedStats;
+    if(outcome.decisive) {
+        committedValidRuns++;
+        stats.validDelays.add(outcome.delay);
+        stats.validSteps.add(outcome.steps);
+        stats.validDelaysSketch.add(outcome.delay);
+        if(stats.validPerStep.size() <= outcome.steps) {
+            stats.validPerStep.resize(outcome.steps + 1, 0);
+        }
+        stats.validPerStep[outcome.steps] += 1;
     } else {
-        violatingRunTime += delay;
-        violatingRunSteps += steps;
-        if(violatingPerStep.size() <= steps) {
-            violatingPerStep.resize(steps + 1, 0);
+        stats.violatingDelays.add(outcome.delay);
+        stats.violatingSteps.add(outcome.steps);
+        stats.violatingDelaysSketch.add(outcome.delay);
+    }
+    if(importanceRuns > 0) {
+        stats.weighted.add(outcome.decisive ? outcome.likelihood : 0);
+    }
+    for(size_t i = 0 ; i < outcome.watchs.size() ; i++) {
+        watch_aggrs[i].add_run(outcome.watchs[i]);
+    }
+    if(committedRuns >= runsNeeded) {
+        decided = true;
+    } else if((sequential || weightedStopping) && committedRuns >= nextCheck) {
+        decided = weightedStopping ? weightedPrecisionReached() : sequentialPrecisionReached();
+    }
+}
+
+void ProbabilityEstimation::handleRunResult(const bool decisive, int steps, double delay, uint64_t run, unsigned int thread_id)
+{
+    //bool valid = (query->getQuantifier() == PF && decisive) || (query->getQuantifier() == PG && !decisive);
+    RunOutcome outcome { run, decisive, steps, delay, threadLikelihoods[thread_id] };
+    outcome.watchs.resize(watchs.size());
+    for(size_t i = 0 ; i < watchs.size() ; i++) {
+        watchs[i][thread_id].take(outcome.watchs[i]);
+    }
+    threadOutcomes[thread_id].push_back(std::move(outcome));
+}
+
+void ProbabilityEstimation::writeRunResults(Util::PartialWriter& out, unsigned int thread_id)
+{
+    std::vector<RunOutcome>& outcomes = threadOutcomes[thread_id];
+    out.putUnsigned(outcomes.size());
+    for(const RunOutcome& outcome : outcomes) {
+        out.putUnsigned(outcome.run);
+        out.putUnsigned(outcome.decisive);
+        out.putSigned(outcome.steps);
+        out.putDouble(outcome.delay);
+        out.putDouble(outcome.likelihood);
+        for(const TAPN::WatchRun& watch : outcome.watchs) {
+            watch.write(out);
         }
-        violatingPerStep[steps] += 1;
-        violatingPerDelay.push_back(delay);
     }
+    outcomes.clear();
 }
 
-bool ProbabilityEstimation::handleSuccessor(RealMarking* marking) {
-    QueryVisitor<RealMarking> checker(*marking, tapn);
-    AST::BoolResult context;
-    query->accept(checker, context);
+void ProbabilityEstimation::readRunResults(Util::PartialReader& in, unsigned int thread_id)
+{
+    std::vector<RunOutcome> outcomes(in.getSize());
+    for(RunOutcome& outcome : outcomes) {
+        outcome.run = in.getUnsigned();
+        outcome.decisive = in.getUnsigned() != 0;
+        outcome.steps = (int) in.getSigned();
+        outcome.delay = in.getDouble();
+        outcome.likelihood = in.getDouble();
+        outcome.watchs.resize(watchs.size());
+        for(TAPN::WatchRun& watch : outcome.watchs) {
+            watch.read(in);
+        }
+    }
+    if(!in.good()) return;
+    std::move(outcomes.begin(), outcomes.end(), std::back_inserter(threadOutcomes[thread_id]));
+}
+
+// Only the runs committed are reported, those past the first one missing are dropped
+void ProbabilityEstimation::finalizeRunsResults()
+{
+    SMCVerification::finalizeRunsResults();
+    numberOfRuns = committedRuns;
+    totalTime = committedTime;
+    totalSteps = committedSteps;
+    validRuns = committedValidRuns;
+    pendingOutcomes.clear();
+}
+
+bool ProbabilityEstimation::handleMarking(RealMarking& marking) {
+    bool satisfied = queryHolds(marking);
 
     for(int i = 0 ; i < watchs.size() ; i++) {
-        Watch& w = watchs[i][marking->_thread_id];
-        w.new_marking(marking, options.getSMCNumericPrecision());
+        Watch& w = watchs[i][marking._thread_id];
+        w.new_marking(&marking, options.getSMCNumericPrecision());
     }
 
-    delete marking;
+    return satisfied;
+}
+
+// Watchs and likelihood ratios are taken along the runs
+bool ProbabilityEstimation::batchable() {
+    return importanceRuns == 0 && getSmcQuery()->getObservables().empty() && options.getSmcTraces() == 0;
+}
 
-    return context.value;
+bool ProbabilityEstimation::progressEstimate(double& estimate, double& lower, double& upper) {
+    if(committedRuns == 0) return false;
+    double alpha = 1 - smcSettings.confidence;
+    if(importanceRuns > 0) {
+        if(mergedStats.weighted.count() == 0) return false;
+        double halfWidth = Util::normalQuantile(1 - alpha / 2) * mergedStats.weighted.stdDev() / sqrt(mergedStats.weighted.count());
+        estimate = mergedStats.weighted.mean();
+        lower = std::max(0.0, estimate - halfWidth);
+        upper = std::min(1.0, estimate + halfWidth);
+    } else {
+        estimate = committedValidRuns / (double) committedRuns;
+        std::tie(lower, upper) = Util::clopperPearson(committedValidRuns, committedRuns, alpha);
+    }
+    if(query->getQuantifier() == PG) {
+        estimate = 1 - estimate;
+        std::swap(lower, upper);
+        lower = 1 - lower;
+        upper = 1 - upper;
+    }
+    return true;
 }
 
 float ProbabilityEstimation::getEstimation() {
-    float proba = ((float) validRuns) / numberOfRuns;
+    float proba = importanceRuns > 0 ? mergedStats.weighted.mean() : ((float) validRuns) / numberOfRuns;
     return (query->getQuantifier() == PG) ? 1 - proba : proba;
 }
 
-void ProbabilityEstimation::computeChernoffHoeffdingBound(const float intervalWidth, const float confidence) {
+uint64_t ProbabilityEstimation::computeChernoffHoeffdingBound(const float intervalWidth, const float confidence) {
     // https://link.springer.com/content/pdf/10.1007/b94790.pdf p.78-79
     float bound = log(2.0 / (1 - confidence)) / (2.0 * pow(intervalWidth, 2));
-    runsNeeded = (unsigned int) ceil(bound);
+    return (uint64_t) ceil(bound);
 }
 
 void ProbabilityEstimation::printStats() {
     SMCVerification::printStats();
+    if(sequential) {
+        std::cout << "  Chernoff-Hoeffding bound:\t" << hoeffdingRuns << std::endl;
+        std::cout << "  runs saved by sequential estimation:\t" << (hoeffdingRuns - std::min<uint64_t>(hoeffdingRuns, numberOfRuns)) << std::endl;
+    }
+    if(importanceRuns > 0) {
+        std::cout << "  cross-entropy tuning runs:\t" << tuningRuns << std::endl;
+        std::cout << "  requested width reached by the weighted runs:\t" << (precisionReached ? "yes" : "no") << std::endl;
+        std::cout << "  weighted valid runs (std. dev.):\t" << mergedStats.weighted.stdDev() << std::endl;
+    }
     printGlobalRunsStats();
     printValidRunsStats();
     printViolatingRunsStats();
@@ -92,67 +370,44 @@ void ProbabilityEstimation::printStats() {
 void ProbabilityEstimation::printValidRunsStats() {
     std::string category = "valid";
     if(query->getQuantifier() == PF) { 
-        printRunsStats(category, validRuns, validRunsSteps, validRunsTime, validPerStep, validPerDelay);
+        printRunsStats(category, mergedStats.validDelays, mergedStats.validSteps, mergedStats.validDelaysSketch);
     } else {
-        printRunsStats(category, numberOfRuns - validRuns, violatingRunSteps, violatingRunTime, violatingPerStep, violatingPerDelay);
+        printRunsStats(category, mergedStats.violatingDelays, mergedStats.violatingSteps, mergedStats.violatingDelaysSketch);
     }
 }
 
 void ProbabilityEstimation::printViolatingRunsStats() {
     std::string category = "violating";
     if(query->getQuantifier() == PG) {
-        printRunsStats(category, validRuns, validRunsSteps, validRunsTime, validPerStep, validPerDelay);
+        printRunsStats(category, mergedStats.validDelays, mergedStats.validSteps, mergedStats.validDelaysSketch);
     } else {
-        printRunsStats(category, numberOfRuns - validRuns, violatingRunSteps, violatingRunTime, violatingPerStep, violatingPerDelay);
+        printRunsStats(category, mergedStats.violatingDelays, mergedStats.violatingSteps, mergedStats.violatingDelaysSketch);
     }
 }
 
-void ProbabilityEstimation::printRunsStats(const std::string category, uint64_t n, uint64_t totalSteps, double totalDelay, std::vector<uint64_t> perStep, std::vector<float> perDelay) {
-    if(n == 0) {
+void ProbabilityEstimation::printRunsStats(const std::string category, const Util::RunningStats& delays, const Util::RunningStats& steps, const Util::LogHistogram& delaysSketch) {
+    if(delays.count() == 0) {
         std::cout << "  no " + category + " runs, unable to compute specific statistics" << std::endl;
         return;
     }
-    double stepsMean = (totalSteps / (double) n);
-    double timeMean = (totalDelay / n);
-    double stepsAcc = 0;
-    double delayAcc = 0;
-    for(int i = 0 ; i < perStep.size() ; i++) {
-        stepsAcc += pow(i - stepsMean, 2.0) * perStep[i];
-    }
-    for(int i = 0 ; i < perDelay.size() ; i++) {
-        delayAcc += pow(perDelay[i] - timeMean, 2.0);
-    }
-    double stepsStdDev = sqrt( stepsAcc / n );
-    double delayStdDev = sqrt( delayAcc / n );
     std::cout << "  statistics of " + category + " runs:" << std::endl;
-    std::cout << "    number of " << category << " runs: " << n << std::endl;
-    std::cout << "    duration of a " + category + " run (average):\t" << timeMean << std::endl;
-    std::cout << "    duration of a " + category + " run (std. dev.):\t" << delayStdDev << std::endl;
-    std::cout << "    length of a " + category + " run (average):\t" << stepsMean << std::endl;
-    std::cout << "    length of a " + category + " run (std. dev.):\t" << stepsStdDev << std::endl;
+    std::cout << "    number of " << category << " runs: " << delays.count() << std::endl;
+    std::cout << "    duration of a " + category + " run (average):\t" << delays.mean() << std::endl;
+    std::cout << "    duration of a " + category + " run (std. dev.):\t" << delays.stdDev() << std::endl;
+    std::cout << "    duration of a " + category + " run (median):\t" << delaysSketch.quantile(0.5) << std::endl;
+    std::cout << "    duration of a " + category + " run (90th percentile):\t" << delaysSketch.quantile(0.9) << std::endl;
+    std::cout << "    duration of a " + category + " run (99th percentile):\t" << delaysSketch.quantile(0.99) << std::endl;
+    std::cout << "    length of a " + category + " run (average):\t" << steps.mean() << std::endl;
+    std::cout << "    length of a " + category + " run (std. dev.):\t" << steps.stdDev() << std::endl;
 }
 
 void ProbabilityEstimation::printGlobalRunsStats() {
-    double stepsMean = (totalSteps / (double) numberOfRuns);
-    double timeMean = (totalTime / numberOfRuns);
-    double stepsAcc = 0;
-    double delayAcc = 0;
-    for(int i = 0 ; i < validPerStep.size() ; i++) {
-        stepsAcc += pow(i - stepsMean, 2.0) * validPerStep[i];
-    }
-    for(int i = 0 ; i < violatingPerStep.size() ; i++) {
-        stepsAcc += pow(i - stepsMean, 2.0) * violatingPerStep[i];
-    }
-    for(int i = 0 ; i < validPerDelay.size() ; i++) {
-        delayAcc += pow(validPerDelay[i] - timeMean, 2.0);
-    }
-    for(int i = 0 ; i < violatingPerDelay.size() ; i++) {
-        delayAcc += pow(violatingPerDelay[i] - timeMean, 2.0);
-    }
-    double stepsStdDev = sqrt( stepsAcc / numberOfRuns );
-    double delayStdDev = sqrt( delayAcc / numberOfRuns );
-    std::cout << "  run duration (std. dev.):\t" << delayStdDev << std::endl;
-    std::cout << "  run length (std. dev.):\t" << stepsStdDev << std::endl;
+    Util::RunningStats delays = mergedStats.validDelays;
+    delays.merge(mergedStats.violatingDelays);
+    Util::RunningStats steps = mergedStats.validSteps;
+    steps.merge(mergedStats.violatingSteps);
+    std::cout << "  run duration (std. dev.):\t" << delays.stdDev() << std::endl;
+    std::cout << "  run length (std. dev.):\t" << steps.stdDev() << std::endl;
 }
 
 void ProbabilityEstimation::printCumulativeStats() {
@@ -164,6 +419,7 @@ void ProbabilityEstimation::printCumulativeStats() {
     double fact = (query->getQuantifier() == PF) ? 1 : -1;
     double initial = (query->getQuantifier() == PF) ? 0 : 1;
 
+    const std::vector<uint64_t>& validPerStep = mergedStats.validPerStep;
     std::cout << "  cumulative probability / step :" << std::endl;
     double acc = initial;
     double binSize = stepScale == 0 ? 1 : validPerStep.size() / (double) stepScale;
@@ -190,16 +446,16 @@ void ProbabilityEstimation::printCumulativeStats() {
 
     std::cout << "  cumulative probability / delay :" << std::endl;
     acc = initial;
+    double maxValidDuration = validRuns > 0 ? mergedStats.validDelaysSketch.max() : 0.0;
     binSize = timeScale == 0 ? 1 : (maxValidDuration / (double) timeScale);
     std::vector<double> bins(
         binSize > 0 ? (size_t) round(maxValidDuration / binSize) : 1
         , 0.0f);
     lastAcc = acc;
-    for(int i = 0 ; i < validPerDelay.size() ; i++) {
-        double delay = validPerDelay[i];
+    mergedStats.validDelaysSketch.forEach([&](double delay, uint64_t count) {
         int binIndex = std::min((size_t) round(delay / binSize), bins.size() - 1);
-        bins[binIndex] += 1;
-    }
+        bins[binIndex] += count;
+    });
     std::cout << 0 << ":" << acc << ";";
     for(int i = 0 ; i < bins.size() ; i++) {
         acc += fact * (bins[i] / (double) numberOfRuns);
@@ -221,7 +477,7 @@ void ProbabilityEstimation::printCumulativeStats() {
 void ProbabilityEstimation::printWatchStats() {
     auto& obs = getSmcQuery()->getObservables();
     for(int i = 0 ; i < obs.size() ; i++) {
-        watch_aggrs[i].aggregate(options.getObsStatsScale(), options.getObsStatsScale());
+        watch_aggrs[i].aggregate();
         std::string plot = watch_aggrs[i].get_plots(std::get<0>(obs[i]));
         std::cout << plot;
         watch_aggrs[i].reset();
@@ -234,11 +490,45 @@ void ProbabilityEstimation::printResult() {
     } else {
         printHumanTrace(m, printStack, query->getQuantifier());
     }*/
+    if(interrupted) {
+        printInterruptedResult();
+        return;
+    }
     float result = getEstimation();
     float width = smcSettings.estimationIntervalWidth;
+    if(importanceRuns > 0) {
+        std::cout << "Probability estimation by importance sampling:" << std::endl;
+        std::cout << "\tConfidence: " << smcSettings.confidence * 100 << "%" << std::endl;
+        if(precisionReached) {
+            std::cout << "\tP = " << result << " ± " << width << std::endl;
+            return;
+        }
+        // The cap of the runs came first, the normal interval they reached is reported
+        double z = Util::normalQuantile(1 - (1 - smcSettings.confidence) / 2);
+        double stdError = numberOfRuns > 0 ? mergedStats.weighted.stdDev() / sqrt(numberOfRuns) : 0;
+        std::cout << "\tP = " << result << " ± " << z * stdError << std::endl;
+        return;
+    }
     std::cout << "Probability estimation:" << std::endl;
     std::cout << "\tConfidence: " << smcSettings.confidence * 100 << "%" << std::endl;
     std::cout << "\tP = " << result << " ± " << width << std::endl;
 }
 
+// The interval achieved by the runs committed before the time budget ran out, the first ones in
+// the order of their indexes : the runs completed past a missing one are dropped, as they would
+// favour the short runs. It is the interval the progress stream reports, printed by its largest
+// distance to the estimate
+void ProbabilityEstimation::printInterruptedResult() {
+    std::cout << "Probability estimation" << (importanceRuns > 0 ? " by importance sampling" : "") << ":" << std::endl;
+    std::cout << "\tInterrupted after the first " << numberOfRuns << " runs, of the " << runsNeeded << " needed" << std::endl;
+    double estimate, lower, upper;
+    if(!progressEstimate(estimate, lower, upper)) {
+        std::cout << "\tNo run completed, no estimation" << std::endl;
+        return;
+    }
+    std::cout << "\tConfidence: " << smcSettings.confidence * 100 << "%" << std::endl;
+    std::cout << "\tP = " << estimate << " ± " << std::max(upper - estimate, estimate - lower) << std::endl;
+    std::cout << "\tInterval: [" << lower << "," << upper << "]" << std::endl;
+}
+
 }
@@ -1,7 +1,8 @@
 #include "DiscreteVerification/VerificationTypes/ProbabilityFloatComparison.hpp"
-#include "DiscreteVerification/QueryVisitor.hpp"
+#include "DiscreteVerification/Util/BinomialInterval.hpp"
 
 #include <iostream>
+#include <tuple>
 
 namespace VerifyTAPN::DiscreteVerification {
 
@@ -14,34 +15,102 @@ ProbabilityFloatComparison::ProbabilityFloatComparison(
     computeIndifferenceRegion(smcSettings.geqThan, smcSettings.indifferenceRegionUp, smcSettings.indifferenceRegionDown);
 }
 
-void ProbabilityFloatComparison::handleRunResult(const bool res, int steps, double delay, unsigned int thread_id) {
+void ProbabilityFloatComparison::initRunsResults(unsigned int n_threads) {
+    threadOutcomes = std::vector<std::vector<RunOutcome>>(n_threads);
+    pendingOutcomes.clear();
+    runsCommitted = 0;
+    committedRuns = 0;
+    committedTime = 0;
+    committedSteps = 0;
+    decided = false;
+}
+
+void ProbabilityFloatComparison::handleRunResult(const bool res, int steps, double delay, uint64_t run, unsigned int thread_id) {
     bool valid = query->getQuantifier() == PG ? !res : res;
-    if(p0 >= 1.0f && !valid) {
-        ratio = std::numeric_limits<float>::infinity();
-    } else {
-        ratio += valid ? log(p1 / p0) : log((1 - p1) / (1 - p0));
+    threadOutcomes[thread_id].push_back({ run, valid, steps, delay });
+}
+
+void ProbabilityFloatComparison::writeRunResults(Util::PartialWriter& out, unsigned int thread_id) {
+    std::vector<RunOutcome>& outcomes = threadOutcomes[thread_id];
+    out.putUnsigned(outcomes.size());
+    for(const RunOutcome& outcome : outcomes) {
+        out.putUnsigned(outcome.run);
+        out.putUnsigned(outcome.valid);
+        out.putSigned(outcome.steps);
+        out.putDouble(outcome.delay);
     }
-    validRuns += (int) valid;
+    outcomes.clear();
 }
 
-bool ProbabilityFloatComparison::handleSuccessor(RealMarking* marking) {
-    QueryVisitor<RealMarking> checker(*marking, tapn);
-    AST::BoolResult context;
-    query->accept(checker, context);
+void ProbabilityFloatComparison::readRunResults(Util::PartialReader& in, unsigned int thread_id) {
+    std::vector<RunOutcome> outcomes(in.getSize());
+    for(RunOutcome& outcome : outcomes) {
+        outcome.run = in.getUnsigned();
+        outcome.valid = in.getUnsigned() != 0;
+        outcome.steps = (int) in.getSigned();
+        outcome.delay = in.getDouble();
+    }
+    if(!in.good()) return;
+    threadOutcomes[thread_id].insert(threadOutcomes[thread_id].end(), outcomes.begin(), outcomes.end());
+}
 
-    delete marking;
+void ProbabilityFloatComparison::mergeRunResults(unsigned int thread_id) {
+    for(const RunOutcome& outcome : threadOutcomes[thread_id]) {
+        pendingOutcomes.push(outcome.run, outcome);
+    }
+    threadOutcomes[thread_id].clear();
+    RunOutcome outcome;
+    while(!decided && pendingOutcomes.pop(outcome)) {
+        committedTime += outcome.delay;
+        committedSteps += outcome.steps;
+        commitRun(outcome.valid);
+    }
+    runsCommitted = pendingOutcomes.next();
+}
 
-    return context.value;
+void ProbabilityFloatComparison::discardRunResults(unsigned int thread_id) {
+    threadOutcomes[thread_id].clear();
 }
 
-bool ProbabilityFloatComparison::mustDoAnotherRun() {
+void ProbabilityFloatComparison::commitRun(bool valid) {
+    if(p0 >= 1.0f && !valid) {
+        ratio = std::numeric_limits<float>::infinity();
+    } else {
+        ratio += valid ? log(p1 / p0) : log((1 - p1) / (1 - p0));
+    }
+    validRuns += (int) valid;
+    committedRuns++;
     if(ratio <= boundH0) {
         result = true;
-        return false;
+        decided = true;
     } else if(ratio >= boundH1) {
         result = false;
-        return false;
+        decided = true;
     }
+}
+
+// Only the runs that took part in the decision are reported
+void ProbabilityFloatComparison::finalizeRunsResults() {
+    SMCVerification::finalizeRunsResults();
+    numberOfRuns = committedRuns;
+    totalTime = committedTime;
+    totalSteps = committedSteps;
+    pendingOutcomes.clear();
+}
+
+bool ProbabilityFloatComparison::handleMarking(RealMarking& marking) {
+    return queryHolds(marking);
+}
+
+bool ProbabilityFloatComparison::mustDoAnotherRun() {
+    return !decided;
+}
+
+// Estimate of the runs committed to the test so far, the outcomes are already valid for PG
+bool ProbabilityFloatComparison::progressEstimate(double& estimate, double& lower, double& upper) {
+    if(committedRuns == 0) return false;
+    estimate = validRuns / (double) committedRuns;
+    std::tie(lower, upper) = Util::clopperPearson(validRuns, committedRuns, 1 - smcSettings.confidence);
     return true;
 }
 
@@ -76,6 +145,11 @@ void ProbabilityFloatComparison::printResult() {
     std::cout << "\tIndifference region: [" << p1 << "," << p0 << "]" << std::endl;
     std::cout << "\tFalse positives: " << smcSettings.falsePositives << std::endl;
     std::cout << "\tFalse negatives: " << smcSettings.falseNegatives << std::endl;
+    if(!decided) {
+        // Stopped by the time budget, the runs committed so far are too few to accept or reject
+        std::cout << "\tHypothesis is undecided after " << committedRuns << " runs" << std::endl;
+        return;
+    }
 	std::cout << (result ? "\tHypothesis is satisfied" : "\tHypothesis is NOT satisfied") << std::endl;
 }
 
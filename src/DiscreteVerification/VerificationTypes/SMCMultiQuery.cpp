@@ -0,0 +1,204 @@
+#include "DiscreteVerification/VerificationTypes/SMCMultiQuery.hpp"
+#include "DiscreteVerification/VerificationTypes/ProbabilityEstimation.hpp"
+#include "DiscreteVerification/VerificationTypes/ProbabilityFloatComparison.hpp"
+
+#include <iostream>
+#include <algorithm>
+
+namespace VerifyTAPN::DiscreteVerification {
+
+using Util::clockToDouble;
+
+SMCMultiQuery::SMCMultiQuery(
+    TAPN::TimedArcPetriNet &tapn, RealMarking &initialMarking, const std::vector<AST::SMCQuery*>& queries,
+    const std::vector<std::string>& names, VerificationOptions options
+) : SMCVerification(tapn, initialMarking, queries.front(), options), names(names)
+{
+    unsigned int precision = options.getSMCNumericPrecision();
+    // The shared runs are not biased
+    options.setImportanceSamplingRuns(0);
+    for(AST::SMCQuery* query : queries) {
+        const SMCSettings& settings = query->getSmcSettings();
+        if(options.isBenchmarkMode()) {
+            verifiers.push_back(std::make_unique<ProbabilityEstimation>(tapn, initialMarking, query, options, options.getBenchmarkRuns()));
+        } else if(settings.compareToFloat) {
+            verifiers.push_back(std::make_unique<ProbabilityFloatComparison>(tapn, initialMarking, query, options));
+        } else {
+            verifiers.push_back(std::make_unique<ProbabilityEstimation>(tapn, initialMarking, query, options));
+        }
+        timeBounds.push_back(toClock(settings.timeBound, precision));
+        stepBounds.push_back(settings.stepBound);
+        // The shared runs are simulated up to the largest bounds
+        smcSettings.timeBound = std::max(smcSettings.timeBound, settings.timeBound);
+        smcSettings.stepBound = std::max(smcSettings.stepBound, settings.stepBound);
+    }
+    decided = std::make_unique<std::atomic<bool>[]>(verifiers.size());
+}
+
+void SMCMultiQuery::prepare() {
+    // Every query would need its own traces
+    options.setSmcTraces(0);
+    for(auto& verifier : verifiers) {
+        verifier->prepare();
+    }
+}
+
+bool SMCMultiQuery::executeRun(SMCRunGenerator* generator) {
+    if(generator == nullptr) generator = &runGenerator;
+    std::vector<QueryRun>& current = threadRuns[generator->_thread_id];
+    uint64_t run = generator->getRunIndex();
+    for(size_t i = 0 ; i < verifiers.size() ; i++) {
+        current[i] = QueryRun();
+        current[i].active = !decided[i].load(std::memory_order_relaxed) && run < verifiers[i]->runsBudget();
+        current[i].pending = current[i].active;
+    }
+    RealMarking* marking = generator->getMarking();
+    while(!generator->reachedEnd()) {
+        if(stopRequested.load(std::memory_order_relaxed)) break;
+        for(size_t i = 0 ; i < verifiers.size() ; i++) {
+            if(current[i].pending && reachedRunBound(timeBounds[i], stepBounds[i], generator)) {
+                current[i].pending = false;
+            }
+        }
+        marking->_thread_id = generator->_thread_id;
+        if(handleMarking(*marking)) break;
+        marking = generator->next();
+    }
+    bool runRes = false;
+    unsigned int precision = options.getSMCNumericPrecision();
+    for(size_t i = 0 ; i < verifiers.size() ; i++) {
+        if(!current[i].active) continue;
+        current[i].steps = std::min(generator->getRunSteps(), stepBounds[i]);
+        current[i].delay = clockToDouble(std::min(generator->getRunDelay(), timeBounds[i]), precision);
+        runRes |= current[i].res;
+    }
+    return runRes;
+}
+
+bool SMCMultiQuery::handleMarking(RealMarking& marking) {
+    std::vector<QueryRun>& current = threadRuns[marking._thread_id];
+    bool done = true;
+    for(size_t i = 0 ; i < verifiers.size() ; i++) {
+        if(!current[i].pending) continue;
+        if(verifiers[i]->handleMarking(marking)) {
+            current[i].res = true;
+            current[i].pending = false;
+        } else {
+            done = false;
+        }
+    }
+    return done;
+}
+
+// The length of the run is recorded by executeRun, against the bounds of each query
+void SMCMultiQuery::handleRunResult(const bool res, int steps, double delay, uint64_t run, unsigned int thread_id) {
+    std::vector<QueryRun>& current = threadRuns[thread_id];
+    for(size_t i = 0 ; i < verifiers.size() ; i++) {
+        if(!current[i].active || decided[i].load(std::memory_order_relaxed)) continue;
+        verifiers[i]->handleRunResult(current[i].res, current[i].steps, current[i].delay, run, thread_id);
+        RunsAccumulator& acc = threadAccs[thread_id][i];
+        acc.time += current[i].delay;
+        acc.steps += current[i].steps;
+        acc.runs++;
+    }
+}
+
+bool SMCMultiQuery::mustDoAnotherRun() {
+    for(size_t i = 0 ; i < verifiers.size() ; i++) {
+        if(!decided[i]) return true;
+    }
+    return false;
+}
+
+// Only the queries still undecided need more runs
+uint64_t SMCMultiQuery::runsBudget() const {
+    uint64_t budget = 0;
+    for(size_t i = 0 ; i < verifiers.size() ; i++) {
+        if(decided[i].load(std::memory_order_relaxed)) continue;
+        budget = std::max(budget, verifiers[i]->runsBudget());
+    }
+    return budget;
+}
+
+void SMCMultiQuery::initRunsResults(unsigned int n_threads) {
+    threadRuns = std::vector<std::vector<QueryRun>>(n_threads, std::vector<QueryRun>(verifiers.size()));
+    threadAccs = std::vector<std::vector<RunsAccumulator>>(n_threads, std::vector<RunsAccumulator>(verifiers.size()));
+    for(size_t i = 0 ; i < verifiers.size() ; i++) {
+        decided[i] = false;
+        verifiers[i]->initRunsResults(n_threads);
+    }
+    updateRunsCommitted();
+}
+
+// Each verifier is merged as its own mergeEpoch would do it
+void SMCMultiQuery::mergeRunResults(unsigned int thread_id) {
+    for(size_t i = 0 ; i < verifiers.size() ; i++) {
+        SMCVerification& verifier = *verifiers[i];
+        RunsAccumulator& acc = threadAccs[thread_id][i];
+        // What this thread simulated for a query before another one decided it is dropped
+        if(decided[i]) {
+            verifier.discardRunResults(thread_id);
+            acc = RunsAccumulator();
+            continue;
+        }
+        verifier.totalTime += acc.time;
+        verifier.totalSteps += acc.steps;
+        verifier.numberOfRuns += acc.runs;
+        acc = RunsAccumulator();
+        verifier.mergeRunResults(thread_id);
+        if(!verifier.mustDoAnotherRun()) {
+            decided[i] = true;
+        }
+    }
+    updateRunsCommitted();
+}
+
+// The shared runs are held back by the undecided query committing them the slowest
+void SMCMultiQuery::updateRunsCommitted() {
+    uint64_t committed = std::numeric_limits<uint64_t>::max();
+    for(size_t i = 0 ; i < verifiers.size() ; i++) {
+        if(decided[i]) continue;
+        committed = std::min(committed, verifiers[i]->runsCommitted.load(std::memory_order_relaxed));
+    }
+    runsCommitted = committed;
+}
+
+void SMCMultiQuery::discardRunResults(unsigned int thread_id) {
+    for(size_t i = 0 ; i < verifiers.size() ; i++) {
+        verifiers[i]->discardRunResults(thread_id);
+        threadAccs[thread_id][i] = RunsAccumulator();
+    }
+}
+
+void SMCMultiQuery::finalizeRunsResults() {
+    SMCVerification::finalizeRunsResults();
+    for(size_t i = 0 ; i < verifiers.size() ; i++) {
+        verifiers[i]->interrupted = interrupted && !decided[i];
+        verifiers[i]->finalizeRunsResults();
+    }
+}
+
+void SMCMultiQuery::initWatchs(unsigned int n_threads) {
+    for(auto& verifier : verifiers) {
+        verifier->initWatchs(n_threads);
+    }
+}
+
+void SMCMultiQuery::printStats() {
+    SMCVerification::printStats();
+    for(size_t i = 0 ; i < verifiers.size() ; i++) {
+        verifiers[i]->durationNs = durationNs;
+        verifiers[i]->allocations = allocations;
+        std::cout << names[i] << ":" << std::endl;
+        verifiers[i]->printStats();
+    }
+}
+
+void SMCMultiQuery::printResult() {
+    for(size_t i = 0 ; i < verifiers.size() ; i++) {
+        std::cout << names[i] << ":" << std::endl;
+        verifiers[i]->printResult();
+    }
+}
+
+}
@@ -1,5 +1,4 @@
 #include "DiscreteVerification/VerificationTypes/SMCTracesGenerator.hpp"
-#include "DiscreteVerification/QueryVisitor.hpp"
 
 #include <math.h>
 
@@ -16,23 +15,20 @@ bool SMCTracesGenerator::mustDoAnotherRun() {
     return mustSaveTrace();
 }
 
-void SMCTracesGenerator::handleRunResult(const bool res, int steps, double delay, unsigned int thread_id)
+void SMCTracesGenerator::handleRunResult(const bool res, int steps, double delay, uint64_t run, unsigned int thread_id)
 {
     
 }
 
-bool SMCTracesGenerator::handleSuccessor(RealMarking* marking) {
-    QueryVisitor<RealMarking> checker(*marking, tapn);
-    AST::BoolResult context;
-    query->accept(checker, context);
+bool SMCTracesGenerator::handleMarking(RealMarking& marking) {
+    bool satisfied = queryHolds(marking);
 
     for(int i = 0 ; i < watchs.size() ; i++) {
-        Watch& w = watchs[i][marking->_thread_id];
-        w.new_marking(marking, options.getSMCNumericPrecision());
+        Watch& w = watchs[i][marking._thread_id];
+        w.new_marking(&marking, options.getSMCNumericPrecision());
     }
 
-    delete marking;
-    return context.value;
+    return satisfied;
 }
 
 void SMCTracesGenerator::printResult() {
@@ -1,13 +1,20 @@
 #include "DiscreteVerification/VerificationTypes/SMCVerification.hpp"
 #include "DiscreteVerification/Util/ClockValue.hpp"
+#include "DiscreteVerification/Util/AllocationCounter.hpp"
 
 #include <thread>
 #include <sstream>
 #include <chrono>
 #include <iomanip>
 #include <algorithm>
+#include <fstream>
 
 #define STEP_MS 5000
+// A worker folds its results into the shared state after this many runs or milliseconds
+#define SMC_EPOCH_RUNS 64
+#define SMC_EPOCH_MS 20
+// Runs claimed at most past the oldest one not committed, by the verifications committing runs in order
+#define SMC_REORDER_WINDOW 16384
 
 using VerifyTAPN::DiscreteVerification::Util::clockValue;
 using VerifyTAPN::DiscreteVerification::Util::clockToDouble;
@@ -23,48 +30,82 @@ std::string printDouble(clockValue value, unsigned int precision) {
 namespace VerifyTAPN::DiscreteVerification {
 
 bool SMCVerification::parallel_run() {
+    if(batchLanes() > 0) {
+        unsigned int n_threads = options.getSmcThreads();
+        if(n_threads == 0) n_threads = Util::availableCores();
+        return batch_run(n_threads);
+    }
     prepare();
     runGenerator.prepare(&initialMarking);
     runGenerator.recordTrace = mustSaveTrace();
     auto start = std::chrono::steady_clock::now();
 
-    size_t n_threads = std::thread::hardware_concurrency();
+    unsigned int n_threads = prepareWorkers();
     std::cout << ". Using " << n_threads << " threads..." << std::endl;
     initWatchs(n_threads);
+    initRunsResults(n_threads);
+    startProgress(n_threads);
+    runsClaimed = 0;
+    stopRequested = false;
+    startTimeBudget();
 
     clockValue timeBound = toClock(smcSettings.timeBound, options.getSMCNumericPrecision());
 
-    std::vector<std::thread*> handles;
-    for(int i = 0 ; i < n_threads ; i++) {
-        auto handle = new std::thread([this, i, timeBound]() {
-            SMCRunGenerator generator = runGenerator.copy();
-            generator._thread_id = i;
-            bool continueExecution = true;
-            while(continueExecution) {
-                bool runRes = executeRun(&generator);
-                double runDuration = clockToDouble(std::min(generator.getRunDelay(), timeBound), options.getSMCNumericPrecision());
-                int runSteps = std::min(generator.getRunSteps(), smcSettings.stepBound);
-                {
-                    std::lock_guard<std::mutex> lock(run_res_mutex);
-                    totalTime += runDuration;
-                    totalSteps += runSteps;
-                    numberOfRuns++;
-                    handleRunResult(runRes, runSteps, runDuration, generator._thread_id);
-                    if(mustSaveTrace()) handleTrace(runRes, &generator);
-                    generator.recordTrace = mustSaveTrace();
-                    continueExecution = mustDoAnotherRun();
+    workers->run([this, timeBound](unsigned int thread_id) {
+        SMCRunGenerator& generator = *workerGenerators[thread_id];
+        uint64_t startAllocations = Util::threadAllocations();
+        RunsAccumulator acc;
+        auto epochStart = std::chrono::steady_clock::now();
+        uint64_t run;
+        bool deferred;
+        while(true) {
+            if(!claimRun(run, deferred)) {
+                if(!deferred) break;
+                // The run waited for may be one of this epoch
+                if(acc.runs > 0) {
+                    acc.busy = std::chrono::duration<double>(std::chrono::steady_clock::now() - epochStart).count();
+                    if(!mergeEpoch(acc, generator._thread_id)) break;
+                    epochStart = std::chrono::steady_clock::now();
                 }
-                generator.reset();
+                std::this_thread::yield();
+                continue;
             }
-            std::lock_guard<std::mutex> lock(run_res_mutex);
-            runGenerator.mergeStatistics(generator);
-        });
-        handles.push_back(handle);
-    }
-    for(int i = 0 ; i < n_threads ; i++) {
-        handles[i]->join();
-        delete handles[i];
-    }
+            generator.reset(run);
+            bool runRes = executeRun(&generator);
+            // Runs left unfinished once the verification is decided, or out of time, are dropped
+            if(stopRequested.load(std::memory_order_relaxed)) break;
+            double runDuration = clockToDouble(std::min(generator.getRunDelay(), timeBound), options.getSMCNumericPrecision());
+            int runSteps = std::min(generator.getRunSteps(), smcSettings.stepBound);
+            acc.time += runDuration;
+            acc.steps += runSteps;
+            acc.runs++;
+            handleRunResult(runRes, runSteps, runDuration, run, generator._thread_id);
+            bool endEpoch = acc.runs >= SMC_EPOCH_RUNS;
+            if(generator.recordTrace) {
+                std::lock_guard<std::mutex> lock(run_res_mutex);
+                if(mustSaveTrace()) handleTrace(runRes, &generator);
+                generator.recordTrace = mustSaveTrace();
+                endEpoch = true;
+            }
+            if(!endEpoch) {
+                auto now = std::chrono::steady_clock::now();
+                endEpoch = std::chrono::duration_cast<std::chrono::milliseconds>(now - epochStart).count() >= SMC_EPOCH_MS;
+            }
+            if(endEpoch) {
+                acc.busy = std::chrono::duration<double>(std::chrono::steady_clock::now() - epochStart).count();
+                if(!mergeEpoch(acc, generator._thread_id)) break;
+                epochStart = std::chrono::steady_clock::now();
+            }
+        }
+        acc.busy = std::chrono::duration<double>(std::chrono::steady_clock::now() - epochStart).count();
+        mergeEpoch(acc, generator._thread_id);
+        std::lock_guard<std::mutex> lock(run_res_mutex);
+        runGenerator.mergeStatistics(generator);
+        allocations += Util::threadAllocations() - startAllocations;
+    });
+    stopTimeBudget();
+    finalizeRunsResults();
+    reportProgress(true);
 
     auto stop = std::chrono::steady_clock::now();
     durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
@@ -72,30 +113,118 @@ bool SMCVerification::parallel_run() {
     return true;
 }
 
+unsigned int SMCVerification::prepareWorkers() {
+    unsigned int n_threads = options.getSmcThreads();
+    if(n_threads == 0) n_threads = Util::availableCores();
+    if(workers == nullptr || workers->size() != n_threads) {
+        workers = std::make_unique<Util::WorkerPool>(n_threads);
+        workerGenerators.clear();
+    }
+    // Generators are copied once, later phases only have to reset them
+    if(workerGenerators.empty()) {
+        for(unsigned int i = 0 ; i < n_threads ; i++) {
+            workerGenerators.push_back(runGenerator.copy());
+            workerGenerators.back()->_thread_id = i;
+        }
+    }
+    for(auto& generator : workerGenerators) {
+        generator->recordTrace = runGenerator.recordTrace;
+        generator->reset();
+        generator->resetStatistics();
+    }
+    return n_threads;
+}
+
+// The window is on the indexes of all the runs : a worker process commits nothing, its
+// coordinator sends the runs it committed. A shard written to a file has no one to wait for.
+bool SMCVerification::claimRun(uint64_t& run, bool& deferred) {
+    deferred = false;
+    if(stopRequested.load(std::memory_order_relaxed)) return false;
+    uint64_t committed = runsCommitted.load(std::memory_order_relaxed);
+    bool windowed = partialOutput == nullptr || controlInput >= 0;
+    if(windowed && committed != std::numeric_limits<uint64_t>::max() &&
+        shardIndex + runsClaimed.load(std::memory_order_relaxed) * shardCount >= committed + SMC_REORDER_WINDOW) {
+        deferred = true;
+        return false;
+    }
+    run = shardIndex + runsClaimed.fetch_add(1, std::memory_order_relaxed) * shardCount;
+    return run < runsBudget();
+}
+
+bool SMCVerification::mergeEpoch(RunsAccumulator& acc, unsigned int thread_id) {
+    std::lock_guard<std::mutex> lock(run_res_mutex);
+    threadBusy[thread_id] += acc.busy;
+    // The results are frozen at the decision, the runs other threads finish later would
+    // change them
+    if(concluded) {
+        discardRunResults(thread_id);
+        acc = RunsAccumulator();
+        return false;
+    }
+    totalTime += acc.time;
+    totalSteps += acc.steps;
+    numberOfRuns += acc.runs;
+    if(partialOutput != nullptr) {
+        if(acc.runs > 0) {
+            Util::PartialWriter record("smc-epoch");
+            record.putUnsigned(acc.runs);
+            record.putDouble(acc.time);
+            record.putUnsigned(acc.steps);
+            writeRunResults(record, thread_id);
+            writePartialRecord(record);
+        }
+        acc = RunsAccumulator();
+        return !stopRequested;
+    }
+    acc = RunsAccumulator();
+    mergeRunResults(thread_id);
+    if(!mustDoAnotherRun()) {
+        concluded = true;
+        stopRequested = true;
+    }
+    reportProgress(false);
+    return !stopRequested;
+}
+
 bool SMCVerification::run() {
+    if(batchLanes() > 0) return batch_run(1);
     prepare();
     runGenerator.recordTrace = mustSaveTrace();
     runGenerator.prepare(&initialMarking);
     initWatchs();
+    initRunsResults();
+    startProgress(1);
+    stopRequested = false;
+    startTimeBudget();
+    uint64_t startAllocations = Util::threadAllocations();
     auto start = std::chrono::steady_clock::now();
     auto step1 = std::chrono::steady_clock::now();
     int64_t stepDuration;
     clockValue timeBound = toClock(smcSettings.timeBound, options.getSMCNumericPrecision());
+    bool cut = false;
     while(mustDoAnotherRun()) {
+        runGenerator.reset(numberOfRuns);
         bool runRes = executeRun();
+        // Only the time budget stops a sequential verification, the run it cuts is dropped
+        if(stopRequested.load(std::memory_order_relaxed)) {
+            cut = true;
+            break;
+        }
         double runDuration = clockToDouble(std::min(runGenerator.getRunDelay(), timeBound), options.getSMCNumericPrecision());
         int runSteps = std::min(runGenerator.getRunSteps(), smcSettings.stepBound);
-        handleRunResult(runRes, runSteps, runDuration);
+        handleRunResult(runRes, runSteps, runDuration, numberOfRuns);
         if(mustSaveTrace()) handleTrace(runRes);
         runGenerator.recordTrace = mustSaveTrace();
         
         totalTime += runDuration;
         totalSteps += runSteps;
         numberOfRuns++;
-        runGenerator.reset();
+        mergeRunResults(0);
         
         if(numberOfRuns % 100 != 0) continue;
         auto step2 = std::chrono::steady_clock::now();
+        threadBusy[0] = std::chrono::duration<double>(step2 - start).count();
+        reportProgress(false);
         stepDuration = std::chrono::duration_cast<std::chrono::milliseconds>(step2 - step1).count();
         if(stepDuration >= STEP_MS) {
             step1 = step2;
@@ -103,6 +232,521 @@ bool SMCVerification::run() {
             std::cout << ". Duration : " << stepDuration << "ms ; Runs executed : " << numberOfRuns << std::endl;
         }
     }
+    allocations += Util::threadAllocations() - startAllocations;
+    concluded = !cut;
+    stopTimeBudget();
+    finalizeRunsResults();
+    auto stop = std::chrono::steady_clock::now();
+    threadBusy[0] = std::chrono::duration<double>(stop - start).count();
+    reportProgress(true);
+    durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+    return true;
+}
+
+size_t SMCVerification::batchLanes() {
+    if(options.getSmcBatchSize() == 0) return 0;
+    if(!batchable() || !SMCBatchGenerator::supports(tapn)) {
+        std::cout << ". Batches unsupported by this verification or net, simulating one run at a time" << std::endl;
+        return 0;
+    }
+    return options.getSmcBatchSize();
+}
+
+bool SMCVerification::batch_run(unsigned int n_threads) {
+    prepare();
+    runGenerator.prepare(&initialMarking);
+    auto start = std::chrono::steady_clock::now();
+
+    size_t lanes = options.getSmcBatchSize();
+    if(n_threads > 1) std::cout << ". Using " << n_threads << " threads..." << std::endl;
+    std::cout << ". Simulating batches of " << lanes << " runs" << std::endl;
+    initWatchs(n_threads);
+    initRunsResults(n_threads);
+    startProgress(n_threads);
+    runsClaimed = 0;
+    stopRequested = false;
+    startTimeBudget();
+
+    std::vector<std::unique_ptr<SMCBatchGenerator>> batches;
+    for(unsigned int i = 0 ; i < n_threads ; i++) {
+        batches.push_back(std::make_unique<SMCBatchGenerator>(
+            tapn, *runGenerator.getMarking(), options.getSmcSeed(), randomEngine(), options.getSMCNumericPrecision(), lanes
+        ));
+    }
+    if(n_threads == 1) {
+        simulateBatches(*batches.front(), 0);
+    } else {
+        if(workers == nullptr || workers->size() != n_threads) {
+            workers = std::make_unique<Util::WorkerPool>(n_threads);
+            workerGenerators.clear();
+        }
+        workers->run([this, &batches](unsigned int thread_id) {
+            simulateBatches(*batches[thread_id], thread_id);
+        });
+    }
+    stopTimeBudget();
+    for(auto& batch : batches) {
+        runGenerator.mergeStatistics(batch->getTransitionsStatistics(), batch->getPlacesStatistics());
+    }
+    finalizeRunsResults();
+    reportProgress(true);
+
+    auto stop = std::chrono::steady_clock::now();
+    durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+
+    return true;
+}
+
+// A lane takes a new run as soon as its run ends, epochs are counted in runs as in parallel_run
+void SMCVerification::simulateBatches(SMCBatchGenerator& batch, unsigned int thread_id) {
+    clockValue timeBound = toClock(smcSettings.timeBound, options.getSMCNumericPrecision());
+    uint64_t startAllocations = Util::threadAllocations();
+    RunsAccumulator acc;
+    auto epochStart = std::chrono::steady_clock::now();
+    bool claiming = true;
+    // Runs in flight once the verification is decided, or out of time, are dropped
+    while(!stopRequested.load(std::memory_order_relaxed)) {
+        uint64_t run;
+        bool deferred = false;
+        for(size_t lane = 0 ; claiming && !deferred && lane < batch.lanes() ; lane++) {
+            if(batch.isActive(lane)) continue;
+            if(claimRun(run, deferred)) {
+                batch.start(lane, run);
+            } else {
+                claiming = deferred;
+            }
+        }
+        if(batch.activeLanes() == 0) {
+            if(!claiming) break;
+            // The run waited for may be one of this epoch
+            if(acc.runs > 0) {
+                acc.busy = std::chrono::duration<double>(std::chrono::steady_clock::now() - epochStart).count();
+                if(!mergeEpoch(acc, thread_id)) break;
+                epochStart = std::chrono::steady_clock::now();
+            }
+            std::this_thread::yield();
+            continue;
+        }
+        batch.schedule();
+        bool runsEnded = false;
+        for(size_t lane = 0 ; lane < batch.lanes() ; lane++) {
+            if(!batch.isActive(lane)) continue;
+            bool ended = batch.reachedEnd(lane) ||
+                batch.getRunDelay(lane) > timeBound ||
+                batch.getRunSteps(lane) > smcSettings.stepBound;
+            bool runRes = !ended && queryProgram.holds(batch.marking(lane), tapn);
+            if(!ended && !runRes) continue;
+            double runDuration = clockToDouble(std::min(batch.getRunDelay(lane), timeBound), options.getSMCNumericPrecision());
+            int runSteps = std::min(batch.getRunSteps(lane), smcSettings.stepBound);
+            acc.time += runDuration;
+            acc.steps += runSteps;
+            acc.runs++;
+            handleRunResult(runRes, runSteps, runDuration, batch.getRunIndex(lane), thread_id);
+            batch.stop(lane);
+            runsEnded = true;
+        }
+        batch.advance();
+        if(!runsEnded) continue;
+        auto now = std::chrono::steady_clock::now();
+        bool endEpoch = acc.runs >= SMC_EPOCH_RUNS ||
+            std::chrono::duration_cast<std::chrono::milliseconds>(now - epochStart).count() >= SMC_EPOCH_MS;
+        if(endEpoch) {
+            acc.busy = std::chrono::duration<double>(now - epochStart).count();
+            if(!mergeEpoch(acc, thread_id)) break;
+            epochStart = std::chrono::steady_clock::now();
+        }
+    }
+    acc.busy = std::chrono::duration<double>(std::chrono::steady_clock::now() - epochStart).count();
+    mergeEpoch(acc, thread_id);
+    std::lock_guard<std::mutex> lock(run_res_mutex);
+    allocations += Util::threadAllocations() - startAllocations;
+}
+
+void SMCVerification::startProgress(unsigned int n_threads) {
+    threadBusy.assign(n_threads, 0);
+    progressStart = std::chrono::steady_clock::now();
+    lastProgress = progressStart;
+    const std::string& output = options.getProgressOutput();
+    if(progress != nullptr || output.empty()) return;
+    progress = std::make_unique<Util::ProgressStream>(output);
+    if(!progress->isOpen()) {
+        std::cout << "Unable to open the progress output " << output << std::endl;
+        std::exit(1);
+    }
+}
+
+// Throughput is measured from the start of the runs, the utilization of a thread is the share
+// of that time it spent simulating, and the time left is projected from the runs budget
+void SMCVerification::reportProgress(bool done) {
+    if(progress == nullptr) return;
+    auto now = std::chrono::steady_clock::now();
+    if(!done && std::chrono::duration_cast<std::chrono::milliseconds>(now - lastProgress).count() < options.getProgressInterval()) return;
+    lastProgress = now;
+    double elapsed = std::chrono::duration<double>(now - progressStart).count();
+    double runsPerSecond = elapsed > 0 ? numberOfRuns / elapsed : 0;
+    std::vector<double> utilization(threadBusy.size(), 0);
+    for(size_t i = 0 ; i < threadBusy.size() ; i++) {
+        if(elapsed > 0) utilization[i] = std::min(1.0, threadBusy[i] / elapsed);
+    }
+    progress->field("done", done)
+        .field("elapsed", elapsed)
+        .field("runs", (uint64_t) numberOfRuns)
+        .field("runs_per_sec", runsPerSecond)
+        .field("steps_per_sec", elapsed > 0 ? totalSteps / elapsed : 0.0)
+        .field("thread_utilization", utilization);
+    double estimate, lower, upper;
+    if(progressEstimate(estimate, lower, upper)) {
+        progress->field("estimate", estimate).field("interval", std::vector<double> { lower, upper });
+    } else {
+        progress->nullField("estimate").nullField("interval");
+    }
+    uint64_t budget = runsBudget();
+    if(done) {
+        progress->field("remaining", 0.0);
+    } else if(budget != std::numeric_limits<uint64_t>::max() && runsPerSecond > 0) {
+        progress->field("remaining", (budget - std::min<uint64_t>(budget, numberOfRuns)) / runsPerSecond);
+    } else {
+        progress->nullField("remaining");
+    }
+    progress->endLine();
+}
+
+void SMCVerification::startTimeBudget() {
+    concluded = false;
+    interrupted = false;
+    if(controlInput >= 0) stopListener = std::make_unique<Util::StopListener>(controlInput, stopRequested, runsCommitted);
+    if(!options.hasSmcTimeBudget()) return;
+    timeBudget = std::make_unique<Util::TimeBudget>(options.getSmcTimeBudget(), stopRequested);
+}
+
+void SMCVerification::stopTimeBudget() {
+    stopListener.reset();
+    if(timeBudget == nullptr) return;
+    interrupted = timeBudget->expired() && !concluded;
+    timeBudget.reset();
+    if(interrupted) {
+        // The runs kept are only known once finalized, in the order of their indexes
+        std::cout << ". Stopped by the time budget or a signal" << std::endl;
+    }
+}
+
+// The workers prepare, e.g. tune importance sampling, each on their own. They are started before
+// any thread of ours, as a fork only keeps the thread calling it.
+bool SMCVerification::coordinate() {
+    if(!distributable() || !Util::processesSupported()) {
+        std::cout << ". Worker processes unsupported by this verification or platform, simulating the runs here" << std::endl;
+        return options.isParallel() ? parallel_run() : run();
+    }
+    auto start = std::chrono::steady_clock::now();
+    const std::vector<std::string>& commands = options.getSmcWorkerCommands();
+    uint64_t forked = options.getSmcProcesses();
+    uint64_t count = forked + commands.size();
+    std::cout << ". Distributing the runs over " << count << " worker processes" << std::endl;
+    Util::ignoreBrokenPipes();
+    std::vector<Util::ChildProcess> children;
+    for(uint64_t k = 0 ; k < count ; k++) {
+        Util::ChildProcess child;
+        bool started;
+        if(k < forked) {
+            started = Util::forkProcess([this, k, count](int control, int output) {
+                FILE* out = fdopen(output, "w");
+                if(out == nullptr) return;
+                runWorker(k, count, out, control);
+                fclose(out);
+            }, children, child);
+        } else {
+            started = Util::spawnCommand(commands[k - forked], child) &&
+                Util::writeAll(child.input, shardRecord(k, count).line());
+        }
+        if(!started) {
+            std::cout << "Unable to start the SMC worker process " << k << std::endl;
+            std::exit(1);
+        }
+        children.push_back(child);
+    }
+
+    initWatchs(1);
+    initRunsResults(1);
+    startProgress(1);
+    stopRequested = false;
+    startTimeBudget();
+
+    std::vector<int> outputs;
+    std::vector<Util::LineReader> readers;
+    for(const Util::ChildProcess& child : children) {
+        outputs.push_back(child.output);
+        readers.emplace_back(child.output);
+    }
+    std::vector<bool> done(count, false);
+    size_t running = count;
+    bool stopSent = false;
+    uint64_t committedSent = 0;
+    std::vector<std::string> lines;
+    while(running > 0) {
+        if(stopRequested && !stopSent) {
+            for(const Util::ChildProcess& child : children) Util::writeAll(child.input, "smc-stop\n");
+            stopSent = true;
+        }
+        // The workers keep their runs within the window of the runs committed here
+        uint64_t committed = runsCommitted.load(std::memory_order_relaxed);
+        if(!stopSent && committed != std::numeric_limits<uint64_t>::max() && committed > committedSent) {
+            Util::PartialWriter record("smc-committed");
+            record.putUnsigned(committed);
+            for(uint64_t k = 0 ; k < count ; k++) {
+                if(outputs[k] >= 0 && !done[k]) Util::writeAll(children[k].input, record.line());
+            }
+            committedSent = committed;
+        }
+        for(size_t k : Util::waitReadable(outputs, SMC_EPOCH_MS)) {
+            bool open = readers[k].read(lines);
+            for(const std::string& line : lines) {
+                Util::PartialReader record(line);
+                if(record.kind() == "smc-done") done[k] = true;
+                if(!foldPartialRecord(record)) {
+                    std::cout << ". Malformed results from the SMC worker process " << k << ", ignored" << std::endl;
+                }
+            }
+            lines.clear();
+            if(!open) {
+                outputs[k] = -1;
+                running--;
+                // Its share of the runs will never come, the sequential tests would wait on them
+                // forever : the others are stopped, and the results only hold for the runs done
+                if(!done[k]) {
+                    std::cout << ". The SMC worker process " << k << " ended before reporting all of its runs, stopping the others" << std::endl;
+                    stopRequested = true;
+                }
+            }
+        }
+    }
+    for(uint64_t k = 0 ; k < count ; k++) {
+        Util::waitProcess(children[k]);
+    }
+    stopTimeBudget();
+    // A worker lost, or the stop of the time budget, leaves results that only hold for the runs done
+    if(!concluded) interrupted = true;
+    finalizeRunsResults();
+    reportProgress(true);
+
+    auto stop = std::chrono::steady_clock::now();
+    durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+    return true;
+}
+
+bool SMCVerification::serveCoordinator() {
+    if(!distributable() || !Util::processesSupported()) {
+        std::cout << "SMC worker processes are unsupported by this verification or platform" << std::endl;
+        std::exit(1);
+    }
+    std::string line;
+    Util::PartialReader assignment(Util::readLine(fileno(stdin), line) ? line : "");
+    uint64_t index = assignment.getUnsigned();
+    uint64_t count = assignment.getUnsigned();
+    uint64_t seed = assignment.getUnsigned();
+    uint64_t engine = assignment.getUnsigned();
+    if(assignment.kind() != "smc-shard" || !assignment.good() || index >= count || engine > VerificationOptions::PCG64) {
+        std::cout << "No share of the runs given to the SMC worker process" << std::endl;
+        std::exit(1);
+    }
+    options.setSmcSeed(seed);
+    options.setSmcRandomEngine((VerificationOptions::SMCRandomEngine) engine);
+    runGenerator.setSeed(seed);
+    runGenerator.setEngine(randomEngine());
+    // The results get a stream of their own, the rest of what we print goes to stderr
+    FILE* out = fdopen(Util::detachStandardOutput(), "w");
+    if(out == nullptr) {
+        std::cout << "Unable to write the results of the SMC worker process" << std::endl;
+        std::exit(1);
+    }
+    runWorker(index, count, out, fileno(stdin));
+    fclose(out);
+    return true;
+}
+
+bool SMCVerification::runShard() {
+    if(!distributable()) {
+        std::cout << "SMC shards are unsupported by this verification" << std::endl;
+        std::exit(1);
+    }
+    // Without its coordinator, nothing else would end the shard of a test
+    if(runsBudget() == std::numeric_limits<uint64_t>::max() && !options.hasSmcTimeBudget()) {
+        std::cout << "An SMC shard of a verification without a bound on its runs needs --smc-time-budget" << std::endl;
+        std::exit(1);
+    }
+    const std::string& destination = options.getSmcPartialOutput();
+    bool owned;
+    FILE* out = Util::openOutput(destination, owned);
+    if(out == nullptr) {
+        std::cout << "Unable to open the partial output " << destination << std::endl;
+        std::exit(1);
+    }
+    runWorker(options.getSmcShardIndex(), options.getSmcShardCount(), out, -1);
+    if(owned) fclose(out);
+    std::cout << ". Partial results of shard " << options.getSmcShardIndex() << "/" << options.getSmcShardCount() << " written to " << destination << std::endl;
+    return true;
+}
+
+// The runs of a shard are spread over its threads, as those of a single process are
+void SMCVerification::runWorker(uint64_t index, uint64_t count, FILE* output, int control) {
+    shardIndex = index;
+    shardCount = count;
+    partialOutput = output;
+    controlInput = control;
+    // Whoever reads the results reports the progress
+    options.setProgressOutput("");
+    if(!options.isParallel()) options.setSmcThreads(1);
+    writePartialRecord(shardRecord(index, count));
+    parallel_run();
+    Util::PartialWriter record("smc-done");
+    record.putUnsigned(runGenerator.getTransitionsStatistics());
+    record.putUnsigned(runGenerator.getPlacesStatistics());
+    writePartialRecord(record);
+    partialOutput = nullptr;
+    controlInput = -1;
+}
+
+// A worker whose reader went away has nothing left to do
+void SMCVerification::writePartialRecord(const Util::PartialWriter& record) {
+    std::string line = record.line();
+    if(fwrite(line.data(), 1, line.size(), partialOutput) != line.size() || fflush(partialOutput) != 0) {
+        stopRequested = true;
+    }
+}
+
+Util::PartialWriter SMCVerification::shardRecord(uint64_t index, uint64_t count) const {
+    Util::PartialWriter record("smc-shard");
+    record.putUnsigned(index);
+    record.putUnsigned(count);
+    record.putUnsigned(options.getSmcSeed());
+    record.putUnsigned(options.getSmcRandomEngine());
+    return record;
+}
+
+// Records of other kinds, e.g. the shard header, are skipped
+bool SMCVerification::foldPartialRecord(Util::PartialReader& record) {
+    if(record.kind() == "smc-done") {
+        std::vector<uint32_t> transitions, places;
+        record.getUnsigned(transitions);
+        record.getUnsigned(places);
+        if(!record.good() ||
+            transitions.size() != runGenerator.getTransitionsStatistics().size() ||
+            places.size() != runGenerator.getPlacesStatistics().size()) return false;
+        runGenerator.mergeStatistics(transitions, places);
+        return true;
+    }
+    if(record.kind() != "smc-epoch") return true;
+    uint64_t runs = record.getUnsigned();
+    double time = record.getDouble();
+    uint64_t steps = record.getUnsigned();
+    if(!record.good()) return false;
+    readRunResults(record, 0);
+    if(!record.good()) return false;
+    // The epochs the workers finish before they hear of the decision are dropped
+    if(concluded) {
+        discardRunResults(0);
+        return true;
+    }
+    numberOfRuns += runs;
+    totalTime += time;
+    totalSteps += steps;
+    mergeRunResults(0);
+    if(!concluded && !mustDoAnotherRun()) {
+        concluded = true;
+        stopRequested = true;
+    }
+    reportProgress(false);
+    return true;
+}
+
+// Lines before the header of a file are skipped, so that a shard can share stdout with the
+// rest of what it prints. A last line without its new line was cut short, and is dropped. The
+// files are read an epoch at a time in turn, so that the runs waiting to be committed stay
+// within about an epoch per shard.
+bool SMCVerification::mergePartialResults(const std::vector<std::string>& files) {
+    if(!distributable()) {
+        std::cout << "SMC partial results are unsupported by this verification" << std::endl;
+        std::exit(1);
+    }
+    auto start = std::chrono::steady_clock::now();
+    initWatchs(1);
+    initRunsResults(1);
+    startProgress(1);
+    concluded = false;
+    interrupted = false;
+    uint64_t count = 0;
+    uint64_t seed = 0;
+    uint64_t engine = 0;
+    std::vector<bool> merged;
+    std::vector<std::ifstream> inputs;
+    std::string line;
+    for(const std::string& file : files) {
+        inputs.emplace_back(file);
+        std::ifstream& in = inputs.back();
+        if(!in) {
+            std::cout << "Unable to open the partial results " << file << std::endl;
+            std::exit(1);
+        }
+        bool header = false;
+        while(!header && std::getline(in, line) && !in.eof()) {
+            Util::PartialReader record(line);
+            if(record.kind() != "smc-shard") continue;
+            uint64_t index = record.getUnsigned();
+            uint64_t shards = record.getUnsigned();
+            uint64_t shardSeed = record.getUnsigned();
+            uint64_t shardEngine = record.getUnsigned();
+            if(!record.good() || index >= shards || shardEngine > VerificationOptions::PCG64) continue;
+            if(count == 0) {
+                count = shards;
+                seed = shardSeed;
+                engine = shardEngine;
+                merged.assign(count, false);
+            }
+            if(shards != count || shardSeed != seed || shardEngine != engine) {
+                std::cout << "The partial results " << file << " belong to another split of the runs" << std::endl;
+                std::exit(1);
+            }
+            if(merged[index]) {
+                std::cout << "The partial results " << file << " are those of shard " << index << " again" << std::endl;
+                std::exit(1);
+            }
+            merged[index] = true;
+            header = true;
+        }
+        if(!header) {
+            std::cout << "No SMC partial results in " << file << std::endl;
+            std::exit(1);
+        }
+    }
+    std::vector<bool> done(files.size(), false);
+    std::vector<bool> ended(files.size(), false);
+    size_t reading = files.size();
+    while(reading > 0) {
+        for(size_t i = 0 ; i < files.size() ; i++) {
+            if(ended[i]) continue;
+            bool epoch = false;
+            while(!epoch && std::getline(inputs[i], line) && !inputs[i].eof()) {
+                Util::PartialReader record(line);
+                if(record.kind() == "smc-done") done[i] = true;
+                epoch = record.kind() == "smc-epoch";
+                if(!foldPartialRecord(record)) {
+                    std::cout << "Malformed partial results in " << files[i] << std::endl;
+                    std::exit(1);
+                }
+            }
+            if(epoch) continue;
+            ended[i] = true;
+            reading--;
+            if(!done[i]) std::cout << ". The partial results " << files[i] << " end before their shard did" << std::endl;
+        }
+    }
+    uint64_t missing = std::count(merged.begin(), merged.end(), false);
+    if(missing > 0) std::cout << ". " << missing << " of the " << count << " shards are missing" << std::endl;
+    options.setSmcSeed(seed);
+    options.setSmcRandomEngine((VerificationOptions::SMCRandomEngine) engine);
+    if(!concluded) interrupted = true;
+    finalizeRunsResults();
+    reportProgress(true);
+
     auto stop = std::chrono::steady_clock::now();
     durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
     return true;
@@ -114,21 +758,39 @@ bool SMCVerification::executeRun(SMCRunGenerator* generator) {
     RealMarking* newMarking = generator->getMarking();
     clockValue timeBound = toClock(smcSettings.timeBound, options.getSMCNumericPrecision());
     while(!generator->reachedEnd() && !reachedRunBound(timeBound, smcSettings.stepBound, generator)) {
-        RealMarking* child = new RealMarking(*newMarking);
-        child->_thread_id = generator->_thread_id;
-        child->setGeneratedBy(newMarking->getGeneratedBy());
-        runRes = handleSuccessor(child);
+        if(stopRequested.load(std::memory_order_relaxed)) break;
+        newMarking->_thread_id = generator->_thread_id;
+        runRes = handleMarking(*newMarking);
         if(runRes) break;
         newMarking = generator->next();
     }
     return runRes;
 }
 
+bool SMCVerification::queryHolds(RealMarking& marking) {
+    if(marking._thread_id >= queryStates.size()) return queryProgram.holds(marking, tapn);
+    return incrementalQuery.holds(queryStates[marking._thread_id], marking);
+}
+
+bool SMCVerification::handleSuccessor(RealMarking* marking) {
+    bool res = handleMarking(*marking);
+    delete marking;
+    return res;
+}
+
 void SMCVerification::printStats() {
     std::cout << "  runs executed:\t" << numberOfRuns << std::endl;
     std::cout << "  average run length:\t" << (totalSteps / (double) numberOfRuns) << std::endl;
     std::cout << "  average run duration:\t" << (totalTime / (double) numberOfRuns) << std::endl;
     std::cout << "  verification time:\t" << ((double) durationNs / 1.0E9) << "s" << std::endl;
+    std::cout << "  random seed:\t" << options.getSmcSeed() << std::endl;
+    std::cout << "  random engine:\t" << (options.getSmcRandomEngine() == VerificationOptions::PCG64 ? "pcg64" : "xoshiro256++") << std::endl;
+    if(options.isBenchmarkMode()) {
+        std::cout << "  runs per second:\t" << (numberOfRuns / ((double) durationNs / 1.0E9)) << std::endl;
+        std::cout << "  heap allocations:\t" << allocations << std::endl;
+        std::cout << "  allocations per run:\t" << (allocations / (double) numberOfRuns) << std::endl;
+        std::cout << "  allocations per step:\t" << (allocations / (double) totalSteps) << std::endl;
+    }
 }
 
 void SMCVerification::printTransitionStatistics() const {
@@ -182,7 +844,11 @@ void SMCVerification::initWatchs(unsigned int n_threads) {
         Watch w(&tapn, expr);
         watchs[i].resize(n_threads, w);
     }
+    unsigned int scale = options.getObsStatsScale();
     watch_aggrs.resize(obs.size());
+    for(int i = 0 ; i < obs.size() ; i++) {
+        watch_aggrs[i].init(scale, scale);
+    }
 }
 
 void SMCVerification::getTrace() {
@@ -194,14 +860,14 @@ void SMCVerification::getTrace() {
         doc.append_node(root);
         for(int i = 0 ; i < traces.size() ; i++) {
             std::string name = "Simulation" + std::to_string(i + 1);
-            auto& stack = traces[i];
+            auto stack = runGenerator.replay(traces[i]);
             printXMLTrace(stack, name, doc, root);
         }
         std::cerr << doc;
     } else {
         for(int i = 0 ; i < traces.size() ; i++) {
             std::string name = "Simulation" + std::to_string(i + 1);
-            auto& stack = traces[i];
+            auto stack = runGenerator.replay(traces[i]);
             printHumanTrace(stack, name);
         }
     }
@@ -230,11 +896,12 @@ void SMCVerification::printHumanTrace(std::stack<RealMarking *> &stack, const st
         for (auto& token_list : stack.top()->getPlaceList()) {
             for (auto& token : token_list.tokens) {
                 for (int i = 0; i < token.getCount(); i++) {
-                    float age = clockToDouble(token.getAge(), options.getSMCNumericPrecision());
+                    float age = clockToDouble(stack.top()->tokenAge(token), options.getSMCNumericPrecision());
                     std::cout << "(" << token_list.place->getName() << "," << age << ") ";
                 }
             }
         }
+        delete stack.top();
         stack.pop();
     }
 }
@@ -264,9 +931,11 @@ void SMCVerification::printXMLTrace(std::stack<RealMarking *> &stack, const std:
                 root->append_node(doc.allocate_node(node_element, "deadlock"));
             }
         }
+        delete old;
         old = stack.top();
         stack.pop();
     }
+    delete old;
 }
 
 rapidxml::xml_node<> *SMCVerification::createTransitionNode(RealMarking *old, RealMarking *current, rapidxml::xml_document<> &doc) {
@@ -297,16 +966,18 @@ void SMCVerification::createTransitionSubNodes(RealMarking *old, RealMarking *cu
     RealTokenList::const_iterator n_iter = current_tokens.begin();
     RealTokenList::const_iterator o_iter = old_tokens.begin();
     while (n_iter != current_tokens.end() && o_iter != old_tokens.end()) {
-        if (n_iter->getAge() == o_iter->getAge()) {
+        clockValue n_age = current->tokenAge(*n_iter);
+        clockValue o_age = old->tokenAge(*o_iter);
+        if (n_age == o_age) {
             for (int i = 0; i < o_iter->getCount() - n_iter->getCount(); i++) {
-                transitionNode->append_node(createTokenNode(doc, place, *n_iter));
+                transitionNode->append_node(createTokenNode(doc, place, n_age));
                 tokensFound++;
             }
             n_iter++;
             o_iter++;
         } else {
-            if (n_iter->getAge() > o_iter->getAge()) {
-                transitionNode->append_node(createTokenNode(doc, place, *o_iter));
+            if (n_age > o_age) {
+                transitionNode->append_node(createTokenNode(doc, place, o_age));
                 tokensFound++;
                 o_iter++;
             } else {
@@ -316,16 +987,16 @@ void SMCVerification::createTransitionSubNodes(RealMarking *old, RealMarking *cu
     }
     for (RealTokenList::const_iterator iter = n_iter; iter != current_tokens.end(); iter++) {
         for (int i = 0; i < iter->getCount(); i++) {
-            transitionNode->append_node(createTokenNode(doc, place, *iter));
+            transitionNode->append_node(createTokenNode(doc, place, current->tokenAge(*iter)));
             tokensFound++;
         }
     }
     for (auto& token : old_tokens) {
         if(tokensFound >= weight) break;
-        double age = clockToDouble(token.getAge(), options.getSMCNumericPrecision());
+        double age = clockToDouble(old->tokenAge(token), options.getSMCNumericPrecision());
         if (age >= interval.getLowerBound()) {
             for (int i = 0; i < token.getCount() && tokensFound < weight; i++) {
-                transitionNode->append_node(createTokenNode(doc, place, token));
+                transitionNode->append_node(createTokenNode(doc, place, old->tokenAge(token)));
                 tokensFound++;
             }
         }
@@ -333,13 +1004,13 @@ void SMCVerification::createTransitionSubNodes(RealMarking *old, RealMarking *cu
 }
 
 rapidxml::xml_node<> *
-SMCVerification::createTokenNode(rapidxml::xml_document<> &doc, const TAPN::TimedPlace &place, const RealToken &token) {
+SMCVerification::createTokenNode(rapidxml::xml_document<> &doc, const TAPN::TimedPlace &place, clockValue age) {
     using namespace rapidxml;
     xml_node<> *tokenNode = doc.allocate_node(node_element, "token");
     xml_attribute<> *placeAttribute = doc.allocate_attribute("place",
                                                                 doc.allocate_string(place.getName().c_str()));
     tokenNode->append_attribute(placeAttribute);
-    auto str = printDouble(token.getAge(), options.getSMCNumericPrecision());
+    auto str = printDouble(age, options.getSMCNumericPrecision());
     xml_attribute<> *ageAttribute = doc.allocate_attribute("age", doc.allocate_string(
             str.c_str()));
     tokenNode->append_attribute(ageAttribute);
@@ -21,7 +21,7 @@ namespace VerifyTAPN { namespace DiscreteVerification {
                                      AST::Query *query,
                                      VerificationOptions &options)
             : tapn(tapn), initial_marking(initialMarking),
-              query(query), options(options),
+              query(query), queryProgram(*query), options(options),
               placeStats(tapn.getNumberOfPlaces()),
               generator(nullptr), discovered(0), explored(0),
               largest(0) {
@@ -53,10 +53,7 @@ namespace VerifyTAPN { namespace DiscreteVerification {
     bool SafetySynthesis::satisfies_query(NonStrictMarkingBase *m) {
         m->cut(placeStats);
         if (m->size() > options.getKBound()) return false;
-        QueryVisitor<NonStrictMarkingBase> checker(*m, tapn);
-        BoolResult context;
-        query->accept(checker, context);
-        return context.value;
+        return queryProgram.holds(*m, tapn);
     }
 
     SafetySynthesis::store_t::Pointer* SafetySynthesis::pop_waiting() {
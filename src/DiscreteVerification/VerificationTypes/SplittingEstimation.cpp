@@ -0,0 +1,251 @@
+#include "DiscreteVerification/VerificationTypes/SplittingEstimation.hpp"
+#include "DiscreteVerification/QueryVisitor.hpp"
+#include "DiscreteVerification/QueryDistanceVisitor.hpp"
+#include "DiscreteVerification/Util/BinomialInterval.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+
+namespace VerifyTAPN::DiscreteVerification {
+
+using Util::clockToDouble;
+
+SplittingEstimation::SplittingEstimation(
+    TAPN::TimedArcPetriNet &tapn, RealMarking &initialMarking, AST::SMCQuery *query, VerificationOptions options
+) : SMCVerification(tapn, initialMarking, query, options), effort(options.getSplittingEffort())
+{
+    const std::string& name = options.getSplittingScore();
+    if(name.empty()) return;
+    for(auto& observable : query->getObservables()) {
+        if(std::get<0>(observable) == name) {
+            score = std::get<1>(observable);
+        }
+    }
+    if(score == nullptr) {
+        std::cout << "The query has no observable named " << name << " to use as splitting score" << std::endl;
+        std::exit(1);
+    }
+    scoreProgram = AST::QueryProgram(*score);
+}
+
+void SplittingEstimation::prepare() {
+    // A run is made of segments simulated at different levels
+    options.setSmcTraces(0);
+    std::cout << "Splitting with " << effort << " runs per level" << std::endl;
+}
+
+bool SplittingEstimation::run() {
+    prepare();
+    runGenerator.prepare(&initialMarking);
+    auto start = std::chrono::steady_clock::now();
+    runLevels(false);
+    auto stop = std::chrono::steady_clock::now();
+    durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+    return true;
+}
+
+bool SplittingEstimation::parallel_run() {
+    prepare();
+    runGenerator.prepare(&initialMarking);
+    auto start = std::chrono::steady_clock::now();
+    unsigned int n_threads = prepareWorkers();
+    std::cout << ". Using " << n_threads << " threads..." << std::endl;
+    runLevels(true);
+    for(auto& generator : workerGenerators) {
+        runGenerator.mergeStatistics(*generator);
+    }
+    auto stop = std::chrono::steady_clock::now();
+    durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+    return true;
+}
+
+// The runs of a level are numbered after those of the previous levels, and the crossings are
+// sorted by run, so that the levels only depend on the seed and not on the number of threads.
+// A level cut by the time budget is dropped, the estimation is then the one of the last level
+// done.
+void SplittingEstimation::runLevels(bool parallel) {
+    unsigned int n_threads = parallel ? workerGenerators.size() : 1;
+    threadCrossings = std::vector<std::vector<Crossing>>(n_threads);
+    levelThresholds.clear();
+    levelProbabilities.clear();
+    entries.clear();
+    runGenerator.reset(0);
+    estimation = 1;
+    firstRun = 0;
+    int64_t start = level(*runGenerator.getMarking());
+    if(start == GOAL_LEVEL) return;
+    threshold = start + 1;
+    stopRequested = false;
+    startTimeBudget();
+    while(true) {
+        if(parallel) {
+            runsClaimed = 0;
+            workers->run([this](unsigned int thread_id) {
+                RunsAccumulator acc;
+                uint64_t index;
+                // Crossings are sorted once the level is done, claims are never deferred
+                bool deferred;
+                while(claimRun(index, deferred)) {
+                    runLevel(*workerGenerators[thread_id], index, threadCrossings[thread_id], acc);
+                }
+                std::lock_guard<std::mutex> lock(run_res_mutex);
+                totalTime += acc.time;
+                totalSteps += acc.steps;
+                numberOfRuns += acc.runs;
+            });
+        } else {
+            RunsAccumulator acc;
+            for(uint64_t index = 0 ; index < effort && !stopRequested.load(std::memory_order_relaxed) ; index++) {
+                runLevel(runGenerator, index, threadCrossings[0], acc);
+            }
+            totalTime += acc.time;
+            totalSteps += acc.steps;
+            numberOfRuns += acc.runs;
+        }
+        std::vector<Crossing> crossings;
+        for(auto& threadCrossing : threadCrossings) {
+            std::move(threadCrossing.begin(), threadCrossing.end(), std::back_inserter(crossings));
+            threadCrossing.clear();
+        }
+        if(stopRequested.load(std::memory_order_relaxed)) break;
+        std::sort(crossings.begin(), crossings.end(), [](const Crossing& a, const Crossing& b) { return a.run < b.run; });
+        firstRun += effort;
+        levelThresholds.push_back(threshold);
+        levelProbabilities.push_back(crossings.size() / (double) effort);
+        estimation *= levelProbabilities.back();
+        concluded = crossings.empty();
+        if(concluded) break;
+        int64_t lowest = GOAL_LEVEL;
+        entries.clear();
+        for(auto& crossing : crossings) {
+            lowest = std::min(lowest, crossing.level);
+            entries.push_back(std::move(crossing.state));
+        }
+        concluded = lowest == GOAL_LEVEL;
+        if(concluded) break;
+        // The levels no entry is below are crossed by every run, they are skipped
+        threshold = lowest + 1;
+    }
+    stopTimeBudget();
+}
+
+// The runs of the first level start from the initial marking, with dates sampled by each run.
+// The entries of the next levels are shared out evenly between their runs, and keep the dates
+// sampled by the run that reached them.
+void SplittingEstimation::runLevel(SMCRunGenerator& generator, uint64_t index, std::vector<Crossing>& crossings, RunsAccumulator& acc) {
+    uint64_t run = firstRun + index;
+    generator.reset(run);
+    clockValue entryTime = 0;
+    int entrySteps = 0;
+    if(!entries.empty()) {
+        const SMCRunGenerator::RunState& entry = entries[index % entries.size()];
+        generator.restoreState(entry);
+        entryTime = entry.totalTime;
+        entrySteps = entry.totalSteps;
+    }
+    bool crossed = executeRun(&generator);
+    unsigned int precision = options.getSMCNumericPrecision();
+    clockValue timeBound = toClock(smcSettings.timeBound, precision);
+    acc.time += clockToDouble(std::min(generator.getRunDelay(), timeBound) - entryTime, precision);
+    acc.steps += std::min(generator.getRunSteps(), smcSettings.stepBound) - entrySteps;
+    acc.runs++;
+    if(crossed) {
+        crossings.push_back({ run, level(*generator.getMarking()), SMCRunGenerator::RunState() });
+        generator.saveState(crossings.back().state);
+    }
+}
+
+bool SplittingEstimation::executeRun(SMCRunGenerator* generator) {
+    if(generator == nullptr) generator = &runGenerator;
+    clockValue timeBound = toClock(smcSettings.timeBound, options.getSMCNumericPrecision());
+    RealMarking* marking = generator->getMarking();
+    while(!generator->reachedEnd() && !reachedRunBound(timeBound, smcSettings.stepBound, generator)) {
+        if(stopRequested.load(std::memory_order_relaxed)) break;
+        if(level(*marking) >= threshold) return true;
+        marking = generator->next();
+    }
+    return false;
+}
+
+bool SplittingEstimation::handleMarking(RealMarking& marking) {
+    return queryHolds(marking);
+}
+
+int64_t SplittingEstimation::level(RealMarking& marking) {
+    if(queryHolds(marking)) return GOAL_LEVEL;
+    if(score != nullptr) {
+        return scoreProgram.value(marking, tapn);
+    }
+    AST::IntResult value;
+    QueryDistanceVisitor<RealMarking> distance(marking, tapn);
+    query->accept(distance, value);
+    return -value.value;
+}
+
+float SplittingEstimation::getEstimation() {
+    return (query->getQuantifier() == PG) ? 1 - estimation : estimation;
+}
+
+void SplittingEstimation::printStats() {
+    SMCVerification::printStats();
+    std::cout << "  runs per level:\t" << effort << std::endl;
+    std::cout << "  levels:\t" << levelProbabilities.size() << std::endl;
+    for(size_t i = 0 ; i < levelProbabilities.size() ; i++) {
+        std::cout << "  level " << (i + 1) << " (score >= " << levelThresholds[i] << "):\t" << levelProbabilities[i] << std::endl;
+    }
+}
+
+// The levels are taken as independent, the relative variance of the product is then about
+// the sum of (1 - p) / (effort * p) over the levels, and the interval is taken on its log.
+// Once interrupted, the product of the levels done is the probability of reaching the score
+// of the last one, which bounds the probability of the query.
+void SplittingEstimation::printResult() {
+    std::cout << "Probability estimation by importance splitting:" << std::endl;
+    if(interrupted) {
+        std::cout << "\tInterrupted after " << levelProbabilities.size() << " levels" << std::endl;
+        if(levelProbabilities.empty()) {
+            std::cout << "\tNo level completed, no estimation" << std::endl;
+            return;
+        }
+    }
+    double alpha = 1 - smcSettings.confidence;
+    double lower = estimation;
+    double upper = estimation;
+    double relativeError = 0;
+    if(estimation > 0) {
+        double relativeVariance = 0;
+        for(double p : levelProbabilities) {
+            relativeVariance += (1 - p) / (effort * p);
+        }
+        relativeError = sqrt(relativeVariance);
+        double z = Util::normalQuantile(1 - alpha / 2);
+        lower = estimation * exp(-z * relativeError);
+        upper = std::min(1.0, estimation * exp(z * relativeError));
+    } else if(!levelProbabilities.empty()) {
+        // No run crossed the last level, bound its probability alone
+        upper = Util::clopperPearson(0, effort, alpha).second;
+        for(size_t i = 0 ; i + 1 < levelProbabilities.size() ; i++) {
+            upper *= levelProbabilities[i];
+        }
+    }
+    if(query->getQuantifier() == PG) {
+        std::swap(lower, upper);
+        lower = 1 - lower;
+        upper = 1 - upper;
+    }
+    std::cout << "\tConfidence: " << smcSettings.confidence * 100 << "%" << std::endl;
+    if(interrupted) {
+        std::cout << "\tP " << (query->getQuantifier() == PG ? ">=" : "<=") << " " << getEstimation()
+            << ", reaching a score of " << levelThresholds.back() << std::endl;
+    } else {
+        std::cout << "\tP = " << getEstimation() << std::endl;
+    }
+    if(estimation > 0) {
+        std::cout << "\tRelative error: " << relativeError << std::endl;
+    }
+    std::cout << "\tInterval: [" << lower << "," << upper << "]" << std::endl;
+}
+
+}
@@ -134,11 +134,7 @@ namespace VerifyTAPN { namespace DiscreteVerification {
 
         int youngest = marking->makeBase();
 
-        QueryVisitor<NonStrictMarkingBase> checker(*marking, tapn);
-        AST::BoolResult context;
-
-        query->accept(checker, context);
-        if (context.value) {
+        if (queryProgram.holds(*marking, tapn)) {
             std::pair<LivenessDart *, bool> result = pwList->add(marking, youngest, parent, upper, start);
 
 
@@ -95,10 +95,7 @@ namespace VerifyTAPN { namespace DiscreteVerification {
                 maxDelay = tapn.getMaxConstant() + 1;
             }
 
-            QueryVisitor<NonStrictMarkingBase> checker(*marking, tapn, maxDelay);
-            AST::BoolResult context;
-            query->accept(checker, context);
-            if (context.value) {
+            if (queryProgram.holds(*marking, tapn, maxDelay)) {
                 if (options.getTrace()) {
                     lastMarking = pwList->getLast();
                 }
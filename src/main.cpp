@@ -45,8 +45,8 @@ int main(int argc, char *argv[]) {
         std::cout << output_stream.get()->str();
     }
     
-    std::unique_ptr<AST::Query> query = make_query(builder, options, *tapn);
-    assert(query);
+    std::vector<std::unique_ptr<AST::Query>> queries = make_queries(builder, options, *tapn);
+    assert(!queries.empty());
 
 
     if(options.getSearchType() == VerificationOptions::OverApprox)
@@ -60,13 +60,12 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    if (query->getQuantifier() == AST::CF || query->getQuantifier() == AST::CG) {
-        options.setKeepDeadTokens(true);
+    std::vector<AST::Query*> all;
+    for (auto& query : queries) {
+        all.push_back(query.get());
     }
 
-    tapn->updatePlaceTypes(query.get(), options);
-
-    int result = DiscreteVerification::DiscreteVerification::run(*tapn, initialPlacement, query.get(), options);
+    int result = DiscreteVerification::DiscreteVerification::run(*tapn, initialPlacement, all, options);
 
     return result;
 }
@@ -14,7 +14,7 @@ using namespace VerifyTAPN::TAPN;
 
 namespace VerifyTAPN {
 
-    std::unique_ptr<AST::Query> parse_queries(const VerificationOptions& options,
+    std::vector<std::unique_ptr<AST::Query>> parse_queries(const VerificationOptions& options,
         const unfoldtacpn::ColoredPetriNetBuilder& builder, const TimedArcPetriNet& net) {
         try {
             auto& queryFile = options.getQueryFile();
@@ -25,13 +25,12 @@ namespace VerifyTAPN {
             } else {
                 std::vector<std::pair < unfoldtacpn::PQL::Condition_ptr, std::string>> ast_queries;
                 auto qnums = options.getQueryNumbers();
-                size_t quid = 0;
-                if (qfile.peek() == '<') { // assumed XML
+                bool xml = qfile.peek() == '<';
+                if (xml) { // assumed XML
                     if (qnums.empty()) {
                         std::cerr << "Missing query-indexes for query-file (which is identified as XML-format), assuming only first query is to be verified" << std::endl;
                         qnums.emplace(0);
                     }
-                    quid = *qnums.begin();
                     ast_queries = unfoldtacpn::parse_xml_queries(builder, qfile, qnums);
                 } else {
                     // not xml
@@ -49,14 +48,23 @@ namespace VerifyTAPN {
                     std::fstream of(options.getOutputQueryFile(), std::ios::out);
                     unfoldtacpn::PQL::to_xml(of, ast_queries);
                 }
-                return std::unique_ptr<Query>(AST::toAST(ast_queries[quid].first, net));
+                std::vector<std::unique_ptr<Query>> queries;
+                // Every selected query is returned, SMC queries can be verified together
+                if (xml) {
+                    for (size_t quid : qnums) {
+                        queries.emplace_back(AST::toAST(ast_queries[quid].first, net));
+                    }
+                } else {
+                    queries.emplace_back(AST::toAST(ast_queries[0].first, net));
+                }
+                return queries;
             }
 
         } catch (...) {
             std::cout << "There was an error parsing the query file." << std::endl;
             std::exit(-1);
         }
-        return nullptr;
+        return {};
     }
 
     std::pair<std::vector<int>, std::unique_ptr<TAPN::TimedArcPetriNet>>
@@ -75,8 +83,8 @@ namespace VerifyTAPN {
         return build_net(builder);
     }
 
-    std::unique_ptr<AST::Query> make_query(const unfoldtacpn::ColoredPetriNetBuilder& builder, VerificationOptions& options, const TimedArcPetriNet& net) {
-        std::unique_ptr<Query> query;
+    std::vector<std::unique_ptr<AST::Query>> make_queries(const unfoldtacpn::ColoredPetriNetBuilder& builder, VerificationOptions& options, const TimedArcPetriNet& net) {
+        std::vector<std::unique_ptr<Query>> queries;
         if (options.getWorkflowMode() == VerificationOptions::WORKFLOW_SOUNDNESS ||
             options.getWorkflowMode() == VerificationOptions::WORKFLOW_STRONG_SOUNDNESS) {
             if (options.getGCDLowerGuardsEnabled()) {
@@ -95,15 +103,17 @@ namespace VerifyTAPN {
             }
             if (options.getWorkflowMode() == VerificationOptions::WORKFLOW_SOUNDNESS) {
                 options.setSearchType(VerificationOptions::MINDELAYFIRST);
-                query = std::make_unique<AST::Query>(AST::EF, new AST::BoolExpression(true));
+                queries.push_back(std::make_unique<AST::Query>(AST::EF, new AST::BoolExpression(true)));
             } else if (options.getWorkflowMode() == VerificationOptions::WORKFLOW_STRONG_SOUNDNESS) {
                 options.setSearchType(VerificationOptions::DEPTHFIRST);
-                query = std::make_unique<AST::Query>(AST::AF, new AST::BoolExpression(false));
+                queries.push_back(std::make_unique<AST::Query>(AST::AF, new AST::BoolExpression(false)));
             }
 
         } else {
-            query = parse_queries(options, builder, net);
-            assert(query);
+            queries = parse_queries(options, builder, net);
+            assert(!queries.empty());
+            // The search options follow the first query, the others are only verified along with it by SMC
+            Query* query = queries.front().get();
             if (options.getTrace() != VerificationOptions::NO_TRACE &&
                 (query->getQuantifier() == AST::CF || query->getQuantifier() == AST::CG)) {
                 std::cout << "Traces are not supported for game-synthesis" << std::endl;
@@ -124,7 +134,7 @@ namespace VerifyTAPN {
                 options.setSearchType(VerificationOptions::COVERMOST);
             }
         }
-        return query;
+        return queries;
     }
 
 }
@@ -0,0 +1,66 @@
+#define BOOST_TEST_MODULE binomial_interval
+
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+
+#include "DiscreteVerification/Util/BinomialInterval.hpp"
+
+using namespace VerifyTAPN::DiscreteVerification::Util;
+
+BOOST_AUTO_TEST_CASE(regularized_beta_closed_forms)
+{
+    const double pi = std::acos(-1.0);
+    for(double x : { 0.01, 0.2, 0.5, 0.73, 0.99 }) {
+        BOOST_REQUIRE_CLOSE(regularizedBeta(1, 1, x), x, 1e-9);
+        BOOST_REQUIRE_CLOSE(regularizedBeta(3.5, 1, x), std::pow(x, 3.5), 1e-9);
+        BOOST_REQUIRE_CLOSE(regularizedBeta(1, 7, x), 1 - std::pow(1 - x, 7), 1e-9);
+        BOOST_REQUIRE_CLOSE(regularizedBeta(2, 2, x), 3 * x * x - 2 * x * x * x, 1e-9);
+        BOOST_REQUIRE_CLOSE(regularizedBeta(0.5, 0.5, x), 2 / pi * std::asin(std::sqrt(x)), 1e-9);
+        // I_x(a, b) = 1 - I_{1-x}(b, a)
+        BOOST_REQUIRE_SMALL(regularizedBeta(12, 30, x) + regularizedBeta(30, 12, 1 - x) - 1, 1e-12);
+    }
+    BOOST_REQUIRE_EQUAL(regularizedBeta(4, 5, 0), 0);
+    BOOST_REQUIRE_EQUAL(regularizedBeta(4, 5, 1), 1);
+}
+
+BOOST_AUTO_TEST_CASE(clopper_pearson_known_values)
+{
+    // binom.test(5, 10) in R
+    auto [lower, upper] = clopperPearson(5, 10, 0.05);
+    BOOST_REQUIRE_CLOSE(lower, 0.1870860, 1e-4);
+    BOOST_REQUIRE_CLOSE(upper, 0.8129140, 1e-4);
+    // No success or no failure : one side is exact, the other has a closed form
+    auto [lower0, upper0] = clopperPearson(0, 20, 0.05);
+    BOOST_REQUIRE_EQUAL(lower0, 0);
+    BOOST_REQUIRE_CLOSE(upper0, 1 - std::pow(0.025, 1.0 / 20), 1e-6);
+    auto [lowerN, upperN] = clopperPearson(20, 20, 0.05);
+    BOOST_REQUIRE_CLOSE(lowerN, std::pow(0.025, 1.0 / 20), 1e-6);
+    BOOST_REQUIRE_EQUAL(upperN, 1);
+    auto [lowerE, upperE] = clopperPearson(0, 0, 0.05);
+    BOOST_REQUIRE_EQUAL(lowerE, 0);
+    BOOST_REQUIRE_EQUAL(upperE, 1);
+}
+
+BOOST_AUTO_TEST_CASE(clopper_pearson_bounds_have_the_tail_mass)
+{
+    const uint64_t n = 1000;
+    const double alpha = 0.01;
+    for(uint64_t k : { 1, 37, 500, 999 }) {
+        auto [lower, upper] = clopperPearson(k, n, alpha);
+        BOOST_REQUIRE(lower < (double) k / n && (double) k / n < upper);
+        BOOST_REQUIRE_CLOSE(regularizedBeta(k, n - k + 1, lower), alpha / 2, 1e-4);
+        BOOST_REQUIRE_CLOSE(regularizedBeta(k + 1, n - k, upper), 1 - alpha / 2, 1e-4);
+        // Symmetric in the successes and the failures
+        auto [mirrorLower, mirrorUpper] = clopperPearson(n - k, n, alpha);
+        BOOST_REQUIRE_CLOSE(mirrorLower, 1 - upper, 1e-6);
+        BOOST_REQUIRE_CLOSE(mirrorUpper, 1 - lower, 1e-6);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(normal_quantiles)
+{
+    BOOST_REQUIRE_SMALL(normalQuantile(0.5), 1e-12);
+    BOOST_REQUIRE_CLOSE(normalQuantile(0.975), 1.959963985, 1e-6);
+    BOOST_REQUIRE_CLOSE(normalQuantile(0.995), 2.575829304, 1e-6);
+    BOOST_REQUIRE_CLOSE(normalQuantile(0.05), -1.644853627, 1e-6);
+}
@@ -0,0 +1,89 @@
+#define BOOST_TEST_MODULE event_queue
+
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "DiscreteVerification/Util/EventQueue.hpp"
+
+using namespace VerifyTAPN::DiscreteVerification::Util;
+
+static const clockValue INF = std::numeric_limits<clockValue>::max();
+
+static std::vector<size_t> collected(const EventQueue& queue, clockValue bound) {
+    std::vector<size_t> ids;
+    queue.collect(bound, ids);
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+BOOST_AUTO_TEST_CASE(empty_queue)
+{
+    EventQueue queue;
+    BOOST_REQUIRE_EQUAL(queue.top(), INF);
+    queue.reset(4);
+    BOOST_REQUIRE_EQUAL(queue.top(), INF);
+    BOOST_REQUIRE(collected(queue, INF - 1).empty());
+}
+
+BOOST_AUTO_TEST_CASE(top_and_collect)
+{
+    EventQueue queue;
+    queue.reset(5);
+    queue.update(3, 40);
+    queue.update(1, 10);
+    queue.update(4, 10);
+    queue.update(0, 25);
+    BOOST_REQUIRE_EQUAL(queue.top(), 10);
+    BOOST_REQUIRE(collected(queue, 9).empty());
+    BOOST_REQUIRE(collected(queue, 10) == std::vector<size_t>({ 1, 4 }));
+    BOOST_REQUIRE(collected(queue, 30) == std::vector<size_t>({ 0, 1, 4 }));
+    BOOST_REQUIRE(collected(queue, INF - 1) == std::vector<size_t>({ 0, 1, 3, 4 }));
+}
+
+BOOST_AUTO_TEST_CASE(updates_move_both_ways)
+{
+    EventQueue queue;
+    queue.reset(3);
+    queue.update(0, 10);
+    queue.update(1, 20);
+    queue.update(2, 30);
+    // Later, then earlier than every other event
+    queue.update(0, 50);
+    BOOST_REQUIRE_EQUAL(queue.top(), 20);
+    queue.update(2, 5);
+    BOOST_REQUIRE_EQUAL(queue.top(), 5);
+    BOOST_REQUIRE(collected(queue, 20) == std::vector<size_t>({ 1, 2 }));
+    // An infinite date removes the event
+    queue.update(2, INF);
+    queue.update(1, INF);
+    BOOST_REQUIRE_EQUAL(queue.top(), 50);
+    BOOST_REQUIRE(collected(queue, INF - 1) == std::vector<size_t>({ 0 }));
+    queue.reset(3);
+    BOOST_REQUIRE_EQUAL(queue.top(), INF);
+}
+
+BOOST_AUTO_TEST_CASE(random_updates_match_a_scan)
+{
+    const size_t n = 64;
+    std::mt19937_64 random(42);
+    std::uniform_int_distribution<clockValue> dates(0, 1000);
+    EventQueue queue;
+    queue.reset(n);
+    std::vector<clockValue> expected(n, INF);
+    for(int step = 0 ; step < 5000 ; step++) {
+        size_t id = random() % n;
+        clockValue date = random() % 8 == 0 ? INF : dates(random);
+        queue.update(id, date);
+        expected[id] = date;
+        BOOST_REQUIRE_EQUAL(queue.top(), *std::min_element(expected.begin(), expected.end()));
+        clockValue bound = dates(random);
+        std::vector<size_t> ids;
+        for(size_t i = 0 ; i < n ; i++) {
+            if(expected[i] <= bound) ids.push_back(i);
+        }
+        BOOST_REQUIRE(collected(queue, bound) == ids);
+    }
+}
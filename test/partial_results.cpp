@@ -0,0 +1,217 @@
+#define BOOST_TEST_MODULE partial_results
+
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Core/ArgsParser.hpp"
+#include "Core/TAPN/TAPNModelBuilder.hpp"
+#include "Core/Query/SMCQuery.hpp"
+#include "DiscreteVerification/DataStructures/RealMarking.hpp"
+#include "DiscreteVerification/Util/PartialResults.hpp"
+#include "DiscreteVerification/Util/RunningStats.hpp"
+#include "DiscreteVerification/Util/LogHistogram.hpp"
+#include "DiscreteVerification/VerificationTypes/ProbabilityEstimation.hpp"
+
+using namespace VerifyTAPN;
+using namespace VerifyTAPN::DiscreteVerification;
+using namespace VerifyTAPN::DiscreteVerification::Util;
+
+BOOST_AUTO_TEST_CASE(values_read_back_exactly)
+{
+    const std::vector<double> doubles = { 0.0, -0.0, 1.0 / 3, -2.5e-300, 6.02214076e23,
+        std::numeric_limits<double>::denorm_min(), std::numeric_limits<double>::max(),
+        std::numeric_limits<double>::infinity() };
+    PartialWriter writer("smc-test");
+    writer.putUnsigned(std::numeric_limits<uint64_t>::max());
+    writer.putSigned(std::numeric_limits<int64_t>::min());
+    writer.putSigned(42);
+    for(double value : doubles) writer.putDouble(value);
+    writer.putDouble(std::numeric_limits<double>::quiet_NaN());
+    writer.putUnsigned(std::vector<uint32_t> { 3, 1, 4, 1, 5 });
+    writer.putDouble(std::vector<float> { 0.1f, 2.5f });
+    std::string line = writer.line();
+    BOOST_REQUIRE_EQUAL(line.back(), '\n');
+    line.pop_back();
+
+    PartialReader reader(line);
+    BOOST_REQUIRE_EQUAL(reader.kind(), "smc-test");
+    BOOST_REQUIRE_EQUAL(reader.getUnsigned(), std::numeric_limits<uint64_t>::max());
+    BOOST_REQUIRE_EQUAL(reader.getSigned(), std::numeric_limits<int64_t>::min());
+    BOOST_REQUIRE_EQUAL(reader.getSigned(), 42);
+    for(double value : doubles) {
+        double read = reader.getDouble();
+        BOOST_REQUIRE_EQUAL(read, value);
+        BOOST_REQUIRE_EQUAL(std::signbit(read), std::signbit(value));
+    }
+    BOOST_REQUIRE(std::isnan(reader.getDouble()));
+    std::vector<uint32_t> unsigneds;
+    reader.getUnsigned(unsigneds);
+    BOOST_REQUIRE(unsigneds == std::vector<uint32_t>({ 3, 1, 4, 1, 5 }));
+    std::vector<float> floats;
+    reader.getDouble(floats);
+    BOOST_REQUIRE(floats == std::vector<float>({ 0.1f, 2.5f }));
+    BOOST_REQUIRE(reader.good());
+    // Nothing more in the record
+    reader.getUnsigned();
+    BOOST_REQUIRE(!reader.good());
+}
+
+BOOST_AUTO_TEST_CASE(malformed_records)
+{
+    PartialReader empty("");
+    BOOST_REQUIRE_EQUAL(empty.kind(), "");
+    empty.getDouble();
+    BOOST_REQUIRE(!empty.good());
+
+    PartialReader negative("smc-epoch -3");
+    negative.getUnsigned();
+    BOOST_REQUIRE(!negative.good());
+
+    PartialReader garbage("smc-epoch 12 x");
+    BOOST_REQUIRE_EQUAL(garbage.getUnsigned(), 12);
+    BOOST_REQUIRE(garbage.good());
+    garbage.getDouble();
+    BOOST_REQUIRE(!garbage.good());
+
+    // A size the rest of the record cannot hold
+    PartialReader truncated("smc-epoch 1000 1 2 3");
+    std::vector<uint64_t> values;
+    truncated.getUnsigned(values);
+    BOOST_REQUIRE(!truncated.good());
+    BOOST_REQUIRE(values.empty());
+}
+
+BOOST_AUTO_TEST_CASE(statistics_round_trip)
+{
+    std::mt19937_64 random(3);
+    std::lognormal_distribution<double> delays(1.0, 2.0);
+    RunningStats stats;
+    LogHistogram histogram;
+    for(int i = 0 ; i < 5000 ; i++) {
+        double value = i % 11 == 0 ? 0.0 : delays(random);
+        stats.add(value);
+        histogram.add(value);
+    }
+    PartialWriter writer("smc-test");
+    stats.write(writer);
+    histogram.write(writer);
+    RunningStats empty;
+    empty.write(writer);
+    std::string line = writer.line();
+    line.pop_back();
+
+    PartialReader reader(line);
+    RunningStats readStats;
+    LogHistogram readHistogram;
+    RunningStats readEmpty;
+    readStats.read(reader);
+    readHistogram.read(reader);
+    readEmpty.read(reader);
+    BOOST_REQUIRE(reader.good());
+    BOOST_REQUIRE_EQUAL(readStats.count(), stats.count());
+    BOOST_REQUIRE_EQUAL(readStats.mean(), stats.mean());
+    BOOST_REQUIRE_EQUAL(readStats.variance(), stats.variance());
+    BOOST_REQUIRE_EQUAL(readStats.min(), stats.min());
+    BOOST_REQUIRE_EQUAL(readStats.max(), stats.max());
+    BOOST_REQUIRE_EQUAL(readHistogram.count(), histogram.count());
+    BOOST_REQUIRE_EQUAL(readHistogram.min(), histogram.min());
+    BOOST_REQUIRE_EQUAL(readHistogram.max(), histogram.max());
+    for(double q : { 0.0, 0.1, 0.5, 0.9, 0.99, 1.0 }) {
+        BOOST_REQUIRE_EQUAL(readHistogram.quantile(q), histogram.quantile(q));
+    }
+    BOOST_REQUIRE_EQUAL(readEmpty.count(), 0);
+}
+
+namespace {
+
+    const int INF = std::numeric_limits<int>::max();
+
+    // Single server queue : exponential arrivals, uniform service, does the queue reach 4
+    // customers within 20 time units
+    struct QueueModel {
+        std::unique_ptr<TAPN::TimedArcPetriNet> tapn;
+        std::vector<int> placement;
+        std::unique_ptr<AST::SMCQuery> query;
+
+        QueueModel() {
+            TAPNModelBuilder builder;
+            builder.addPlace("Source", 1, true, INF);
+            builder.addPlace("Queue", 0, true, INF);
+            builder.addPlace("Server", 1, true, INF);
+            builder.addPlace("Busy", 0, true, INF);
+            builder.addTransition("Arrive", 0, false, 0, 0, SMC::Exponential, { 1.0 });
+            builder.addTransition("Start", 0, true, 0, 0, SMC::Constant, { 0.0 });
+            builder.addTransition("Serve", 0, false, 0, 0, SMC::Uniform, { 0.2, 1.6 });
+            builder.addInputArc("Source", "Arrive", false, 1, false, true, 0, INF);
+            builder.addOutputArc("Arrive", "Source", 1);
+            builder.addOutputArc("Arrive", "Queue", 1);
+            builder.addInputArc("Queue", "Start", false, 1, false, true, 0, INF);
+            builder.addInputArc("Server", "Start", false, 1, false, true, 0, INF);
+            builder.addOutputArc("Start", "Busy", 1);
+            builder.addInputArc("Busy", "Serve", false, 1, false, true, 0, INF);
+            builder.addOutputArc("Serve", "Server", 1);
+            placement = builder.initialMarking();
+            tapn.reset(builder.make_tapn());
+            AST::SMCSettings settings { 20, INF, 0.05f, 0.05f, 0.01f, 0.01f, 0.95f, 0.05f, false, 0.5f };
+            auto* full = new AST::AtomicProposition(new AST::NumberExpression(4), AST::AtomicProposition::LE,
+                new AST::IdentifierExpression(tapn->getPlaceIndex("Queue")));
+            query = std::make_unique<AST::SMCQuery>(AST::PF, settings, full);
+            tapn->initialize(false, false);
+        }
+    };
+
+    VerificationOptions parseArgs(std::vector<std::string> args) {
+        std::vector<char*> argv = { (char*) "verifydtapn" };
+        // The model and the query are built here, their names only stand for the files
+        args.push_back("queue.xml");
+        args.push_back("queue.q");
+        for(const std::string& arg : args) {
+            argv.push_back((char*) arg.c_str());
+        }
+        ArgsParser parser;
+        return parser.parse(argv.size(), argv.data());
+    }
+
+    // Estimation over a fixed number of runs, as in benchmark mode
+    float estimate(QueueModel& model, const VerificationOptions& options, const std::vector<std::string>& merged = { }) {
+        model.tapn->updatePlaceTypes(model.query.get(), options);
+        NonStrictMarking initialMarking(*model.tapn, model.placement);
+        RealMarking marking(model.tapn.get(), initialMarking);
+        ProbabilityEstimation verifier(*model.tapn, marking, model.query.get(), options, 3000);
+        if(!options.getSmcPartialOutput().empty()) {
+            verifier.runShard();
+        } else if(!merged.empty()) {
+            verifier.mergePartialResults(merged);
+        } else {
+            verifier.run();
+        }
+        return verifier.getEstimation();
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(merged_shards_equal_a_single_process)
+{
+    QueueModel model;
+    float single = estimate(model, parseArgs({ "--smc-seed", "11" }));
+    BOOST_REQUIRE(single > 0 && single < 1);
+
+    std::vector<std::string> files;
+    for(int shard = 0 ; shard < 3 ; shard++) {
+        files.push_back((std::filesystem::temp_directory_path() / ("partial_results_" + std::to_string(shard))).string());
+        estimate(model, parseArgs({ "--smc-seed", "11", "--smc-shard", std::to_string(shard) + "/3",
+            "--smc-partial-output", files.back() }));
+    }
+    // The order of the files does not matter
+    std::swap(files[0], files[2]);
+    float merged = estimate(model, parseArgs({ }), files);
+    for(const std::string& file : files) std::remove(file.c_str());
+    BOOST_REQUIRE_EQUAL(merged, single);
+}
@@ -0,0 +1,137 @@
+#define BOOST_TEST_MODULE probability_estimation
+
+#include <boost/test/unit_test.hpp>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Core/ArgsParser.hpp"
+#include "Core/TAPN/TAPNModelBuilder.hpp"
+#include "Core/Query/SMCQuery.hpp"
+#include "DiscreteVerification/DataStructures/RealMarking.hpp"
+#include "DiscreteVerification/VerificationTypes/ProbabilityEstimation.hpp"
+
+using namespace VerifyTAPN;
+using namespace VerifyTAPN::DiscreteVerification;
+
+namespace {
+
+    const int INF = std::numeric_limits<int>::max();
+
+    // Single server queue : exponential arrivals, uniform service, does the queue reach 11
+    // customers within 20 time units. The runs reaching it end early, the others at the bound.
+    struct QueueModel {
+        std::unique_ptr<TAPN::TimedArcPetriNet> tapn;
+        std::vector<int> placement;
+        std::unique_ptr<AST::SMCQuery> query;
+
+        QueueModel() {
+            TAPNModelBuilder builder;
+            builder.addPlace("Source", 1, true, INF);
+            builder.addPlace("Queue", 0, true, INF);
+            builder.addPlace("Server", 1, true, INF);
+            builder.addPlace("Busy", 0, true, INF);
+            builder.addTransition("Arrive", 0, false, 0, 0, SMC::Exponential, { 1.0 });
+            builder.addTransition("Start", 0, true, 0, 0, SMC::Constant, { 0.0 });
+            builder.addTransition("Serve", 0, false, 0, 0, SMC::Uniform, { 0.2, 1.6 });
+            builder.addInputArc("Source", "Arrive", false, 1, false, true, 0, INF);
+            builder.addOutputArc("Arrive", "Source", 1);
+            builder.addOutputArc("Arrive", "Queue", 1);
+            builder.addInputArc("Queue", "Start", false, 1, false, true, 0, INF);
+            builder.addInputArc("Server", "Start", false, 1, false, true, 0, INF);
+            builder.addOutputArc("Start", "Busy", 1);
+            builder.addInputArc("Busy", "Serve", false, 1, false, true, 0, INF);
+            builder.addOutputArc("Serve", "Server", 1);
+            placement = builder.initialMarking();
+            tapn.reset(builder.make_tapn());
+            AST::SMCSettings settings { 20, INF, 0.05f, 0.05f, 0.01f, 0.01f, 0.95f, 0.02f, false, 0.5f };
+            auto* full = new AST::AtomicProposition(new AST::NumberExpression(11), AST::AtomicProposition::LE,
+                new AST::IdentifierExpression(tapn->getPlaceIndex("Queue")));
+            query = std::make_unique<AST::SMCQuery>(AST::PF, settings, full);
+            query->getObservables().push_back({ "queue", new AST::IdentifierExpression(tapn->getPlaceIndex("Queue")) });
+            tapn->initialize(false, false);
+        }
+    };
+
+    VerificationOptions parseArgs(std::vector<std::string> args) {
+        std::vector<char*> argv = { (char*) "verifydtapn" };
+        // The model and the query are built here, their names only stand for the files
+        args.push_back("queue.xml");
+        args.push_back("queue.q");
+        for(const std::string& arg : args) {
+            argv.push_back((char*) arg.c_str());
+        }
+        ArgsParser parser;
+        return parser.parse(argv.size(), argv.data());
+    }
+
+    struct Estimation : public ProbabilityEstimation {
+        using ProbabilityEstimation::ProbabilityEstimation;
+        uint64_t runs() const { return numberOfRuns; }
+        uint64_t cap() const { return runsNeeded; }
+        std::string plots() {
+            watch_aggrs[0].aggregate();
+            return watch_aggrs[0].get_plots("queue");
+        }
+    };
+
+    struct Outcome {
+        float p;
+        uint64_t runs;
+        std::string plots;
+    };
+
+    // The estimation, and the runs it took, which must be fewer than its cap to stop on its interval
+    Outcome estimate(QueueModel& model, const std::vector<std::string>& args) {
+        VerificationOptions options = parseArgs(args);
+        model.tapn->updatePlaceTypes(model.query.get(), options);
+        NonStrictMarking initialMarking(*model.tapn, model.placement);
+        RealMarking marking(model.tapn.get(), initialMarking);
+        Estimation verifier(*model.tapn, marking, model.query.get(), options);
+        if(options.isParallel()) {
+            verifier.parallel_run();
+        } else {
+            verifier.run();
+        }
+        BOOST_REQUIRE(verifier.runs() < verifier.cap());
+        return { verifier.getEstimation(), verifier.runs(), verifier.plots() };
+    }
+
+    // The same runs and watch plots, whatever the threads simulating them and the order they end in
+    void requireSameRuns(QueueModel& model, const std::vector<std::string>& args) {
+        std::vector<std::string> single = args;
+        single.push_back("--smc-seed");
+        single.push_back("17");
+        Outcome sequential = estimate(model, single);
+        BOOST_REQUIRE(sequential.p > 0 && sequential.p < 1);
+        for(const char* threads : { "1", "3", "8" }) {
+            std::vector<std::string> parallel = single;
+            parallel.push_back("--smc-threads");
+            parallel.push_back(threads);
+            Outcome outcome = estimate(model, parallel);
+            BOOST_REQUIRE_EQUAL(outcome.runs, sequential.runs);
+            BOOST_REQUIRE_EQUAL(outcome.p, sequential.p);
+            BOOST_REQUIRE_EQUAL(outcome.plots, sequential.plots);
+        }
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(sequential_estimation_stops_after_the_same_runs)
+{
+    QueueModel model;
+    requireSameRuns(model, { "--smc-sequential-estimation" });
+}
+
+BOOST_AUTO_TEST_CASE(sequential_estimation_by_batches_stops_after_the_same_runs)
+{
+    QueueModel model;
+    requireSameRuns(model, { "--smc-sequential-estimation", "--smc-batch", "16" });
+}
+
+BOOST_AUTO_TEST_CASE(weighted_estimation_stops_after_the_same_runs)
+{
+    QueueModel model;
+    requireSameRuns(model, { "--smc-importance-sampling", "200" });
+}
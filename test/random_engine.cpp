@@ -0,0 +1,64 @@
+#define BOOST_TEST_MODULE random_engine
+
+#include <boost/test/unit_test.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "DiscreteVerification/Util/Random.hpp"
+
+using namespace VerifyTAPN::DiscreteVerification::Util;
+
+namespace {
+
+    template<typename Engine>
+    std::vector<uint64_t> draw(Engine& engine, size_t n) {
+        std::vector<uint64_t> values(n);
+        for(uint64_t& value : values) value = engine();
+        return values;
+    }
+
+    std::vector<uint64_t> draw(RandomEngine::Kind kind, uint64_t seed, uint64_t stream) {
+        RandomEngine engine(kind);
+        engine.seed(seed, stream);
+        return draw(engine, 64);
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(pcg64_known_answers)
+{
+    // pcg64 reference output for the state 42 and the sequence 54
+    Pcg64 engine;
+    engine.seed128(0, 42, 0, 54);
+    const std::vector<uint64_t> expected = { 0x86b1da1d72062b68ULL, 0x1304aa46c9853d39ULL,
+        0xa3670e9e0dd50358ULL, 0xf9090e529a7dae00ULL, 0xc85b9fd837996f2cULL, 0x606121f8e3919196ULL };
+    BOOST_REQUIRE(draw(engine, expected.size()) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(engines_follow_their_kind)
+{
+    Xoshiro256pp xoshiro(3, 7);
+    Pcg64 pcg;
+    pcg.seed(3, 7);
+    BOOST_REQUIRE(draw(RandomEngine::XOSHIRO256PP, 3, 7) == draw(xoshiro, 64));
+    BOOST_REQUIRE(draw(RandomEngine::PCG64, 3, 7) == draw(pcg, 64));
+    BOOST_REQUIRE(draw(RandomEngine::PCG64, 3, 7) != draw(RandomEngine::XOSHIRO256PP, 3, 7));
+
+    // A selected engine is used once seeded again, as the copies of the run generators do
+    RandomEngine engine;
+    engine.select(RandomEngine::PCG64);
+    engine.seed(3, 7);
+    BOOST_REQUIRE_EQUAL(engine.kind(), RandomEngine::PCG64);
+    BOOST_REQUIRE(draw(engine, 64) == draw(RandomEngine::PCG64, 3, 7));
+}
+
+BOOST_AUTO_TEST_CASE(streams_are_distinct)
+{
+    for(RandomEngine::Kind kind : { RandomEngine::XOSHIRO256PP, RandomEngine::PCG64 }) {
+        BOOST_REQUIRE(draw(kind, 3, 0) == draw(kind, 3, 0));
+        BOOST_REQUIRE(draw(kind, 3, 0) != draw(kind, 3, 1));
+        BOOST_REQUIRE(draw(kind, 3, 0) != draw(kind, 4, 0));
+        // The seed and the stream do not play the same part
+        BOOST_REQUIRE(draw(kind, 3, 4) != draw(kind, 4, 3));
+    }
+}
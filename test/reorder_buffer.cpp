@@ -0,0 +1,94 @@
+#define BOOST_TEST_MODULE reorder_buffer
+
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "DiscreteVerification/Util/ReorderBuffer.hpp"
+
+using namespace VerifyTAPN::DiscreteVerification::Util;
+
+BOOST_AUTO_TEST_CASE(in_order_pushes)
+{
+    ReorderBuffer<int> buffer;
+    int value;
+    BOOST_REQUIRE(!buffer.pop(value));
+    for(int i = 0 ; i < 5 ; i++) {
+        buffer.push(i, 10 * i);
+        BOOST_REQUIRE(buffer.pop(value));
+        BOOST_REQUIRE_EQUAL(value, 10 * i);
+        BOOST_REQUIRE(!buffer.pop(value));
+    }
+    BOOST_REQUIRE_EQUAL(buffer.next(), 5);
+}
+
+BOOST_AUTO_TEST_CASE(out_of_order_pushes)
+{
+    ReorderBuffer<int> buffer;
+    int value;
+    buffer.push(2, 20);
+    buffer.push(4, 40);
+    buffer.push(1, 10);
+    // Nothing comes out before index 0
+    BOOST_REQUIRE(!buffer.pop(value));
+    BOOST_REQUIRE_EQUAL(buffer.next(), 0);
+    buffer.push(0, 0);
+    for(int i = 0 ; i < 3 ; i++) {
+        BOOST_REQUIRE(buffer.pop(value));
+        BOOST_REQUIRE_EQUAL(value, 10 * i);
+    }
+    // Index 3 is still missing
+    BOOST_REQUIRE(!buffer.pop(value));
+    BOOST_REQUIRE_EQUAL(buffer.next(), 3);
+    // An index already handed back is ignored
+    buffer.push(1, -1);
+    BOOST_REQUIRE(!buffer.pop(value));
+    buffer.push(3, 30);
+    BOOST_REQUIRE(buffer.pop(value));
+    BOOST_REQUIRE_EQUAL(value, 30);
+    BOOST_REQUIRE(buffer.pop(value));
+    BOOST_REQUIRE_EQUAL(value, 40);
+    BOOST_REQUIRE(!buffer.pop(value));
+    BOOST_REQUIRE_EQUAL(buffer.next(), 5);
+}
+
+BOOST_AUTO_TEST_CASE(clear_starts_over)
+{
+    ReorderBuffer<int> buffer;
+    int value;
+    buffer.push(0, 1);
+    buffer.push(3, 4);
+    BOOST_REQUIRE(buffer.pop(value));
+    buffer.clear();
+    BOOST_REQUIRE_EQUAL(buffer.next(), 0);
+    BOOST_REQUIRE(!buffer.pop(value));
+    buffer.push(0, 7);
+    BOOST_REQUIRE(buffer.pop(value));
+    BOOST_REQUIRE_EQUAL(value, 7);
+    BOOST_REQUIRE(!buffer.pop(value));
+}
+
+BOOST_AUTO_TEST_CASE(shuffled_pushes_come_back_in_order)
+{
+    const uint64_t n = 10000;
+    std::vector<uint64_t> indexes(n);
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::mt19937_64 random(42);
+    // Shuffled within blocks, as the epochs of several threads would interleave
+    for(uint64_t start = 0 ; start < n ; start += 256) {
+        std::shuffle(indexes.begin() + start, indexes.begin() + std::min(n, start + 256), random);
+    }
+    ReorderBuffer<uint64_t> buffer;
+    std::vector<uint64_t> popped;
+    uint64_t value;
+    for(uint64_t index : indexes) {
+        buffer.push(index, index * index);
+        while(buffer.pop(value)) popped.push_back(value);
+    }
+    BOOST_REQUIRE_EQUAL(popped.size(), n);
+    for(uint64_t i = 0 ; i < n ; i++) {
+        BOOST_REQUIRE_EQUAL(popped[i], i * i);
+    }
+}
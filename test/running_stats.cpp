@@ -0,0 +1,116 @@
+#define BOOST_TEST_MODULE running_stats
+
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "DiscreteVerification/Util/RunningStats.hpp"
+#include "DiscreteVerification/Util/LogHistogram.hpp"
+
+using namespace VerifyTAPN::DiscreteVerification::Util;
+
+static std::vector<double> sampleValues(size_t n) {
+    std::mt19937_64 random(7);
+    std::exponential_distribution<double> delays(0.3);
+    std::vector<double> values;
+    for(size_t i = 0 ; i < n ; i++) {
+        // Some zeros, as the delays of runs ending at once
+        values.push_back(i % 17 == 0 ? 0.0 : 1000 + delays(random));
+    }
+    return values;
+}
+
+static std::vector<std::pair<double, uint64_t>> buckets(const LogHistogram& histogram) {
+    std::vector<std::pair<double, uint64_t>> result;
+    histogram.forEach([&result](double value, uint64_t count) { result.emplace_back(value, count); });
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(running_stats_of_known_values)
+{
+    RunningStats stats;
+    BOOST_REQUIRE_EQUAL(stats.count(), 0);
+    BOOST_REQUIRE_EQUAL(stats.mean(), 0);
+    for(double value : { 2.0, 4.0, 4.0, 4.0, 5.0, 5.0, 7.0, 9.0 }) {
+        stats.add(value);
+    }
+    BOOST_REQUIRE_EQUAL(stats.count(), 8);
+    BOOST_REQUIRE_CLOSE(stats.mean(), 5.0, 1e-12);
+    BOOST_REQUIRE_CLOSE(stats.sum(), 40.0, 1e-12);
+    BOOST_REQUIRE_CLOSE(stats.variance(), 4.0, 1e-12);
+    BOOST_REQUIRE_CLOSE(stats.stdDev(), 2.0, 1e-12);
+    BOOST_REQUIRE_EQUAL(stats.min(), 2.0);
+    BOOST_REQUIRE_EQUAL(stats.max(), 9.0);
+}
+
+BOOST_AUTO_TEST_CASE(running_stats_merge_equals_a_single_pass)
+{
+    std::vector<double> values = sampleValues(10000);
+    RunningStats single;
+    for(double value : values) single.add(value);
+    // Uneven splits, one of them empty, merged in another order than they were filled
+    for(size_t parts : { 1, 2, 3, 8, 61 }) {
+        std::vector<RunningStats> split(parts + 1);
+        for(size_t i = 0 ; i < values.size() ; i++) {
+            split[(i * i) % parts].add(values[i]);
+        }
+        RunningStats merged;
+        for(size_t k = split.size() ; k-- > 0 ;) {
+            merged.merge(split[k]);
+        }
+        BOOST_REQUIRE_EQUAL(merged.count(), single.count());
+        BOOST_REQUIRE_CLOSE(merged.mean(), single.mean(), 1e-9);
+        BOOST_REQUIRE_CLOSE(merged.variance(), single.variance(), 1e-7);
+        BOOST_REQUIRE_EQUAL(merged.min(), single.min());
+        BOOST_REQUIRE_EQUAL(merged.max(), single.max());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(log_histogram_merge_equals_a_single_pass)
+{
+    std::vector<double> values = sampleValues(10000);
+    LogHistogram single;
+    for(double value : values) single.add(value);
+    for(size_t parts : { 1, 2, 5, 33 }) {
+        std::vector<LogHistogram> split(parts);
+        for(size_t i = 0 ; i < values.size() ; i++) {
+            split[(i * 7) % parts].add(values[i]);
+        }
+        LogHistogram merged;
+        for(size_t k = split.size() ; k-- > 0 ;) {
+            merged.merge(split[k]);
+        }
+        BOOST_REQUIRE_EQUAL(merged.count(), single.count());
+        BOOST_REQUIRE_EQUAL(merged.min(), single.min());
+        BOOST_REQUIRE_EQUAL(merged.max(), single.max());
+        BOOST_REQUIRE(buckets(merged) == buckets(single));
+        for(double q : { 0.0, 0.05, 0.5, 0.95, 1.0 }) {
+            BOOST_REQUIRE_EQUAL(merged.quantile(q), single.quantile(q));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(log_histogram_quantiles_within_bucket_error)
+{
+    LogHistogram histogram;
+    for(int i = 1 ; i <= 1000 ; i++) histogram.add(i);
+    const double error = 1.0 / LOG_HISTOGRAM_SUB_BUCKETS;
+    BOOST_REQUIRE_CLOSE(histogram.quantile(0.5), 500, 100 * error);
+    BOOST_REQUIRE_CLOSE(histogram.quantile(0.99), 990, 100 * error);
+    BOOST_REQUIRE_CLOSE(histogram.quantile(1.0), 1000, 100 * error);
+}
+
+BOOST_AUTO_TEST_CASE(log_histogram_clear)
+{
+    LogHistogram histogram;
+    for(double value : sampleValues(100)) histogram.add(value);
+    histogram.clear();
+    BOOST_REQUIRE_EQUAL(histogram.count(), 0);
+    BOOST_REQUIRE(std::isnan(histogram.min()));
+    BOOST_REQUIRE(buckets(histogram).empty());
+    histogram.add(3.0, 2);
+    BOOST_REQUIRE_EQUAL(histogram.count(), 2);
+    BOOST_REQUIRE_EQUAL(histogram.min(), 3.0);
+    BOOST_REQUIRE_EQUAL(buckets(histogram).size(), 1);
+}
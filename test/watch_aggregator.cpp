@@ -0,0 +1,145 @@
+#define BOOST_TEST_MODULE watch_aggregator
+
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Core/TAPN/WatchExpression.hpp"
+#include "DiscreteVerification/Util/PartialResults.hpp"
+
+using namespace VerifyTAPN::TAPN;
+using namespace VerifyTAPN::DiscreteVerification::Util;
+
+namespace {
+
+    // Runs as a watch records them : a value on every change, the last one again at the end.
+    // Values and dates are multiples of 1/8, so that the sums are exact whatever their order.
+    std::vector<WatchRun> makeRuns(size_t n, unsigned int maxChanges, uint64_t seed) {
+        std::mt19937_64 random(seed);
+        std::uniform_int_distribution<unsigned int> changes(0, maxChanges);
+        std::uniform_int_distribution<int> values(-16, 16);
+        std::uniform_int_distribution<unsigned int> gaps(0, 24);
+        std::uniform_int_distribution<unsigned int> steps(1, 3);
+        std::vector<WatchRun> runs(n);
+        for(WatchRun& run : runs) {
+            float value = values(random) / 8.0f;
+            float date = 0;
+            unsigned int step = 0;
+            for(unsigned int i = 0, n_changes = changes(random) ; i <= n_changes ; i++) {
+                run.values.push_back(value);
+                run.timestamps.push_back(date);
+                run.steps.push_back(step);
+                value += values(random) / 8.0f;
+                date += gaps(random) / 8.0f;
+                step += steps(random);
+            }
+            run.values.push_back(run.values.back());
+            run.timestamps.push_back(date);
+            run.steps.push_back(step);
+        }
+        return runs;
+    }
+
+    std::string plots(WatchAggregator& aggregator) {
+        aggregator.aggregate();
+        return aggregator.get_plots("watch");
+    }
+
+    void requireMergedEqualSingle(unsigned int scale) {
+        std::vector<WatchRun> runs = makeRuns(300, 40, scale);
+        // A long run at the end, which widens the single axis after most of the runs
+        std::vector<WatchRun> longRun = makeRuns(1, 400, scale + 1);
+        runs.push_back(longRun.front());
+        WatchAggregator single;
+        single.init(scale, scale);
+        for(const WatchRun& run : runs) {
+            single.add_run(run);
+        }
+        // Uneven shares, the axes of the threads then have different deltas
+        for(unsigned int threads : { 2, 3, 8 }) {
+            std::vector<WatchAggregator> parts(threads);
+            for(WatchAggregator& part : parts) {
+                part.init(scale, scale);
+            }
+            for(size_t i = 0 ; i < runs.size() ; i++) {
+                parts[(i * i) % threads].add_run(runs[i]);
+            }
+            WatchAggregator merged;
+            merged.init(scale, scale);
+            for(size_t k = threads ; k-- > 0 ; ) {
+                merged.merge(parts[k]);
+            }
+            BOOST_REQUIRE_EQUAL(plots(merged), plots(single));
+        }
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(merged_axes_equal_a_single_pass)
+{
+    requireMergedEqualSingle(16);
+    requireMergedEqualSingle(500);
+    // Every step, and every timestamp
+    requireMergedEqualSingle(0);
+}
+
+BOOST_AUTO_TEST_CASE(axes_read_back_exactly)
+{
+    for(unsigned int scale : { 0, 16 }) {
+        WatchAggregator aggregator;
+        aggregator.init(scale, scale);
+        for(const WatchRun& run : makeRuns(100, 30, 5)) {
+            aggregator.add_run(run);
+        }
+        PartialWriter writer("smc-test");
+        aggregator.write(writer);
+        std::string line = writer.line();
+        line.pop_back();
+
+        PartialReader reader(line);
+        WatchAggregator read;
+        read.init(scale, scale);
+        read.read(reader);
+        BOOST_REQUIRE(reader.good());
+        BOOST_REQUIRE_EQUAL(plots(read), plots(aggregator));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(points_bounded_by_the_scale)
+{
+    WatchAggregator aggregator;
+    aggregator.init(16, 16);
+    for(const WatchRun& run : makeRuns(20, 5000, 7)) {
+        aggregator.add_run(run);
+        aggregator.aggregate();
+        BOOST_REQUIRE(aggregator.step_bins.size() <= 17);
+        BOOST_REQUIRE(aggregator.timestamps.size() <= 17);
+    }
+    // The last point ends with the longest run
+    float longest = 0;
+    for(const WatchRun& run : makeRuns(20, 5000, 7)) {
+        longest = std::max(longest, run.timestamps.back());
+    }
+    BOOST_REQUIRE_EQUAL(aggregator.timestamps.back(), longest);
+}
+
+BOOST_AUTO_TEST_CASE(values_weighted_by_how_long_they_hold)
+{
+    WatchAggregator aggregator;
+    aggregator.init(2, 2);
+    WatchRun run;
+    // 1 from 0 to 1, then 3 until the end at 4 : the axis is cut at 2 and 4
+    run.values = { 1, 3, 3 };
+    run.timestamps = { 0, 1, 4 };
+    run.steps = { 0, 1, 4 };
+    aggregator.add_run(run);
+    aggregator.aggregate();
+    BOOST_REQUIRE(aggregator.timestamps == std::vector<float>({ 0, 2, 4 }));
+    BOOST_REQUIRE(aggregator.time_avg == std::vector<float>({ 1, 2, 3 }));
+    BOOST_REQUIRE(aggregator.time_min == std::vector<float>({ 1, 1, 3 }));
+    // Steps 1 and 2, then 3 and 4, hold 3
+    BOOST_REQUIRE(aggregator.step_bins == std::vector<float>({ 0, 2, 4 }));
+    BOOST_REQUIRE(aggregator.step_avg == std::vector<float>({ 1, 3, 3 }));
+}